@@ -0,0 +1,899 @@
+// Headless frame benchmark.
+// Renders a seeded cube scene along a scripted camera path for a fixed number
+// of frames and prints the timings as JSON, so that runs can be compared across commits.
+//
+// Usage: ./bench [--size N] [--seed S] [--frames F] [--warmup W]
+//                [--path orbit|dolly|static] [--width W] [--height H]
+//                [--label text] [--out file.json] [--trace trace.json]
+//                [--pacing uncapped|vsync|<fps>] [--frames-in-flight N] [--threads N]
+//                [--simd scalar|sse4|avx2|avx512] [--replay input.vgli]
+//                [--views N] [--multiview shared|independent]
+//                [--background off|<scale>] [--upscale bilinear|edge]
+//                [--dynamic-resolution <budget ms>] [--min-scale S] [--max-scale S]
+//                [--post off|fused|separate] [--order depth|submission]
+//                [--overdraw heatmap.ppm] [--physics off|on] [--satellites N]
+//                [--storage entities|things]
+//
+// --views splits the window into a grid of N views, each following the path
+// from its own point, N/frames of the way further along than the one before.
+// They are drawn the shared way (one cull, one upload, see recordViews) unless
+// --multiview independent draws them as N complete passes; run both to get
+// the cost of the shared path relative to N passes.
+// --replay flies the camera with input recorded by main --record instead of a
+// scripted path, 60 frames per recorded second; --size 30 is main's scene.
+// --background shades the full-screen background at that fraction of the
+// window's width and height (0.5 by default) and scales it up with --upscale.
+// --dynamic-resolution draws the scene at whatever fraction of the window,
+// between --min-scale (0.5) and --max-scale (1), keeps the GPU time of a frame
+// within the budget, scaled up with --upscale too. The scale of every frame
+// goes into the report.
+// --post runs the scene through the post-processing chain (see
+// enablePostProcessing) with its per-pixel effects fused into one pass, or
+// with a pass for every effect to get what the fusing saves.
+// --order submission draws the opaque things in the order they were made
+// rather than nearest first (see sortScene); the opaque overdraw of the two
+// runs is what the sorting saves. Only measured with a single view, as are
+// the samples every pass lets through the depth test.
+// --overdraw counts the fragments written to every pixel of the scene, reports
+// their mean and maximum and writes the last frame's counts as a heatmap.
+// The counts are read back every frame, which stalls: do not time such runs.
+// --physics on moves the things with the rigid-body simulation (see
+// PhysicsWorld), one 1/60 s step per frame, instead of only spinning them.
+// Its phases and how many pairs, contacts and islands it had go into the report.
+// --satellites attaches N smaller cubes to every cube, carried round by its
+// spin (see addSatellites), and works the transforms out through a SceneGraph.
+// The scene then has (N + 1) * size things. Single view only.
+// --storage keeps the cubes as entities (see ecs.h), animated and transformed
+// by systems, or as the vector of Thing the renderer started out with. The
+// entities are the default, except with --physics, --satellites and the
+// multi-view modes, which only work with the things so far.
+// --simd caps the transform kernels at that instruction set, the default is the widest the CPU has.
+// --trace needs a build with the profiler compiled in (make PROFILE=1).
+// Timings only mean something in an optimized build, make VARIANT=release bench (see ../vgl/vgl.mk).
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "batch_math.h"
+#include "camera.h"
+#include "frame_arena.h"
+#include "frame_stats.h"
+#include "controls.h"
+#include "dynamic_resolution.h"
+#include "gl_debug.h"
+#include "gpu_timer.h"
+#include "input_record.h"
+#include "pacing.h"
+#include "physics.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "startup.h"
+#include "things.h"
+#include "vgl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct BenchConfig {
+  int size = 1000;
+  unsigned seed = 1;
+  int frames = 300;
+  int warmup = 30;
+  string path = "orbit";
+  int width = 800;
+  int height = 600;
+  string label;
+  string out;
+  string trace;
+  string pacing_name = "uncapped";
+  PacingConfig pacing{PacingMode::Uncapped};
+  // Job system threads including the main one, 0 for one per hardware thread
+  int threads = 0;
+  // Widest instruction set the transform kernels may use
+  SimdLevel simd = SimdLevel::AVX512;
+  // Input recording that replaces the camera path
+  string replay;
+  // How many views and how they are drawn. Empty for the plain single view.
+  int views = 1;
+  string multiview;
+  // Background resolution relative to the window, 0 for none
+  float background = background_scale;
+  Upscale upscale = Upscale::Bilinear;
+  // Frame time budget of the dynamic resolution, 0 for a fixed resolution
+  DynamicResolutionConfig dynamic_resolution{0};
+  string post = "off";
+  string order = "depth";
+  // Where the overdraw heatmap goes, empty for no counting
+  string overdraw;
+  // Simulate the things instead of spinning them in place
+  bool physics = false;
+  // Cubes attached to every cube
+  int satellites = 0;
+  // "entities" or "things", empty for whichever the other options allow
+  string storage;
+};
+
+void usage() {
+  cerr << "usage: bench [--size N] [--seed S] [--frames F] [--warmup W] "
+          "[--path orbit|dolly|static] [--width W] [--height H] [--label text] [--out file.json] [--trace trace.json] "
+          "[--pacing uncapped|vsync|<fps>] [--frames-in-flight N] [--threads N] [--simd scalar|sse4|avx2|avx512] [--replay input.vgli] "
+          "[--views N] [--multiview shared|independent] [--background off|<scale>] [--upscale bilinear|edge] "
+          "[--dynamic-resolution <budget ms>] [--min-scale S] [--max-scale S] [--post off|fused|separate] [--order depth|submission] "
+          "[--overdraw heatmap.ppm] [--physics off|on] [--satellites N] "
+          "[--storage entities|things]\n";
+}
+
+bool parseArgs(int argc, char** argv, BenchConfig& cfg) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      cerr << "bench: " << arg << " needs a value\n";
+      return false;
+    }
+    const char* value = argv[++i];
+    if (arg == "--size")
+      cfg.size = (int)strtod(value, nullptr); // so that 1e5 works
+    else if (arg == "--seed")
+      cfg.seed = strtoul(value, nullptr, 10);
+    else if (arg == "--frames")
+      cfg.frames = atoi(value);
+    else if (arg == "--warmup")
+      cfg.warmup = atoi(value);
+    else if (arg == "--path")
+      cfg.path = value;
+    else if (arg == "--width")
+      cfg.width = atoi(value);
+    else if (arg == "--height")
+      cfg.height = atoi(value);
+    else if (arg == "--label")
+      cfg.label = value;
+    else if (arg == "--out")
+      cfg.out = value;
+    else if (arg == "--trace")
+      cfg.trace = value;
+    else if (arg == "--pacing") {
+      cfg.pacing_name = value;
+      if (!parsePacingMode(value, cfg.pacing)) {
+        cerr << "bench: unknown pacing mode " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--frames-in-flight")
+      cfg.pacing.max_frames_in_flight = atoi(value);
+    else if (arg == "--threads")
+      cfg.threads = atoi(value);
+    else if (arg == "--simd") {
+      if (!vglParseSimdLevel(value, cfg.simd)) {
+        cerr << "bench: unknown SIMD level " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--replay") {
+      cfg.replay = value;
+      cfg.path = "replay";
+    } else if (arg == "--views") {
+      cfg.views = atoi(value);
+      if (cfg.multiview.empty())
+        cfg.multiview = "shared";
+    } else if (arg == "--multiview")
+      cfg.multiview = value;
+    else if (arg == "--background") {
+      cfg.background = atof(value);
+      if (cfg.background <= 0 && strcmp(value, "off") != 0) {
+        cerr << "bench: background scale must be positive or off\n";
+        return false;
+      }
+    } else if (arg == "--upscale") {
+      if (!vglParseUpscale(value, cfg.upscale)) {
+        cerr << "bench: unknown upscale filter " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--dynamic-resolution") {
+      cfg.dynamic_resolution.budget_ms = atof(value);
+      if (cfg.dynamic_resolution.budget_ms <= 0) {
+        cerr << "bench: the frame time budget must be positive\n";
+        return false;
+      }
+    } else if (arg == "--min-scale")
+      cfg.dynamic_resolution.min_scale = atof(value);
+    else if (arg == "--max-scale")
+      cfg.dynamic_resolution.max_scale = atof(value);
+    else if (arg == "--overdraw")
+      cfg.overdraw = value;
+    else if (arg == "--order") {
+      cfg.order = value;
+      if (cfg.order != "depth" && cfg.order != "submission") {
+        cerr << "bench: unknown draw order " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--physics") {
+      if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+        cerr << "bench: --physics takes on or off\n";
+        return false;
+      }
+      cfg.physics = strcmp(value, "on") == 0;
+    } else if (arg == "--storage") {
+      cfg.storage = value;
+      if (cfg.storage != "entities" && cfg.storage != "things") {
+        cerr << "bench: unknown storage " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--satellites") {
+      if (!vglParseInt(value, 0, max_satellites, cfg.satellites)) {
+        cerr << "bench: --satellites takes a number from 0 to " << max_satellites << ", not " << value << '\n';
+        return false;
+      }
+    } else if (arg == "--post") {
+      cfg.post = value;
+      if (cfg.post != "off" && cfg.post != "fused" && cfg.post != "separate") {
+        cerr << "bench: unknown post-processing mode " << value << '\n';
+        return false;
+      }
+    } else {
+      cerr << "bench: unknown option " << arg << '\n';
+      return false;
+    }
+  }
+  if (cfg.size <= 0 || cfg.frames <= 0 || cfg.warmup < 0 || cfg.pacing.max_frames_in_flight <= 0 || cfg.threads < 0) {
+    cerr << "bench: size, frames and frames in flight must be positive, threads cannot be negative\n";
+    return false;
+  }
+  if (cfg.path != "orbit" && cfg.path != "dolly" && cfg.path != "static" && (cfg.path != "replay" || cfg.replay.empty())) {
+    cerr << "bench: unknown camera path " << cfg.path << '\n';
+    return false;
+  }
+  if (cfg.views < 1 || cfg.views > (int)max_views) {
+    cerr << "bench: views must be between 1 and " << max_views << '\n';
+    return false;
+  }
+  if (!cfg.multiview.empty() && cfg.multiview != "shared" && cfg.multiview != "independent") {
+    cerr << "bench: unknown multi-view mode " << cfg.multiview << '\n';
+    return false;
+  }
+  auto& dynamic = cfg.dynamic_resolution;
+  if (!(dynamic.min_scale > 0 && dynamic.min_scale <= dynamic.max_scale && dynamic.max_scale <= 1)) {
+    cerr << "bench: scales must satisfy 0 < min-scale <= max-scale <= 1\n";
+    return false;
+  }
+  if (!cfg.multiview.empty() && !cfg.overdraw.empty()) {
+    cerr << "bench: overdraw is only counted with a single view\n";
+    return false;
+  }
+  if (cfg.satellites > 0 && (cfg.physics || !cfg.multiview.empty())) {
+    cerr << "bench: satellites cannot be combined with --physics, --views or --multiview\n";
+    return false;
+  }
+  bool needs_things = cfg.physics || cfg.satellites > 0 || !cfg.multiview.empty();
+  if (cfg.storage.empty())
+    cfg.storage = needs_things ? "things" : "entities";
+  if (cfg.storage == "entities" && needs_things) {
+    cerr << "bench: --physics, --satellites, --views and --multiview need --storage things\n";
+    return false;
+  }
+  if (!cfg.multiview.empty() && !cfg.replay.empty()) {
+    cerr << "bench: a replay flies one camera, it cannot be combined with --views or --multiview\n";
+    return false;
+  }
+  return true;
+}
+
+// Where the camera is on `frame`. Only depends on the frame number,
+// never on the wall clock, so every run sees exactly the same images.
+void scriptedCamera(const BenchConfig& cfg, int frame, double extent, CameraState& cam) {
+  double t = (double)frame / cfg.frames;
+  if (cfg.path == "orbit") {
+    // Circle the scene once, looking at the middle
+    double radius = extent * 2.5;
+    double angle = 2 * M_PI * t;
+    cam.setPosition(glm::vec3(radius * sin(angle), extent * 0.5, radius * cos(angle)));
+    cam.lookAlong(-cam.position());
+  } else if (cfg.path == "dolly") {
+    // Fly straight through the scene
+    cam.setPosition(glm::vec3(0, 0, extent * (2.5 - 5 * t)));
+    cam.lookAlong(glm::vec3(0, 0, -1));
+  } else {
+    cam.setPosition(glm::vec3(0, 0, extent * 2.5));
+    cam.lookAlong(glm::vec3(0, 0, -1));
+  }
+}
+
+// The window split into a grid of views, filled row by row from the top left
+vector<View> gridViews(const BenchConfig& cfg, vector<CameraState>& cams) {
+  int columns = (int)ceil(sqrt(cfg.views));
+  int rows = (cfg.views + columns - 1) / columns;
+  GLsizei width = cfg.width / columns, height = cfg.height / rows;
+  vector<View> views;
+  for (int v = 0; v < cfg.views; v++) {
+    int row = v / columns, column = v % columns;
+    views.push_back(View{&cams[v], column * width, cfg.height - (row + 1) * height, width, height});
+    cams[v].setAspectRatio((double)width / height);
+  }
+  return views;
+}
+
+// The simulation's default rate. Replaying in steps of the same length flies
+// exactly the path the camera took in main.
+constexpr double replay_step = 1. / 120;
+
+// Feed the recording up to `frame` and move the camera the way the simulation
+// does. `replay_time` is the replay's clock, it starts at 0.
+void replayCamera(InputReplay& replay, int frame, double& replay_time, CameraState& cam) {
+  double frame_time = frame / 60.;
+  while (replay_time <= frame_time) {
+    replay.feed(replay_time, cam);
+    handleKeys(cam, replay_time, replay_step);
+    replay_time += replay_step;
+  }
+}
+
+// `s` as a JSON string, quotes included: a label or the driver's renderer name may have anything in it
+string jsonString(const char* s) {
+  string quoted = "\"";
+  for (; s && *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof escaped, "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+string jsonString(const string& s) {
+  return jsonString(s.c_str());
+}
+
+// Frames where `field` is negative were not measured and are left out
+void writeStage(ostream& out, const char* name, const vector<FrameStats>& frames, double FrameStats::*field) {
+  vector<double> samples;
+  samples.reserve(frames.size());
+  for (auto& f : frames)
+    if (f.*field >= 0)
+      samples.push_back(f.*field);
+  auto p = percentiles(samples);
+  out << "    " << jsonString(name) << ": {\"p50\": " << p.p50 << ", \"p95\": " << p.p95
+      << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << ", \"mean\": " << p.mean << "}";
+}
+
+#ifdef __OPTIMIZE__
+const char* build_kind = "optimized";
+#else
+const char* build_kind = "debug";
+#endif
+
+void writeStartup(ostream& out, const StartupGraph& startup) {
+  auto phases = startup.phases();
+  for (size_t i = 0; i < phases.size(); i++) {
+    auto& phase = phases[i];
+    out << "    " << jsonString(phase.name) << ": {\"begin\": " << phase.begin_ms << ", \"end\": " << phase.end_ms
+        << ", \"thread\": " << phase.thread << "}" << (i + 1 < phases.size() ? ",\n" : "\n");
+  }
+}
+
+// Means over the measured frames' steps, and the largest island of any
+void writePhysics(ostream& out, const vector<PhysicsStats>& steps) {
+  PhysicsStats sum;
+  size_t largest_island = 0;
+  for (auto& s : steps) {
+    sum.pairs += s.pairs;
+    sum.contacts += s.contacts;
+    sum.islands += s.islands;
+    largest_island = max(largest_island, s.largest_island);
+    sum.broadphase_ms += s.broadphase_ms;
+    sum.narrowphase_ms += s.narrowphase_ms;
+    sum.islands_ms += s.islands_ms;
+    sum.solve_ms += s.solve_ms;
+    sum.integrate_ms += s.integrate_ms;
+  }
+  double n = max<size_t>(steps.size(), 1);
+  out << "  \"physics\": {\"pairs\": " << sum.pairs / n << ", \"contacts\": " << sum.contacts / n
+      << ", \"islands\": " << sum.islands / n << ", \"largest_island\": " << largest_island
+      << ",\n    \"ms\": {\"broadphase\": " << sum.broadphase_ms / n << ", \"narrowphase\": " << sum.narrowphase_ms / n
+      << ", \"islands\": " << sum.islands_ms / n << ", \"solve\": " << sum.solve_ms / n
+      << ", \"integrate\": " << sum.integrate_ms / n << "}},\n";
+}
+
+void writeReport(ostream& out, const BenchConfig& cfg, const vector<FrameStats>& frames, double scene_ms,
+                 const StartupGraph& startup, double first_frame_ms, const SceneResources& scene, uint64_t gpu_dropped,
+                 const vector<PhysicsStats>& physics) {
+  bool single_view = cfg.multiview.empty();
+  bool viewport_arrays = scene.viewport_arrays;
+  // What the pass ended up with after clamping
+  float background = scene.background ? scene.background->scale() : 0;
+  bool dynamic = cfg.dynamic_resolution.budget_ms > 0;
+  uint64_t draw_calls = 0, gl_calls = 0, bytes_uploaded = 0, arena_bytes = 0, arena_peak = 0, gpu_measured = 0;
+  for (auto& f : frames) {
+    gpu_measured += f.gpu_ms >= 0;
+    draw_calls += f.draw_calls;
+    gl_calls += f.gl_calls;
+    bytes_uploaded += f.bytes_uploaded;
+    arena_bytes += f.arena_bytes;
+    arena_peak = max(arena_peak, f.arena_bytes);
+  }
+
+  out << "{\n";
+  out << "  \"label\": " << jsonString(cfg.label) << ",\n";
+  out << "  \"build\": \"" << build_kind << "\",\n";
+  out << "  \"renderer\": " << jsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << ",\n";
+  out << "  \"size\": " << cfg.size << ",\n";
+  out << "  \"seed\": " << cfg.seed << ",\n";
+  out << "  \"path\": \"" << cfg.path << "\",\n";
+  if (!cfg.replay.empty())
+    out << "  \"replay\": " << jsonString(cfg.replay) << ",\n";
+  out << "  \"pacing\": \"" << cfg.pacing_name << "\",\n";
+  out << "  \"frames_in_flight\": " << cfg.pacing.max_frames_in_flight << ",\n";
+  out << "  \"threads\": " << cfg.threads << ",\n";
+  out << "  \"simd\": \"" << vglSimdLevelName(vglSimdLevel()) << "\",\n";
+  if (!cfg.multiview.empty()) {
+    out << "  \"views\": " << cfg.views << ",\n";
+    out << "  \"multiview\": \"" << cfg.multiview << "\",\n";
+    out << "  \"viewport_arrays\": " << (viewport_arrays ? "true" : "false") << ",\n";
+  }
+  out << "  \"background_scale\": " << background << ",\n";
+  if (dynamic) {
+    auto& dr = cfg.dynamic_resolution;
+    out << "  \"dynamic_resolution\": {\"budget_ms\": " << dr.budget_ms << ", \"min_scale\": " << dr.min_scale
+        << ", \"max_scale\": " << dr.max_scale << "},\n";
+  }
+  if (background > 0 || dynamic)
+    out << "  \"upscale\": \"" << vglUpscaleName(cfg.upscale) << "\",\n";
+  if (scene.post) {
+    out << "  \"post\": {\"mode\": \"" << cfg.post << "\", \"passes\": " << scene.post->passes()
+        << ", \"pooled_targets\": " << scene.targets->size() << ", \"target_allocations\": " << scene.targets->allocations() << "},\n";
+  }
+  out << "  \"order\": \"" << cfg.order << "\",\n";
+  out << "  \"storage\": \"" << cfg.storage << "\",\n";
+  if (cfg.satellites > 0)
+    out << "  \"satellites\": " << cfg.satellites << ",\n";
+  if (cfg.physics)
+    writePhysics(out, physics);
+  out << "  \"frames\": " << frames.size() << ",\n";
+  out << "  \"warmup\": " << cfg.warmup << ",\n";
+  out << "  \"resolution\": [" << cfg.width << ", " << cfg.height << "],\n";
+  out << "  \"scene_generation_ms\": " << scene_ms << ",\n";
+  out << "  \"time_to_first_frame_ms\": " << first_frame_ms << ",\n";
+  out << "  \"startup_ms\": {\n";
+  writeStartup(out, startup);
+  out << "  },\n";
+  out << "  \"cpu_ms\": {\n";
+  writeStage(out, "frame", frames, &FrameStats::frame_ms);
+  out << ",\n";
+  writeStage(out, "input", frames, &FrameStats::input_ms);
+  out << ",\n";
+  if (cfg.physics) {
+    writeStage(out, "physics", frames, &FrameStats::physics_ms);
+    out << ",\n";
+  }
+  writeStage(out, "update", frames, &FrameStats::update_ms);
+  out << ",\n";
+  writeStage(out, "cull", frames, &FrameStats::cull_ms);
+  out << ",\n";
+  writeStage(out, "sort", frames, &FrameStats::sort_ms);
+  out << ",\n";
+  writeStage(out, "record", frames, &FrameStats::record_ms);
+  out << ",\n";
+  writeStage(out, "submit", frames, &FrameStats::submit_ms);
+  out << ",\n";
+  writeStage(out, "swap", frames, &FrameStats::swap_ms);
+  out << ",\n";
+  writeStage(out, "pace", frames, &FrameStats::pace_ms);
+  out << ",\n";
+  writeStage(out, "input_to_swap", frames, &FrameStats::latency_ms);
+  out << "\n  },\n";
+  // Over the frames whose timer query came back, a few frames late
+  out << "  \"gpu_ms\": {\n";
+  writeStage(out, "frame", frames, &FrameStats::gpu_ms);
+  out << ",\n    \"measured\": " << gpu_measured << ", \"dropped\": " << gpu_dropped << "\n  },\n";
+  if (single_view) {
+    // Over the frames whose query came back, like the GPU time
+    out << "  \"overdraw\": {\n";
+    writeStage(out, "opaque", frames, &FrameStats::opaque_overdraw);
+    out << ",\n";
+    writeStage(out, "background_samples", frames, &FrameStats::background_samples);
+    out << ",\n";
+    writeStage(out, "opaque_samples", frames, &FrameStats::opaque_samples);
+    out << ",\n";
+    writeStage(out, "transparent_samples", frames, &FrameStats::transparent_samples);
+    out << ",\n";
+    writeStage(out, "present_samples", frames, &FrameStats::present_samples);
+    if (!cfg.overdraw.empty()) {
+      out << ",\n";
+      writeStage(out, "mean", frames, &FrameStats::overdraw_mean);
+      out << ",\n";
+      writeStage(out, "max", frames, &FrameStats::overdraw_max);
+      out << ",\n    \"heatmap\": " << jsonString(cfg.overdraw);
+    }
+    out << "\n  },\n";
+  }
+  if (dynamic) {
+    out << "  \"resolution_scale\": [";
+    for (size_t i = 0; i < frames.size(); i++)
+      out << (i ? ", " : "") << frames[i].resolution_scale;
+    out << "],\n";
+  }
+  out << "  \"per_frame\": {\"draw_calls\": " << (double)draw_calls / frames.size()
+      << ", \"gl_calls\": " << (double)gl_calls / frames.size()
+      << ", \"bytes_uploaded\": " << (double)bytes_uploaded / frames.size()
+      << ", \"arena_bytes\": " << (double)arena_bytes / frames.size()
+      << ", \"arena_peak_bytes\": " << arena_peak << "}\n";
+  out << "}\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+  auto process_start = chrono::steady_clock::now();
+  BenchConfig cfg;
+  if (!parseArgs(argc, argv, cfg)) {
+    usage();
+    return 2;
+  }
+
+#ifndef __OPTIMIZE__
+  cerr << "bench: this is a debug build, the timings are not representative\n";
+#endif
+
+  VGL_PROFILE_THREAD("main");
+  // Same job system for loading as for rendering
+  JobSystem jobs(cfg.threads - 1);
+  cfg.threads = jobs.threads();
+  vglSetSimdLevel(cfg.simd);
+  StartupGraph startup(jobs, process_start);
+
+  GLFWwindow* window = NULL;
+  ResourceManager resources;
+  SceneResources scene;
+  vector<Thing> things;
+  EntityWorld world;
+  bool entities = cfg.storage == "entities";
+
+  auto glfw = startup.add("init GLFW", StartupGraph::Context, [] {
+    if (!glfwInit())
+      throw runtime_error{"Cannot initialize GLFW!"};
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    // Headless: the window is never shown. It still needs a display (or Xvfb) to get a context.
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    VGL_GL_DEBUG_HINTS();
+  });
+
+  auto created = startup.add("create window", StartupGraph::Context, [&window, &cfg] {
+    window = glfwCreateWindow(cfg.width, cfg.height, "bench", NULL, NULL);
+    if (window == NULL)
+      throw runtime_error{"Failed to create GLFW window"};
+    glfwMakeContextCurrent(window);
+  }, {glfw});
+
+  auto context = startup.add("load GL", StartupGraph::Context, [] {
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+      throw runtime_error{"Failed to initialize GLAD"};
+    VGL_GL_DEBUG_INIT();
+    VGL_PROFILE_GPU_INIT();
+  }, {created});
+
+  addSceneResourceSteps(startup, context, resources, scene);
+
+  auto generate = startup.add("generate scene", StartupGraph::Any, [&things, &world, &cfg] {
+    if (cfg.storage == "entities") {
+      makeCubeScene(world, cfg.size, cfg.seed);
+      return;
+    }
+    things = makeCubeScene(cfg.size, cfg.seed);
+    if (cfg.satellites > 0)
+      addSatellites(things, cfg.satellites, cfg.seed);
+  });
+
+  unique_ptr<InputReplay> replay;
+  if (!cfg.replay.empty()) {
+    startup.add("read replay", StartupGraph::Any, [&replay, &cfg] {
+      replay = make_unique<InputReplay>(cfg.replay);
+    });
+  }
+
+  startup.add("GL state", StartupGraph::Context, [&cfg] {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glViewport(0, 0, cfg.width, cfg.height);
+  }, {context});
+
+  try {
+    startup.run();
+  } catch (const exception& e) {
+    cerr << "bench: " << e.what() << '\n';
+    glfwTerminate();
+    return 1;
+  }
+  if (cfg.background > 0) {
+    scene.background->setScale(cfg.background);
+    scene.background->setUpscale(cfg.upscale);
+  } else {
+    scene.background.reset();
+  }
+  scene.upscale = cfg.upscale;
+  if (cfg.post != "off")
+    enablePostProcessing(resources, scene, cfg.post == "fused");
+  setSceneOutput(scene, cfg.width, cfg.height);
+  // Always on, the report has the GPU time either way
+  auto gpu_timer = make_unique<GpuTimer>();
+  // GL_SAMPLES_PASSED of the single view's passes
+  struct SampleQueries {
+    double FrameStats::*field;
+    unique_ptr<GpuQueryRing> ring;
+  };
+  SampleQueries samples[] = {
+    {&FrameStats::background_samples, make_unique<GpuQueryRing>(GL_SAMPLES_PASSED)},
+    {&FrameStats::opaque_samples, make_unique<GpuQueryRing>(GL_SAMPLES_PASSED)},
+    {&FrameStats::transparent_samples, make_unique<GpuQueryRing>(GL_SAMPLES_PASSED)},
+    {&FrameStats::present_samples, make_unique<GpuQueryRing>(GL_SAMPLES_PASSED)},
+  };
+  auto& present_samples = *samples[3].ring;
+  bool by_depth = cfg.order == "depth";
+  if (!cfg.overdraw.empty()) {
+    cerr << "bench: counting overdraw, the timings are not representative\n";
+    enableOverdrawCounting(resources, scene);
+  }
+  unique_ptr<DynamicResolution> dynamic_resolution;
+  if (cfg.dynamic_resolution.budget_ms > 0)
+    dynamic_resolution = make_unique<DynamicResolution>(cfg.dynamic_resolution);
+  auto generated = startup.phases()[generate];
+  double scene_ms = generated.end_ms - generated.begin_ms;
+  // Same formula makeCubeScene uses for the size of the scene
+  double extent = fmax(1., cbrt(cfg.size / 30.));
+
+  CameraState cam{};
+  cam.setAspectRatio((double)cfg.width / cfg.height);
+  CullCache cull_cache = entities ? CullCache(world) : CullCache(things);
+  // The entities' systems, animateThings at scene_time
+  double scene_time = 0;
+  SystemScheduler systems;
+  addThingSystems(systems, scene_time);
+  unique_ptr<SceneGraph> graph;
+  if (cfg.satellites > 0)
+    graph = make_unique<SceneGraph>(things);
+  double replay_time = 0;
+
+  // Cameras and culling of the multi-view modes
+  vector<CameraState> cams(cfg.multiview.empty() ? 0 : cfg.views);
+  vector<View> views;
+  vector<CullCache> view_caches;
+  if (!cfg.multiview.empty())
+    views = gridViews(cfg, cams);
+  if (cfg.multiview == "independent")
+    view_caches.assign(cfg.views, cull_cache);
+
+  // Uncapped by default: measure the renderer, not the display
+  FramePacer pacer(cfg.pacing);
+  FrameArena arena(cfg.pacing.max_frames_in_flight);
+  double first_frame_ms = 0;
+  vector<float> angles;
+  vector<FrameStats> frames;
+  frames.reserve(cfg.frames);
+  unique_ptr<PhysicsWorld> physics;
+  vector<PhysicsStats> physics_steps;
+  if (cfg.physics) {
+    PhysicsConfig physics_cfg;
+    physics_cfg.seed = cfg.seed;
+    physics = make_unique<PhysicsWorld>(things, physics_cfg);
+  }
+
+  for (int frame = -cfg.warmup; frame < cfg.frames; frame++) {
+    VGL_PROFILE_ZONE("frame");
+    FrameStats stats;
+    stats.pace_ms = pacer.beginFrame();
+    arena.beginFrame();
+    StageClock clock;
+    auto input_time = chrono::steady_clock::now();
+
+    {
+      VGL_PROFILE_ZONE("input");
+      glfwPollEvents();
+      // Warmup frames look at where the replay starts without using any of it
+      if (replay && frame >= 0)
+        replayCamera(*replay, frame, replay_time, cam);
+      else if (!replay)
+        scriptedCamera(cfg, frame < 0 ? 0 : frame, extent, cam);
+      for (int v = 0; v < (int)cams.size(); v++)
+        scriptedCamera(cfg, (max(frame, 0) + v * cfg.frames / cfg.views) % cfg.frames, extent, cams[v]);
+    }
+    stats.input_ms = clock.lap();
+
+    // Fixed 60 Hz step instead of the wall clock
+    double t = frame / 60.;
+    double dt = t * 100; // what the shaders get as time in the interactive program
+    if (physics) {
+      VGL_PROFILE_ZONE("physics");
+      physics->step(jobs, 1 / 60.f);
+      physics->pose(jobs, things, angles);
+      cull_cache.update(things);
+      for (auto& cache : view_caches)
+        cache.update(things);
+      stats.physics_ms = clock.lap();
+      if (frame >= 0)
+        physics_steps.push_back(physics->stats());
+    } else if (entities) {
+      scene_time = t;
+    } else {
+      animateThings(things, t, angles);
+    }
+
+    if (dynamic_resolution) {
+      stats.resolution_scale = dynamic_resolution->nextFrame();
+      setSceneOutput(scene, cfg.width, cfg.height, stats.resolution_scale);
+    }
+
+    if (cfg.multiview == "shared") {
+      MultiViewList multi_view(arena);
+      // Culling goes first, only the things some view can see get transformed
+      cullViews(views, cull_cache.spheres, multi_view);
+      stats.cull_ms = clock.lap();
+      updateViews(jobs, things, angles, multi_view);
+      stats.update_ms = clock.lap();
+      recordViews(resources, scene, multi_view, dt);
+      recordPresent(scene, multi_view.commands);
+      stats.record_ms = clock.lap();
+      gpu_timer->begin();
+      submitViews(multi_view, stats);
+      gpu_timer->end();
+      stats.submit_ms = clock.lap();
+    } else if (cfg.multiview == "independent") {
+      // Every view the whole way through, as if it were the only one
+      vector<DrawList> lists;
+      lists.reserve(views.size());
+      for (size_t v = 0; v < views.size(); v++) {
+        lists.emplace_back(arena);
+        updateScene(jobs, cams[v], things, angles, lists[v]);
+      }
+      stats.update_ms = clock.lap();
+      for (size_t v = 0; v < views.size(); v++)
+        cullScene(cams[v], view_caches[v], lists[v]);
+      stats.cull_ms = clock.lap();
+      for (size_t v = 0; v < views.size(); v++)
+        sortScene(things, lists[v], by_depth);
+      stats.sort_ms = clock.lap();
+      for (size_t v = 0; v < views.size(); v++)
+        recordScene(jobs, resources, scene, lists[v], dt, &views[v], v == 0);
+      recordPresent(scene, lists.back().commands.back());
+      stats.record_ms = clock.lap();
+      gpu_timer->begin();
+      for (auto& list : lists)
+        submitScene(list, stats);
+      gpu_timer->end();
+      stats.submit_ms = clock.lap();
+    } else {
+      DrawList draw_list(arena);
+      if (entities) {
+        systems.run(jobs, world);
+        updateScene(jobs, cam, world, draw_list);
+      } else {
+        updateScene(jobs, cam, things, angles, draw_list, graph.get());
+      }
+      if (graph)
+        cull_cache.update(*graph);
+      stats.update_ms = clock.lap();
+
+      cullScene(cam, cull_cache, draw_list);
+      stats.cull_ms = clock.lap();
+
+      if (entities)
+        sortScene(world, draw_list, by_depth);
+      else
+        sortScene(things, draw_list, by_depth);
+      stats.sort_ms = clock.lap();
+
+      draw_list.samples = PassQueries{samples[0].ring->next(), samples[1].ring->next(), samples[2].ring->next()};
+      recordScene(jobs, resources, scene, draw_list, dt);
+      recordOverdraw(resources, scene, draw_list);
+      auto& last = draw_list.commands.back();
+      last.beginQuery(GL_SAMPLES_PASSED, present_samples.next());
+      recordPresent(scene, last);
+      last.endQuery(GL_SAMPLES_PASSED);
+      stats.record_ms = clock.lap();
+
+      gpu_timer->begin();
+      submitScene(draw_list, stats);
+      gpu_timer->end();
+      for (auto& pass : samples)
+        pass.ring->submitted();
+      if (scene.overdraw)
+        scene.overdraw->read(stats.overdraw_mean, stats.overdraw_max);
+      stats.submit_ms = clock.lap();
+    }
+    stats.arena_bytes = arena.frameBytes();
+    resources.collect();
+
+    {
+      VGL_PROFILE_ZONE("swap");
+      glfwSwapBuffers(window);
+    }
+    stats.gl_calls++;
+    stats.swap_ms = clock.lap();
+    if (frame == -cfg.warmup)
+      first_frame_ms = startup.elapsedMs();
+    // The scripted camera counts as input
+    stats.latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - input_time).count();
+    VGL_PROFILE_FRAME();
+    stats.pace_ms += pacer.endFrame();
+
+    stats.frame_ms = stats.pace_ms + stats.input_ms + stats.physics_ms + stats.update_ms + stats.cull_ms + stats.sort_ms +
+                     stats.record_ms + stats.submit_ms + stats.swap_ms;
+    if (frame >= 0)
+      frames.push_back(stats);
+
+    // The timer numbers frames from the first warmup one
+    uint64_t measured;
+    double gpu_ms;
+    if (gpu_timer->poll(measured, gpu_ms)) {
+      if (dynamic_resolution)
+        dynamic_resolution->report(measured, gpu_ms);
+      if (measured >= (uint64_t)cfg.warmup && measured - cfg.warmup < frames.size())
+        frames[measured - cfg.warmup].gpu_ms = gpu_ms;
+    }
+    // Numbered the same way, they only run with the single view
+    for (auto& pass : samples) {
+      GLuint64 passed;
+      if (pass.ring->poll(measured, passed) && measured >= (uint64_t)cfg.warmup && measured - cfg.warmup < frames.size())
+        frames[measured - cfg.warmup].*pass.field = passed;
+    }
+  }
+
+  // Per pixel of the scene: the opaque samples are what sorting brings down
+  for (auto& f : frames)
+    if (f.opaque_samples >= 0)
+      f.opaque_overdraw = f.opaque_samples / (f.resolution_scale * cfg.width * f.resolution_scale * cfg.height);
+
+  if (scene.overdraw && !frames.empty()) {
+    try {
+      scene.overdraw->writeHeatmap(cfg.overdraw, fmax(1, frames.back().overdraw_max));
+    } catch (const exception& e) {
+      cerr << "bench: " << e.what() << '\n';
+    }
+  }
+
+  if (cfg.out.empty()) {
+    writeReport(cout, cfg, frames, scene_ms, startup, first_frame_ms, scene, gpu_timer->dropped(), physics_steps);
+  } else {
+    ofstream out(cfg.out);
+    writeReport(out, cfg, frames, scene_ms, startup, first_frame_ms, scene, gpu_timer->dropped(), physics_steps);
+  }
+
+  if (!cfg.trace.empty()) {
+#ifdef VGL_PROFILE
+    VGL_PROFILE_EXPORT(cfg.trace.c_str());
+#else
+    cerr << "bench: --trace needs a build with PROFILE=1, no trace written\n";
+#endif
+  }
+
+  gpu_timer.reset();
+  for (auto& pass : samples)
+    pass.ring.reset();
+  destroySceneResources(resources, scene);
+  resources.destroyAll();
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Run the benchmark over scene sizes 1e2..1e7 and collect one JSON report per line.
+# Usage: ./bench_sweep.sh [output.jsonl] [extra bench options...]
+# Bigger scenes get fewer frames, otherwise the 1e7 run takes forever.
+
+out=${1:-bench_sweep.jsonl}
+[ $# -gt 0 ] && shift
+label=$(git describe --always --dirty 2>/dev/null || echo unknown)
+
+# -O0 numbers are meaningless, so sweep an optimized build unless told otherwise
+make VARIANT=${VARIANT:-release} bench || exit 1
+: > "$out"
+# bench writes into its own file first: sh has no pipefail, a failed run would go unnoticed behind tr
+report=$(mktemp) || exit 1
+trap 'rm -f "$report"' EXIT
+for size in 100 1000 10000 100000 1000000 10000000; do
+  case $size in
+    100|1000|10000) frames=300 ;;
+    100000) frames=100 ;;
+    *) frames=20 ;;
+  esac
+  echo "size $size, $frames frames" >&2
+  ./bench --size $size --frames $frames --label "$label" "$@" > "$report" || exit 1
+  tr -d '\n' < "$report" >> "$out"
+  echo >> "$out"
+done
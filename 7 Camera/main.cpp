@@ -3,14 +3,32 @@
 
 #include "controls.h"
 #include "camera.h"
+#include "dynamic_resolution.h"
+#include "frame_stats.h"
+#include "gl_debug.h"
+#include "gpu_timer.h"
+#include "input_record.h"
+#include "log.h"
+#include "pacing.h"
+#include "physics.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "scene_graph.h"
+#include "simulation.h"
+#include "startup.h"
 #include "things.h"
 #include "vgl.h"
 
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <random>
+#include <stdexcept>
 
 using namespace std;
 
@@ -26,208 +44,377 @@ void tryOutGlm() {
   cout << "Perspective matrix:\n" << glm::to_string(proj) << '\n';
 }
 
-void updateProjectionMatrix (GLFWwindow* window) {
-  auto cam = static_cast<CameraState *>(glfwGetWindowUserPointer(window));
-  updateProjectionMatrix_(cam);
-}
-
 void window_size_callback(GLFWwindow* window, int width, int height)
 {
   auto camera_state = static_cast<CameraState *>(glfwGetWindowUserPointer(window));
-  camera_state->aspect_ratio = (double) width / height;
-  updateProjectionMatrix(window);
+  lock_guard<mutex> lock(camera_state->input_mutex);
+  // The projection follows on next use
+  camera_state->setAspectRatio((double) width / height);
+}
+
+void usage() {
+  cerr << "usage: main [--pacing vsync|uncapped|<fps>] [--frames-in-flight N] [--record input.vgli | --replay input.vgli]\n"
+          "            [--background off|<scale>] [--upscale bilinear|edge] [--dynamic-resolution <budget ms>]\n"
+          "            [--post off|fused|separate] [--physics off|on] [--satellites N]\n";
 }
 
-int main()
+int main(int argc, char** argv)
 {
+  // Time to first frame counts from here
+  auto process_start = chrono::steady_clock::now();
+  PacingConfig pacing;
+  // Input to write to, or to fly the camera with instead of the keyboard and mouse
+  string record_path, replay_path;
+  // Resolution of the background relative to the window, 0 for none
+  float background = background_scale;
+  Upscale upscale = Upscale::Bilinear;
+  // GPU milliseconds a frame may take, the scene's resolution gives way. 0 for the window's resolution.
+  double gpu_budget = 0;
+  string post = "off";
+  // Move and collide the things rather than only spin them
+  bool simulate_physics = false;
+  // Cubes attached to every cube
+  int satellites = 0;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--pacing" && i + 1 < argc && parsePacingMode(argv[i + 1], pacing)) {
+      i++;
+    } else if (arg == "--frames-in-flight" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+      pacing.max_frames_in_flight = atoi(argv[++i]);
+    } else if (arg == "--record" && i + 1 < argc && replay_path.empty()) {
+      record_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc && record_path.empty()) {
+      replay_path = argv[++i];
+    } else if (arg == "--background" && i + 1 < argc && (string{argv[i + 1]} == "off" || atof(argv[i + 1]) > 0)) {
+      background = atof(argv[++i]);
+    } else if (arg == "--upscale" && i + 1 < argc && vglParseUpscale(argv[i + 1], upscale)) {
+      i++;
+    } else if (arg == "--dynamic-resolution" && i + 1 < argc && atof(argv[i + 1]) > 0) {
+      gpu_budget = atof(argv[++i]);
+    } else if (arg == "--post" && i + 1 < argc &&
+               (string{argv[i + 1]} == "off" || string{argv[i + 1]} == "fused" || string{argv[i + 1]} == "separate")) {
+      post = argv[++i];
+    } else if (arg == "--physics" && i + 1 < argc && (string{argv[i + 1]} == "off" || string{argv[i + 1]} == "on")) {
+      simulate_physics = string{argv[++i]} == "on";
+    } else if (arg == "--satellites" && i + 1 < argc && vglParseInt(argv[i + 1], 0, max_satellites, satellites)) {
+      i++;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  // The simulation only takes things on their own
+  if (simulate_physics && satellites > 0) {
+    usage();
+    return 2;
+  }
+
+  VGL_PROFILE_THREAD("main");
+  // Up first, so that its workers can read and decode while the window comes up
+  JobSystem jobs;
+  StartupGraph startup(jobs, process_start);
+
+  GLFWwindow* window = NULL;
+  CameraState cam{};
+  ResourceManager resources;
+  SceneResources scene;
+  // The cubes are entities, unless physics or satellites want them as things
+  bool entities = !simulate_physics && satellites == 0;
+  vector<Thing> things;
+  EntityWorld world;
+
   // glfw: initialize and configure
   // ------------------------------
-  if (!glfwInit()) {
-    cout << "Cannot initialize GLFW!";
-    return -1;
-  };
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  auto glfw = startup.add("init GLFW", StartupGraph::Context, [] {
+    if (!glfwInit())
+      throw runtime_error{"Cannot initialize GLFW!"};
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-  // Enable vsync
-  glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
+    // Vsync is up to the FramePacer below
+    glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
 
 #ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
 #endif
+    VGL_GL_DEBUG_HINTS();
+  });
 
   // glfw window creation
   // --------------------
-  GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-  if (window == NULL)
-    {
-      std::cout << "Failed to create GLFW window" << std::endl;
-      glfwTerminate();
-      return -1;
+  auto created = startup.add("create window", StartupGraph::Context, [&window, &cam, &replay_path] {
+    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL)
+      throw runtime_error{"Failed to create GLFW window"};
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    glfwSetWindowUserPointer(window, &cam);
+
+    // update the projection matrix whenever the window changes
+    glfwSetWindowSizeCallback(window, window_size_callback);
+
+    // Capture the mouse cursor
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // A replay flies the camera on its own, live input would only get in the way
+    if (replay_path.empty()) {
+      glfwSetKeyCallback(window, keyCallback);
+      // Setup the mouse callback
+      glfwSetCursorPosCallback(window, mouse_callback);
+      glfwSetMouseButtonCallback(window, mouse_button_callback);
     }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-  CameraState cam{};
-  glfwSetWindowUserPointer(window, &cam);
-
-  // update the projection matrix whenever the window changes
-  glfwSetWindowSizeCallback(window, window_size_callback);
-
-  glfwSetKeyCallback(window, keyCallback);
+  }, {glfw});
 
-  // Capture the mouse cursor
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-  // Setup the mouse callback
-  glfwSetCursorPosCallback(window, mouse_callback);  
-  glfwSetMouseButtonCallback(window, mouse_button_callback);
+  unique_ptr<InputReplay> replay;
+  if (!replay_path.empty()) {
+    startup.add("read replay", StartupGraph::Any, [&replay, &replay_path] {
+      replay = make_unique<InputReplay>(replay_path);
+    });
+  }
 
   // glad: load all OpenGL function pointers
   // ---------------------------------------
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-      std::cout << "Failed to initialize GLAD" << std::endl;
-      return -1;
+  auto context = startup.add("load GL", StartupGraph::Context, [] {
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+      throw runtime_error{"Failed to initialize GLAD"};
+    VGL_GL_DEBUG_INIT();
+    VGL_PROFILE_GPU_INIT();
+  }, {created});
+
+  addSceneResourceSteps(startup, context, resources, scene);
+
+  startup.add("generate scene", StartupGraph::Any, [&things, &world, entities, satellites] {
+    if (entities) {
+      makeCubeScene(world, 30);
+      return;
     }
+    things = makeCubeScene(30);
+    if (satellites > 0)
+      addSatellites(things, satellites);
+  });
+
+  startup.add("GL state", StartupGraph::Context, [&window] {
+    // Enable transparency
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Enable depth testing
+    glEnable(GL_DEPTH_TEST);
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+
+    // Set up the perspective projection
+    window_size_callback(window, SCR_WIDTH, SCR_HEIGHT);
+  }, {context});
+
+  try {
+    startup.run();
+  } catch (const exception& e) {
+    cerr << e.what() << '\n';
+    glfwTerminate();
+    return -1;
+  }
+  if (background > 0) {
+    scene.background->setScale(background);
+    scene.background->setUpscale(upscale);
+  } else {
+    scene.background.reset();
+  }
+  scene.upscale = upscale;
+  if (post != "off")
+    enablePostProcessing(resources, scene, post == "fused");
 
-  auto ponyShader = vglBuildShaderFromFile("transpose_vert.glsl", "texture_frag.glsl");
-  auto bgShader = vglBuildShaderFromFile("transpose_vert.glsl", "psychedelic_frag.glsl");
-
-
-  unsigned int VBO, VAO, EBO;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-  // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-  glBindVertexArray(VAO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vglCubeVerticesSize, vglCubeVertices, GL_STATIC_DRAW);
-
-  // position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  // texture coordinate
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (float*)0+3);
-  glEnableVertexAttribArray(1);
-
-  // needs to be called before setting up uniforms by vglLoadTexture
-  glUseProgram(ponyShader);
-
-  GLuint pony_texture;
-  pony_texture = vglLoadTexture("../resources/container.jpg", "pony", ponyShader, 0, GL_RGB);
-
-  /* Variable 'time' is used for the fade effect. */
-  auto pony_time_loc = glGetUniformLocation(ponyShader, "time");
-  // Actually the uniform can be -1 if it's not used.
-  // This is not considered an error.
-  // See https://community.khronos.org/t/keep-unused-shader-variables-for-debugging/61280/5
-  // if (time < 0) { q  
-  //   std::cerr << "time oof\n";
-  //   return 1;
-  // }
   auto t1 = std::chrono::high_resolution_clock::now();
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, pony_texture);
-
-  // Enable transparency
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  // Enable depth testing
-  glEnable(GL_DEPTH_TEST);
-
-  // Experiement with GLM									  
+  // Experiement with GLM
   tryOutGlm();
-  
-  auto things = makeCubeScene(30);
-
-  auto pony_tm_uniform_location = glGetUniformLocation(ponyShader, "tm");
-  auto background_tm_uniform_location = glGetUniformLocation(bgShader, "tm");
-
-  glm::mat4 identity_matrix = glm::mat4(1.0f);
-
-  // Set up the perspective projection
-  window_size_callback(window, SCR_WIDTH, SCR_HEIGHT);
 
-  glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+  // Camera movement and spinning things run at a fixed rate on their own thread.
+  // What gets rendered is `view`, blended from the simulation's snapshots.
+  // Entities are spun by their systems instead, at the snapshot's time.
+  unique_ptr<InputRecorder> recorder;
+  if (!record_path.empty()) {
+    try {
+      // Starts with the simulation's clock, which is what a replay lines up with
+      recorder = make_unique<InputRecorder>(record_path, glfwGetTime());
+    } catch (const exception& e) {
+      cerr << e.what() << '\n';
+      glfwTerminate();
+      return -1;
+    }
+    cam.recorder = recorder.get();
+  }
+  Simulation sim(cam, things, 120, replay.get());
+  sim.start();
+  SimSnapshot frame_state;
+  CameraState view{};
+  CullCache cull_cache = entities ? CullCache(world) : CullCache(things);
+  double scene_time = 0;
+  SystemScheduler systems;
+  addThingSystems(systems, scene_time);
+  // Stepped here rather than on the simulation's thread, which is not one
+  // of the job system's, so that the phases get spread over the workers.
+  // The simulation keeps the camera; the spin it works out is not used.
+  unique_ptr<PhysicsWorld> physics;
+  vector<float> physics_angles;
+  constexpr double physics_step = 1. / 120;
+  // No more steps than this per frame: after a stall the bodies slow down
+  // for a moment rather than the frames falling further and further behind
+  constexpr int max_physics_steps = 4;
+  double physics_time = glfwGetTime();
+  if (simulate_physics)
+    physics = make_unique<PhysicsWorld>(things);
+  unique_ptr<SceneGraph> graph;
+  if (satellites > 0)
+    graph = make_unique<SceneGraph>(things);
+
+  // Goes before the context does, see below
+  auto gpu_timer = make_unique<GpuTimer>();
+  unique_ptr<DynamicResolution> dynamic_resolution;
+  if (gpu_budget > 0) {
+    DynamicResolutionConfig dynamic;
+    dynamic.budget_ms = gpu_budget;
+    dynamic_resolution = make_unique<DynamicResolution>(dynamic);
+  }
+
+  FramePacer pacer(pacing);
+  FrameArena arena(pacing.max_frames_in_flight);
+  // Input timestamp of the previous frame, so that the latency of an input is only counted once
+  double latched_input_time = 0;
+  vector<double> latencies;
+  bool first_frame = true;
 
   // render loop
   // -----------
   while (!glfwWindowShouldClose(window))
     {
-      // input
-      // -----
-      processInput(window);
+      VGL_PROFILE_ZONE("frame");
 
-      handleKeys(cam);
+      FrameStats stats;
+      stats.pace_ms = pacer.beginFrame();
+      arena.beginFrame();
+      double frame_input_time = -1;
 
-      int state;
+      // input
+      // -----
+      {
+        VGL_PROFILE_ZONE("input");
+        processInput(window);
+        // The recording ends about where its session did
+        if (replay && replay->finished())
+          glfwSetWindowShouldClose(window, true);
+      }
 
       // render
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      // No need to use glUseProgram every frame because there's only one shader
-      // https://stackoverflow.com/questions/64089592/why-is-gluseprogram-called-every-frame-with-gluniform
-      // glUseProgram(shaderProgram);
-      
       auto t2 = std::chrono::high_resolution_clock::now();
       auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() / 10.;
 
-      // Render background
-      glUseProgram(bgShader);
-
-      auto background_time_loc = glGetUniformLocation(bgShader, "time");
-      glUniformMatrix4fv(background_tm_uniform_location, 1, GL_FALSE, glm::value_ptr(identity_matrix));
-      //cout << background_time_loc << ", " << '\n';
-      glUniform1f(background_time_loc, dt);
-      //cout << "error status: " << glGetError() << '\n';
-      //glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-      // Render ponies
-      glUseProgram(ponyShader);
-
-      glUniform1f(pony_time_loc, (GLfloat)dt);
-
-      for (auto& thing : things) {
-        // Model matrix
-        //cout << "New matrix\n";
-        glm::mat4 model = glm::translate(identity_matrix, thing.pos);
-        //cout << "After translate: " << glm::to_string(tm) << '\n';
-        auto angle = glm::radians<float>(thing.speed * dt);
-        model = glm::rotate(model, angle, thing.rotation_axis);
-        //cout << "After rotate:" << glm::to_string(tm) << '\n';
-        model = glm::scale(model, glm::vec3(thing.scale));
-
-        float radius = 1.5;
-        // rotate clockwise
-        float cameraX = -sin(glfwGetTime()) * radius;
-        float cameraZ = -cos(glfwGetTime()) * radius;
-        glm::vec3 eye = glm::vec3(cameraX, 0, cameraZ);
-        glm::vec3 center = glm::vec3(0.0, 0.0, 0.0);
-        glm::vec3 up = glm::vec3(0.0, 1.0, 0.0);
-        glm::mat4 camera = glm::lookAt(cam.pos, cam.pos + cam.dir, cam.up);
-        glm::mat4 tm = cam.projection * camera * model;
-
-        glUniformMatrix4fv(pony_tm_uniform_location, 1, GL_FALSE, glm::value_ptr(tm));
-
-        // Draw pone
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 14); // 14 vertices represent 1 cube
-      }
+      sim.sample(glfwGetTime(), frame_state);
 
-      // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-      // -------------------------------------------------------------------------------
-      glfwSwapBuffers(window);
+      // Late latch: pick up the mouse movement that arrived while we were waiting,
+      // right before the view matrix gets built. Looking around is what makes
+      // latency noticeable, so take the orientation straight from the input
+      // rather than from the (older) simulation step.
       glfwPollEvents();
+      {
+        lock_guard<mutex> lock(cam.input_mutex);
+        frame_state.cam_orientation = cam.orientation();
+        if (cam.last_input_time != latched_input_time)
+          frame_input_time = latched_input_time = cam.last_input_time;
+      }
+      Simulation::applyCamera(frame_state, view);
+
+      {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        if (dynamic_resolution)
+          stats.resolution_scale = dynamic_resolution->nextFrame();
+        setSceneOutput(scene, width, height, stats.resolution_scale);
+      }
+
+      if (physics) {
+        VGL_PROFILE_ZONE("physics");
+        double now = glfwGetTime();
+        int physics_steps = 0;
+        for (; physics_time + physics_step <= now && physics_steps < max_physics_steps; physics_steps++) {
+          physics->step(jobs, physics_step);
+          physics_time += physics_step;
+        }
+        if (physics_steps == max_physics_steps)
+          physics_time = fmax(physics_time, now - physics_step);
+        physics->pose(jobs, things, physics_angles);
+        cull_cache.update(things);
+      }
+      auto& angles = physics ? physics_angles : frame_state.angles;
+
+      DrawList draw_list(arena);
+      if (entities) {
+        scene_time = frame_state.time;
+        systems.run(jobs, world);
+        updateScene(jobs, view, world, draw_list);
+      } else {
+        updateScene(jobs, view, things, angles, draw_list, graph.get());
+      }
+      if (graph)
+        cull_cache.update(*graph);
+      cullScene(view, cull_cache, draw_list);
+      if (entities)
+        sortScene(world, draw_list);
+      else
+        sortScene(things, draw_list);
+      recordScene(jobs, resources, scene, draw_list, dt);
+      recordPresent(scene, draw_list.commands.back());
+      gpu_timer->begin();
+      submitScene(draw_list, stats);
+      gpu_timer->end();
+      stats.arena_bytes = arena.frameBytes();
+      resources.collect();
+
+      // glfw: swap buffers (IO events are polled above, as late as possible)
+      // -------------------------------------------------------------------
+      {
+        VGL_PROFILE_ZONE("swap");
+        glfwSwapBuffers(window);
+      }
+      if (first_frame) {
+        first_frame = false;
+        cout << "Time to first frame: " << startup.elapsedMs() << " ms\n";
+        startup.print(cout);
+      }
+      if (frame_input_time >= 0) {
+        stats.latency_ms = (glfwGetTime() - frame_input_time) * 1000;
+        latencies.push_back(stats.latency_ms);
+      }
+      uint64_t measured;
+      if (gpu_timer->poll(measured, stats.gpu_ms) && dynamic_resolution)
+        dynamic_resolution->report(measured, stats.gpu_ms);
+      VGL_PROFILE_FRAME();
+      stats.pace_ms += pacer.endFrame();
     }
 
+  if (!latencies.empty()) {
+    auto p = percentiles(latencies);
+    cout << "Input-to-swap latency over " << latencies.size() << " frames: p50 " << p.p50
+         << " ms, p95 " << p.p95 << " ms, p99 " << p.p99 << " ms, max " << p.max << " ms\n";
+  }
+
+  VGL_LOG(INFO, Render, "frame arena peak %zu bytes", arena.peakBytes());
+
+#ifdef VGL_PROFILE
+  if (VGL_PROFILE_EXPORT("trace.json"))
+    cout << "Profile written to trace.json\n";
+#endif
+
+  sim.stop();
+  if (recorder)
+    cout << "Recorded " << recorder->events() << " input events to " << record_path << '\n';
+
   // optional: de-allocate all resources once they've outlived their purpose:
   // ------------------------------------------------------------------------
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  glDeleteBuffers(1, &EBO);
+  gpu_timer.reset();
+  destroySceneResources(resources, scene);
+  resources.destroyAll();
 
   // glfw: terminate, clearing all previously allocated GLFW resources.
   // ------------------------------------------------------------------
@@ -0,0 +1,46 @@
+#version 330 core
+// The renderer puts MULTI_VIEWPORT and the #extension it needs right after the
+// #version line when the GL lets the vertex shader pick the viewport.
+layout (location = 0) in vec3 aPos;        // the position variable has attribute position 0
+layout (location = 1) in vec2 in_tex_coords; // the text coordinates have attribute position 1
+
+out vec2 tex_coords; // output texture coordinates
+
+// Four texels per instance: the top three rows of the model matrix, then the
+// mask of the views the instance is in, as bits in x. See ViewInstance.
+uniform samplerBuffer instances;
+uniform mat4 view_projections[16];
+#ifdef MULTI_VIEWPORT
+// One instance per thing and view, the views of a thing next to each other
+uniform int view_count;
+#else
+// One draw per view
+uniform int view;
+#endif
+uniform float time;
+
+void main()
+{
+#ifdef MULTI_VIEWPORT
+    int instance = gl_InstanceID / view_count;
+    int v = gl_InstanceID - instance * view_count;
+    gl_ViewportIndex = v;
+#else
+    int instance = gl_InstanceID;
+    int v = view;
+#endif
+    int base = instance * 4;
+    uint mask = floatBitsToUint(texelFetch(instances, base + 3).x);
+    if ((mask & (1u << uint(v))) == 0u) {
+        // Culled for this view: all vertices on one point outside the clip volume, nothing is rasterized
+        gl_Position = vec4(2, 2, 2, 1);
+        tex_coords = vec2(0);
+        return;
+    }
+    vec4 p = vec4(aPos, 1);
+    vec3 world = vec3(dot(texelFetch(instances, base), p),
+                      dot(texelFetch(instances, base + 1), p),
+                      dot(texelFetch(instances, base + 2), p));
+    gl_Position = view_projections[v] * vec4(world, 1);
+    tex_coords = in_tex_coords;
+}
@@ -4,13 +4,15 @@ in vec2 tex_coords;
 
 out vec4 FragColor;
 
-uniform sampler2D pony;
 uniform float time;
 uniform vec2 center = vec2(1, 2);
+// In pixels, set by FullscreenPass. The pass may shade at a lower resolution
+// than it shows at, so the pixel is worked out from tex_coords, not gl_FragCoord.
+uniform vec2 output_size;
   
 void main()
 {
-    float dist = distance(center, vec2(gl_FragCoord.x, gl_FragCoord.y));
+    float dist = distance(center, tex_coords * output_size);
     float color = abs(sin(dist*0.1-float(time)*0.1));
     FragColor = vec4(0, color, 0, 1.0f);
-}
\ No newline at end of file
+}
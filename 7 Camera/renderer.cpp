@@ -0,0 +1,601 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batch_math.h"
+#include "gl_debug.h"
+#include "log.h"
+#include "profiler.h"
+#include "radix_sort.h"
+#include "renderer.h"
+#include "vgl.h"
+
+using namespace std;
+
+namespace {
+
+const char* const scene_vertex_shader = "transpose_vert.glsl";
+const char* const scene_pony_shader = "texture_frag.glsl";
+const char* const scene_bg_shader = "psychedelic_frag.glsl";
+const char* const scene_texture = "../resources/container.jpg";
+const char* const multi_view_shader = "multiview_vert.glsl";
+
+// What the scene needs from disk, handed from the loading steps to the GL ones
+struct SceneFiles {
+  string vertex_src, pony_src, bg_src, multi_view_src;
+  DecodedImage pony_image;
+};
+
+// The #extension that lets the vertex shader write gl_ViewportIndex, or null if there is none.
+// Asked of GLFW, the GL 3.3 glad knows nothing of these.
+const char* viewportIndexExtension() {
+  if (!vglLoadViewportArray())
+    return nullptr;
+  if (glfwExtensionSupported("GL_ARB_shader_viewport_layer_array"))
+    return "GL_ARB_shader_viewport_layer_array";
+  if (glfwExtensionSupported("GL_AMD_vertex_shader_viewport_index"))
+    return "GL_AMD_vertex_shader_viewport_index";
+  return nullptr;
+}
+
+// `lines` go right after the #version line, where #extension has to be
+string withPreamble(const string& src, const string& lines) {
+  size_t line_end = src.find('\n');
+  if (line_end == string::npos)
+    return src + '\n' + lines;
+  return src.substr(0, line_end + 1) + lines + src.substr(line_end + 1);
+}
+
+}
+
+StartupGraph::Step addSceneResourceSteps(StartupGraph& startup, StartupGraph::Step context, ResourceManager& resources, SceneResources& res) {
+  auto files = make_shared<SceneFiles>();
+
+  auto read = startup.add("read shaders", StartupGraph::Any, [files] {
+    files->vertex_src = vglReadFile(scene_vertex_shader);
+    files->pony_src = vglReadFile(scene_pony_shader);
+    files->bg_src = vglReadFile(scene_bg_shader);
+    files->multi_view_src = vglReadFile(multi_view_shader);
+  });
+  auto decode = startup.add("decode texture", StartupGraph::Any, [files] {
+    files->pony_image = vglDecodeImage(scene_texture);
+  });
+
+  auto geometry = startup.add("cube geometry", StartupGraph::Context, [&resources, &res] {
+    // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
+    res.VAO = resources.createVertexArray("cube VAO");
+    res.VBO = resources.createBuffer(GL_ARRAY_BUFFER, vglCubeVerticesSize, vglCubeVertices, GL_STATIC_DRAW, "cube vertices");
+
+    // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // texture coordinate
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (float*)0+3);
+    glEnableVertexAttribArray(1);
+  }, {context});
+
+  auto shaders = startup.add("build shaders", StartupGraph::Context, [files, &resources, &res] {
+    res.ponyShader = resources.loadShader(scene_vertex_shader, scene_pony_shader, files->vertex_src, files->pony_src);
+    res.background = make_unique<FullscreenPass>(resources, scene_bg_shader, files->bg_src, background_scale);
+    GLuint ponyShader = resources.get(res.ponyShader);
+
+    // needs to be called before setting up uniforms by vglBindSampler
+    glUseProgram(ponyShader);
+    vglBindSampler(ponyShader, "pony", 0);
+
+    /* Variable 'time' is used for the fade effect. */
+    // Actually the uniform can be -1 if it's not used.
+    // This is not considered an error.
+    // See https://community.khronos.org/t/keep-unused-shader-variables-for-debugging/61280/5
+    res.pony_time_loc = glGetUniformLocation(ponyShader, "time");
+    res.pony_tm_loc = glGetUniformLocation(ponyShader, "tm");
+    res.pony_opacity_loc = glGetUniformLocation(ponyShader, "opacity");
+    res.bg_time_loc = glGetUniformLocation(res.background->program(), "time");
+    res.upscaler = make_unique<Upscaler>(resources);
+    res.scene_target = make_unique<RenderTarget>(resources, "scene", true);
+
+    string multi_view_src = files->multi_view_src;
+    if (const char* extension = viewportIndexExtension()) {
+      multi_view_src = withPreamble(multi_view_src, string{"#extension "} + extension + " : require\n#define MULTI_VIEWPORT\n");
+      res.viewport_arrays = true;
+    } else {
+      VGL_LOG(INFO, Render, "no viewport arrays, several views are drawn one at a time");
+    }
+    res.multiViewShader = resources.loadShader(multi_view_shader, scene_pony_shader, multi_view_src, files->pony_src);
+    GLuint multiViewShader = resources.get(res.multiViewShader);
+    glUseProgram(multiViewShader);
+    vglBindSampler(multiViewShader, "pony", 0);
+    vglBindSampler(multiViewShader, "instances", 1);
+    res.mv_view_projections_loc = glGetUniformLocation(multiViewShader, "view_projections");
+    res.mv_view_count_loc = glGetUniformLocation(multiViewShader, "view_count");
+    res.mv_view_loc = glGetUniformLocation(multiViewShader, "view");
+    res.mv_time_loc = glGetUniformLocation(multiViewShader, "time");
+  }, {context, read});
+
+  auto instances = startup.add("instance buffer", StartupGraph::Context, [&resources, &res] {
+    // Empty until the first recordViews, which replaces the storage every frame
+    res.instanceBuffer = resources.createBuffer(GL_TEXTURE_BUFFER, 0, nullptr, GL_STREAM_DRAW, "view instances");
+    glActiveTexture(GL_TEXTURE1);
+    res.instanceTexture = resources.createTexture(GL_TEXTURE_BUFFER, "view instances");
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, resources.get(res.instanceBuffer));
+    glActiveTexture(GL_TEXTURE0);
+  }, {context});
+
+  auto texture = startup.add("upload texture", StartupGraph::Context, [files, &resources, &res] {
+    res.pony_texture = resources.loadTexture(scene_texture, files->pony_image, GL_RGB);
+    // The pixels are in GL's hands now
+    files->pony_image = DecodedImage{};
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, resources.get(res.pony_texture));
+  }, {context, decode});
+
+  return startup.add("scene resources", StartupGraph::Context, [] {}, {geometry, shaders, texture, instances});
+}
+
+void destroySceneResources(ResourceManager& resources, SceneResources& res) {
+  resources.release(res.VAO);
+  resources.release(res.VBO);
+  resources.release(res.pony_texture);
+  resources.release(res.ponyShader);
+  res.background.reset();
+  res.upscaler.reset();
+  res.scene_target.reset();
+  res.post.reset();
+  res.targets.reset();
+  res.overdraw.reset();
+  resources.release(res.multiViewShader);
+  resources.release(res.instanceBuffer);
+  resources.release(res.instanceTexture);
+  res = SceneResources{};
+}
+
+void setSceneOutput(SceneResources& res, int width, int height, float scale) {
+  res.output_width = width;
+  res.output_height = height;
+  res.scene_width = max(1, min(width, (int)lround(width * scale)));
+  res.scene_height = max(1, min(height, (int)lround(height * scale)));
+  GLuint framebuffer = 0;
+  if (!res.post && res.scene_width == width && res.scene_height == height) {
+    res.scene_target->release();
+  } else {
+    res.scene_target->resize(res.scene_width, res.scene_height);
+    framebuffer = res.scene_target->framebuffer();
+  }
+  if (res.background)
+    res.background->setOutput(framebuffer, res.scene_width, res.scene_height);
+  if (res.overdraw)
+    res.overdraw->resize(res.scene_width, res.scene_height);
+}
+
+void enableOverdrawCounting(ResourceManager& resources, SceneResources& res) {
+  res.overdraw = make_unique<OverdrawCounter>(resources, scene_vertex_shader, vglReadFile(scene_vertex_shader));
+  res.overdraw_tm_loc = glGetUniformLocation(res.overdraw->program(), "tm");
+  if (res.scene_width > 0)
+    res.overdraw->resize(res.scene_width, res.scene_height);
+}
+
+void enablePostProcessing(ResourceManager& resources, SceneResources& res, bool fuse) {
+  res.post = make_unique<PostChain>(resources, vector<PostEffect>{vglSharpenEffect(), vglToneMapEffect(), vglColorGradeEffect(), vglVignetteEffect()}, fuse);
+  // The sharpening only makes up for what the scene's resolution and the background's upscale blur
+  res.post->set("sharpen_amount", 0.3f);
+  res.post->set("grade_saturation", 1.1f);
+  res.targets = make_unique<RenderTargetPool>(resources);
+  // Headroom above 1 for the tone mapping to compress
+  res.scene_target = make_unique<RenderTarget>(resources, "scene", true, GL_RGBA16F);
+}
+
+namespace {
+
+// Transforms are cheap, a job needs a few thousand to pay off
+constexpr size_t min_things_per_job = 4096;
+// The same in chunks of entities, which hold a hundred or so
+constexpr size_t min_chunks_per_job = 32;
+
+}
+
+void updateScene(JobSystem& jobs, const CameraState& cam, const vector<Thing>& things, const vector<float>& angles,
+                 DrawList& list, SceneGraph* graph) {
+  VGL_PROFILE_ZONE("updateScene");
+  // Cached by the camera until it moves
+  const glm::mat4& view_projection = cam.viewProjection();
+
+  list.transforms.resize(things.size());
+  jobs.parallelFor(0, things.size(), [&](size_t begin, size_t end) {
+    VGL_PROFILE_ZONE("updateTransforms");
+    // The batch kernels want arrays, so copy the things out a batch at a time, small enough to stay in L1
+    constexpr size_t batch = 256;
+    glm::vec3 positions[batch], axes[batch];
+    float scales[batch], radians[batch];
+    AffineTransform models[batch];
+    for (size_t first = begin; first < end; first += batch) {
+      size_t n = min(batch, end - first);
+      for (size_t k = 0; k < n; k++) {
+        auto& thing = things[first + k];
+        positions[k] = thing.pos;
+        axes[k] = thing.rotation_axis;
+        scales[k] = thing.scale;
+        radians[k] = glm::radians(angles[first + k]);
+      }
+      // translate(pos) * rotate(angle, axis) * scale(scale), then view_projection * model
+      vglAxisAngleTransforms(n, positions, axes, scales, radians, models);
+      if (graph)
+        graph->setLocals(first, n, models);
+      else
+        vglModelViewProjection(view_projection, n, models, &list.transforms[first]);
+    }
+  }, min_things_per_job);
+  if (!graph)
+    return;
+
+  graph->update(jobs);
+  jobs.parallelFor(0, things.size(), [&](size_t begin, size_t end) {
+    vglModelViewProjection(view_projection, end - begin, graph->worlds() + begin, &list.transforms[begin]);
+  }, min_things_per_job);
+}
+
+void updateScene(JobSystem& jobs, const CameraState& cam, EntityWorld& world, DrawList& list) {
+  VGL_PROFILE_ZONE("updateScene");
+  const glm::mat4& view_projection = cam.viewProjection();
+  list.transforms.resize(world.count(componentMask<AffineTransform>()));
+  world.parallelEach<const AffineTransform>(jobs, [&](size_t first, size_t count, const AffineTransform* models) {
+    vglModelViewProjection(view_projection, count, models, &list.transforms[first]);
+  }, min_chunks_per_job);
+}
+
+CullCache::CullCache(const vector<Thing>& things) {
+  // The cube goes from -1 to 1 on every axis, so its corners are sqrt(3) from the center
+  for (auto& thing : things)
+    spheres.emplace_back(thing.pos, thing.scale * sqrt(3.));
+}
+
+CullCache::CullCache(EntityWorld& world) {
+  world.each<const AffineTransform, const Position, const Scale>(
+    [&](size_t, size_t count, const AffineTransform*, const Position* positions, const Scale* scales) {
+      for (size_t i = 0; i < count; i++)
+        spheres.emplace_back(positions[i].value, scales[i].value * sqrt(3.f));
+    });
+}
+
+void CullCache::update(const vector<Thing>& things) {
+  for (size_t i = 0; i < things.size(); i++)
+    spheres[i] = glm::vec4(things[i].pos, spheres[i].w);
+  valid = false;
+}
+
+void CullCache::update(const SceneGraph& graph) {
+  if (graph.updated() == 0)
+    return;
+  const AffineTransform* worlds = graph.worlds();
+  for (size_t i = 0; i < graph.size(); i++) {
+    auto& m = worlds[i].m;
+    // The scale is the same along every axis, any column's length is it
+    float scale = sqrt(m[0][0] * m[0][0] + m[1][0] * m[1][0] + m[2][0] * m[2][0]);
+    spheres[i] = glm::vec4(m[0][3], m[1][3], m[2][3], scale * sqrt(3.f));
+  }
+  valid = false;
+}
+
+void cullScene(const CameraState& cam, CullCache& cache, DrawList& list) {
+  VGL_PROFILE_ZONE("cullScene");
+  if (!cache.valid || cache.camera_version != cam.version()) {
+    cache.visible.resize(cache.spheres.size());
+    cache.visible.resize(vglCullSpheres(cam.frustumPlanes(), cache.spheres.size(), cache.spheres.data(), cache.visible.data()));
+    cache.camera_version = cam.version();
+    cache.valid = true;
+  }
+  list.visible.assign(cache.visible.begin(), cache.visible.end());
+}
+
+namespace {
+
+// sortScene with the material of draw i from materialOf(i)
+template <class F>
+void sortDrawList(F&& materialOf, DrawList& list, bool by_depth) {
+  auto& visible = list.visible;
+  size_t n = visible.size();
+  FrameAllocator<uint32_t> allocator(list.arena.local());
+  FrameVector<uint32_t> keys(allocator), scratch_keys(allocator), scratch_values(n, allocator);
+
+  // Opaque to the front, transparent to the back, both in the order they came in
+  list.opaque = 0;
+  for (uint32_t i : visible)
+    list.opaque += materialOf(i) == Material::Opaque;
+  size_t opaque = 0, transparent = list.opaque;
+  for (uint32_t i : visible)
+    scratch_values[materialOf(i) == Material::Opaque ? opaque++ : transparent++] = i;
+  copy(scratch_values.begin(), scratch_values.end(), visible.begin());
+  if (!by_depth)
+    return;
+
+  keys.resize(n);
+  scratch_keys.resize(n);
+  for (size_t k = 0; k < n; k++) {
+    // w of the thing's center in clip space, which is its depth in front of the camera
+    uint32_t key = vglFloatKey(list.transforms[visible[k]][3][3]);
+    keys[k] = k < list.opaque ? key : ~key;
+  }
+  vglRadixSort(list.opaque, keys.data(), visible.data(), scratch_keys.data(), scratch_values.data());
+  vglRadixSort(n - list.opaque, keys.data() + list.opaque, visible.data() + list.opaque,
+               scratch_keys.data(), scratch_values.data());
+}
+
+}
+
+void sortScene(const vector<Thing>& things, DrawList& list, bool by_depth) {
+  VGL_PROFILE_ZONE("sortScene");
+  sortDrawList([&](uint32_t i) { return things[i].material; }, list, by_depth);
+}
+
+void sortScene(EntityWorld& world, DrawList& list, bool by_depth) {
+  VGL_PROFILE_ZONE("sortScene");
+  FrameAllocator<Material> allocator(list.arena.local());
+  FrameVector<Material> materials(list.transforms.size(), allocator);
+  world.each<const AffineTransform, const Material>([&](size_t first, size_t count, const AffineTransform*, const Material* m) {
+    copy(m, m + count, materials.begin() + first);
+  });
+  sortDrawList([&](uint32_t i) { return materials[i]; }, list, by_depth);
+}
+
+namespace {
+
+// Every slice gets its own command buffer and sub-arena, so keep them coarse
+constexpr size_t min_draws_per_slice = 16384;
+
+// Light enough to see the things behind
+constexpr float transparent_opacity = 0.4f;
+
+// From the opaque draws to the transparent ones: blend, and test against the
+// depth buffer without writing it, so that they do not hide each other
+void recordTransparent(const SceneResources& res, const DrawList& list, CommandBuffer& commands) {
+  if (list.samples.opaque) {
+    commands.endQuery(GL_SAMPLES_PASSED);
+    commands.beginQuery(GL_SAMPLES_PASSED, list.samples.transparent);
+  }
+  commands.enable(GL_BLEND);
+  commands.depthMask(GL_FALSE);
+  commands.uniform1f(res.pony_opacity_loc, transparent_opacity);
+}
+
+void recordDraws(const SceneResources& res, const DrawList& list, size_t begin, size_t end, CommandBuffer& commands) {
+  VGL_PROFILE_ZONE("recordDraws");
+  // Every draw records the same commands, so after the first one we know how much room the rest need
+  size_t before = commands.bytes();
+  for (size_t k = begin; k < end; k++) {
+    if (k == begin + 1)
+      commands.reserve((end - k) * (commands.bytes() - before));
+    // Whichever slice has the first transparent thing switches over
+    if (k == list.opaque)
+      recordTransparent(res, list, commands);
+    commands.uniformMatrix4fvRef(res.pony_tm_loc, &list.transforms[list.visible[k]]);
+    // Draw pone
+    commands.drawArrays(GL_TRIANGLE_STRIP, 0, 14); // 14 vertices represent 1 cube
+  }
+}
+
+// A view's rectangle in the scene's pixels rather than the window's
+View scaledView(const SceneResources& res, const View& view) {
+  if (res.scene_width == res.output_width && res.scene_height == res.output_height)
+    return view;
+  auto x = [&](GLint v) { return (GLint)((int64_t)v * res.scene_width / res.output_width); };
+  auto y = [&](GLint v) { return (GLint)((int64_t)v * res.scene_height / res.output_height); };
+  return View{view.camera, x(view.x), y(view.y), x(view.x + view.width) - x(view.x), y(view.y + view.height) - y(view.y)};
+}
+
+// Clears the scene, draws the background over it, then sets up the state the
+// cubes are drawn with. `query` counts the background's samples, if not 0.
+void recordBackground(const ResourceManager& resources, const SceneResources& res, CommandBuffer& commands, double dt,
+                      GLuint query = 0) {
+  commands.bindFramebuffer(GL_FRAMEBUFFER, res.scene_target ? res.scene_target->framebuffer() : 0);
+  commands.viewport(0, 0, res.scene_width, res.scene_height);
+  commands.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (query)
+    commands.beginQuery(GL_SAMPLES_PASSED, query);
+  if (res.background) {
+    res.background->begin(commands);
+    commands.uniform1f(res.bg_time_loc, dt);
+    res.background->end(commands);
+  }
+  if (query)
+    commands.endQuery(GL_SAMPLES_PASSED);
+  commands.enable(GL_DEPTH_TEST);
+  commands.bindVertexArray(resources.get(res.VAO));
+  commands.bindTexture(0, GL_TEXTURE_2D, resources.get(res.pony_texture));
+}
+
+}
+
+void recordScene(JobSystem& jobs, const ResourceManager& resources, const SceneResources& res, DrawList& list, double dt,
+                 const View* view, bool clear) {
+  VGL_PROFILE_ZONE("recordScene");
+
+  size_t draws = list.visible.size();
+  size_t slices = max<size_t>(1, min<size_t>(draws / min_draws_per_slice, jobs.threads()));
+
+  // The first buffer sets the frame up, the ones after it get a slice of the
+  // draws each, and the last puts the state back. Every slice records into its
+  // own sub-arena, whichever thread ends up running it.
+  list.commands.clear();
+  list.commands.reserve(slices + 2);
+  list.commands.emplace_back(FrameAllocator<unsigned char>(list.arena.local()));
+  for (size_t w = 0; w < slices; w++)
+    list.commands.emplace_back(FrameAllocator<unsigned char>(list.arena.local(w)));
+  list.commands.emplace_back(FrameAllocator<unsigned char>(list.arena.local()));
+
+  auto& setup = list.commands[0];
+  if (clear)
+    recordBackground(resources, res, setup, dt, list.samples.background);
+  if (view) {
+    View scaled = scaledView(res, *view);
+    setup.viewport(scaled.x, scaled.y, scaled.width, scaled.height);
+  }
+
+  // Render ponies, the opaque ones first
+  setup.useProgram(resources.get(res.ponyShader));
+  setup.uniform1f(res.pony_time_loc, (GLfloat)dt);
+  setup.disable(GL_BLEND);
+  setup.uniform1f(res.pony_opacity_loc, 1);
+  if (list.samples.opaque)
+    setup.beginQuery(GL_SAMPLES_PASSED, list.samples.opaque);
+
+  // The calling thread takes the first slice itself
+  JobCounter recorded;
+  size_t per_slice = (draws + slices - 1) / slices;
+  for (size_t w = 1; w < slices; w++) {
+    size_t begin = w * per_slice;
+    size_t end = min(draws, begin + per_slice);
+    CommandBuffer* commands = &list.commands[w + 1];
+    jobs.run(recorded, [&res, &list, begin, end, commands] { recordDraws(res, list, begin, end, *commands); });
+  }
+  recordDraws(res, list, 0, min(draws, per_slice), list.commands[1]);
+
+  auto& done = list.commands.back();
+  // No transparent draws, so no slice switched over
+  if (list.opaque == draws)
+    recordTransparent(res, list, done);
+  if (list.samples.transparent)
+    done.endQuery(GL_SAMPLES_PASSED);
+  done.depthMask(GL_TRUE);
+  done.enable(GL_BLEND);
+  jobs.wait(recorded);
+}
+
+void recordOverdraw(const ResourceManager& resources, const SceneResources& res, DrawList& list) {
+  if (!res.overdraw)
+    return;
+  VGL_PROFILE_ZONE("recordOverdraw");
+  list.commands.emplace_back(FrameAllocator<unsigned char>(list.arena.local()));
+  auto& commands = list.commands.back();
+  res.overdraw->begin(commands);
+  commands.bindVertexArray(resources.get(res.VAO));
+  // The same draws in the same order, with the same depth writes, as recordScene
+  for (size_t k = 0; k < list.visible.size(); k++) {
+    if (k == list.opaque)
+      commands.depthMask(GL_FALSE);
+    commands.uniformMatrix4fvRef(res.overdraw_tm_loc, &list.transforms[list.visible[k]]);
+    commands.drawArrays(GL_TRIANGLE_STRIP, 0, 14);
+  }
+  commands.depthMask(GL_TRUE);
+  res.overdraw->end(commands);
+}
+
+void recordPresent(SceneResources& res, CommandBuffer& commands) {
+  if (!res.scene_target || !*res.scene_target)
+    return;
+  // A copy: what blending left in the target's alpha must not let the window's old contents through
+  commands.disable(GL_BLEND);
+  if (res.post) {
+    // The first pass reads the scene with linear filtering, that is the upscale
+    res.post->record(commands, *res.targets, res.scene_target->texture(), res.scene_width, res.scene_height,
+                     0, res.output_width, res.output_height);
+    res.targets->endFrame();
+  } else {
+    res.upscaler->record(commands, res.scene_target->texture(), 0, res.output_width, res.output_height, res.upscale);
+  }
+  commands.enable(GL_BLEND);
+}
+
+void submitScene(const DrawList& list, FrameStats& stats) {
+  VGL_PROFILE_ZONE("submitScene");
+  VGL_PROFILE_GPU_ZONE("scene");
+  VGL_GL_GROUP("scene");
+
+  for (auto& commands : list.commands)
+    commands.replay(stats);
+}
+
+void cullViews(const vector<View>& views, const vector<glm::vec4>& spheres, MultiViewList& list) {
+  VGL_PROFILE_ZONE("cullViews");
+  if (views.size() > max_views)
+    throw invalid_argument{"Cannot draw " + to_string(views.size()) + " views, at most " + to_string(max_views)};
+  list.views.assign(views.begin(), views.end());
+  list.view_projections.clear();
+  glm::vec4 planes[max_views][6];
+  for (size_t v = 0; v < views.size(); v++) {
+    list.view_projections.push_back(views[v].camera->viewProjection());
+    copy_n(views[v].camera->frustumPlanes(), 6, planes[v]);
+  }
+  list.visible.resize(spheres.size());
+  list.masks.resize(spheres.size());
+  size_t visible = vglCullSpheresViews(planes, views.size(), spheres.size(), spheres.data(), list.visible.data(), list.masks.data());
+  list.visible.resize(visible);
+  list.masks.resize(visible);
+}
+
+void updateViews(JobSystem& jobs, const vector<Thing>& things, const vector<float>& angles, MultiViewList& list) {
+  VGL_PROFILE_ZONE("updateViews");
+  list.instances.resize(list.visible.size());
+  jobs.parallelFor(0, list.visible.size(), [&](size_t begin, size_t end) {
+    VGL_PROFILE_ZONE("updateInstances");
+    // As in updateScene, only gathered through the visible list, and no view-projection:
+    // every view applies its own in the shader
+    constexpr size_t batch = 256;
+    glm::vec3 positions[batch], axes[batch];
+    float scales[batch], radians[batch];
+    AffineTransform models[batch];
+    for (size_t first = begin; first < end; first += batch) {
+      size_t n = min(batch, end - first);
+      for (size_t k = 0; k < n; k++) {
+        uint32_t i = list.visible[first + k];
+        auto& thing = things[i];
+        positions[k] = thing.pos;
+        axes[k] = thing.rotation_axis;
+        scales[k] = thing.scale;
+        radians[k] = glm::radians(angles[i]);
+      }
+      vglAxisAngleTransforms(n, positions, axes, scales, radians, models);
+      for (size_t k = 0; k < n; k++)
+        list.instances[first + k] = ViewInstance{models[k], list.masks[first + k], {}};
+    }
+  }, min_things_per_job);
+}
+
+void recordViews(const ResourceManager& resources, const SceneResources& res, MultiViewList& list, double dt) {
+  VGL_PROFILE_ZONE("recordViews");
+  auto& commands = list.commands;
+  commands.reset();
+  recordBackground(resources, res, commands, dt);
+
+  GLsizei views = list.views.size();
+  GLsizei things = list.instances.size();
+  commands.bufferDataRef(GL_TEXTURE_BUFFER, resources.get(res.instanceBuffer), things * sizeof(ViewInstance),
+                         list.instances.data(), GL_STREAM_DRAW);
+  commands.useProgram(resources.get(res.multiViewShader));
+  commands.bindTexture(1, GL_TEXTURE_BUFFER, resources.get(res.instanceTexture));
+  commands.uniform1f(res.mv_time_loc, (GLfloat)dt);
+  commands.uniformMatrix4fv(res.mv_view_projections_loc, views, list.view_projections.data());
+
+  if (res.viewport_arrays) {
+    // Every thing once per view, the shader sends each copy to its view's viewport
+    for (GLsizei v = 0; v < views; v++) {
+      View scaled = scaledView(res, list.views[v]);
+      commands.viewportIndexed(v, scaled.x, scaled.y, scaled.width, scaled.height);
+    }
+    commands.uniform1i(res.mv_view_count_loc, views);
+    commands.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, things * views);
+  } else {
+    for (GLsizei v = 0; v < views; v++) {
+      View scaled = scaledView(res, list.views[v]);
+      commands.viewport(scaled.x, scaled.y, scaled.width, scaled.height);
+      commands.uniform1i(res.mv_view_loc, v);
+      commands.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, things);
+    }
+  }
+}
+
+void submitViews(const MultiViewList& list, FrameStats& stats) {
+  VGL_PROFILE_ZONE("submitViews");
+  VGL_PROFILE_GPU_ZONE("views");
+  VGL_GL_GROUP("views");
+
+  list.commands.replay(stats);
+}
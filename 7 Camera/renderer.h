@@ -0,0 +1,240 @@
+// Drawing the cube scene.
+// Shared by the interactive program and the benchmark so that both exercise the same code.
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "batch_math.h"
+#include "camera.h"
+#include "command_buffer.h"
+#include "ecs.h"
+#include "frame_arena.h"
+#include "frame_stats.h"
+#include "fullscreen_pass.h"
+#include "jobs.h"
+#include "overdraw.h"
+#include "post_process.h"
+#include "render_target.h"
+#include "resources.h"
+#include "scene_graph.h"
+#include "startup.h"
+#include "things.h"
+
+// GL objects the cube scene needs, owned by a ResourceManager. Created during startup, see below.
+struct SceneResources {
+  ShaderHandle ponyShader;
+  // psychedelic_frag.glsl behind everything, at background_scale of the output resolution.
+  // Give it the window size with setOutput before recording. Null to leave it out.
+  std::unique_ptr<FullscreenPass> background;
+  VertexArrayHandle VAO;
+  BufferHandle VBO;
+  TextureHandle pony_texture;
+
+  GLint pony_tm_loc = -1, pony_time_loc = -1, pony_opacity_loc = -1;
+  GLint bg_time_loc = -1;
+
+  // Drawing several views at once, see recordViews
+  ShaderHandle multiViewShader;
+  BufferHandle instanceBuffer;
+  TextureHandle instanceTexture;
+  GLint mv_view_projections_loc = -1, mv_view_count_loc = -1, mv_view_loc = -1, mv_time_loc = -1;
+  // The vertex shader can pick the viewport, so all views go in one draw
+  bool viewport_arrays = false;
+
+  // Below the window's resolution the scene is drawn into scene_target and
+  // scaled up into the window with `upscale`, see setSceneOutput
+  std::unique_ptr<RenderTarget> scene_target;
+  std::unique_ptr<Upscaler> upscaler;
+  Upscale upscale = Upscale::Bilinear;
+  // The window's size, and what the scene is drawn at
+  int output_width = 0, output_height = 0;
+  int scene_width = 0, scene_height = 0;
+
+  // Post-processing on the way to the window, see enablePostProcessing. Null for none.
+  std::unique_ptr<PostChain> post;
+  std::unique_ptr<RenderTargetPool> targets;
+
+  // Counts the fragments of the scene's draws, see enableOverdrawCounting. Null for none.
+  std::unique_ptr<OverdrawCounter> overdraw;
+  GLint overdraw_tm_loc = -1;
+};
+
+// The background is smooth, a quarter of the pixels is plenty
+constexpr float background_scale = 0.5f;
+
+// Adds the steps that create `res` to `startup`: the shaders are read and the
+// texture decoded on any thread, the GL objects made once `context` (the step
+// that makes the GL context current) is done. Returns the step after which
+// `res` is ready.
+StartupGraph::Step addSceneResourceSteps(StartupGraph& startup, StartupGraph::Step context, ResourceManager& resources, SceneResources& res);
+// Releases the scene's references, the GL objects go once the GPU is done with them
+void destroySceneResources(ResourceManager& resources, SceneResources& res);
+// Draw the scene at `scale` times the width and height of the window, which
+// is `width` by `height` pixels: straight into the window at 1 without
+// post-processing, into scene_target otherwise. The background follows. Call it before recording a
+// frame, it is cheap when nothing changed. Context thread.
+void setSceneOutput(SceneResources& res, int width, int height, float scale = 1);
+// Sharpen, tone map, grade and vignette the scene on its way to the window:
+// in one pass if `fuse`, one pass per effect if not. The scene is then drawn
+// into a half float target. Context thread.
+void enablePostProcessing(ResourceManager& resources, SceneResources& res, bool fuse = true);
+// Instrumentation: have recordOverdraw count the fragments every pixel of the
+// scene gets. Context thread.
+void enableOverdrawCounting(ResourceManager& resources, SceneResources& res);
+
+// A camera and the rectangle of the window it draws into
+struct View {
+  const CameraState* camera;
+  GLint x, y;
+  GLsizei width, height;
+};
+
+// GL_SAMPLES_PASSED queries recordScene puts around its passes, 0 for none.
+// Either none or all of them: GpuQueryRing needs every query it hands out ended.
+struct PassQueries {
+  GLuint background = 0, opaque = 0, transparent = 0;
+};
+
+// Transient per-frame data, allocated from the frame arena.
+// Build a new one every frame, after FrameArena::beginFrame, and let it go before the next.
+struct DrawList {
+  explicit DrawList(FrameArena& arena)
+    : arena(arena),
+      transforms(FrameAllocator<glm::mat4>(arena.local())),
+      visible(FrameAllocator<uint32_t>(arena.local())),
+      commands(FrameAllocator<CommandBuffer>(arena.local())) {}
+
+  // Where recordScene gets the workers' sub-arenas from
+  FrameArena& arena;
+  // Model-view-projection matrix of every thing
+  FrameVector<glm::mat4> transforms;
+  // Indices into transforms that survived culling, in submission order:
+  // after sortScene the first `opaque` are the opaque things
+  FrameVector<uint32_t> visible;
+  size_t opaque = 0;
+  // Fewer opaque samples pass when the nearer things are drawn first
+  PassQueries samples;
+  // Recorded GL commands, replayed in order. Refer to `transforms`.
+  FrameVector<CommandBuffer> commands;
+};
+
+// Compute the final transforms of the things, `angles` (degrees) comes from animateThings().
+// Spread over the job system for large scenes. Things with parents need a
+// `graph` made from them, which gets their transforms as locals and is updated.
+void updateScene(JobSystem& jobs, const CameraState& cam, const std::vector<Thing>& things, const std::vector<float>& angles,
+                 DrawList& list, SceneGraph* graph = nullptr);
+// The same for the things as entities: those with an AffineTransform, which
+// transformThings has to have brought up to date. They need a Position,
+// Scale and Material too. The draw list numbers them in the order of a query
+// (see ecs.h), which the other functions taking a world go by as well.
+void updateScene(JobSystem& jobs, const CameraState& cam, EntityWorld& world, DrawList& list);
+// What cullScene keeps between frames: the bounding spheres of the things,
+// and what was visible at the camera version it last culled for.
+// The spheres are made from the things' positions; when the things move,
+// update() has to follow them every frame.
+struct CullCache {
+  explicit CullCache(const std::vector<Thing>& things);
+  // The entities updateScene draws
+  explicit CullCache(EntityWorld& world);
+
+  // Move the spheres to where the things are now, culling again next time
+  void update(const std::vector<Thing>& things);
+  // The same from the graph's world transforms, for things with parents.
+  // Nothing if the last update of the graph moved nothing.
+  void update(const SceneGraph& graph);
+
+  std::vector<glm::vec4> spheres;
+  std::vector<uint32_t> visible;
+  // See CameraState::version. Only means something for the same camera every frame.
+  uint64_t camera_version = 0;
+  bool valid = false;
+};
+
+// Pick what actually gets drawn: the things whose bounding sphere is in the
+// camera's frustum. Reuses the last result while the camera has not changed.
+void cullScene(const CameraState& cam, CullCache& cache, DrawList& list);
+// Order what cullScene kept for drawing: the opaque things first, without
+// blending and nearest first, so that the depth test throws away what they
+// hide before it is shaded; then the transparent ones farthest first, so
+// that each blends over what is behind it. The depths are those of the
+// things' centers, radix sorted. With `by_depth` false both groups keep the
+// order the things were made in. Needs updateScene's transforms.
+void sortScene(const std::vector<Thing>& things, DrawList& list, bool by_depth = true);
+void sortScene(EntityWorld& world, DrawList& list, bool by_depth = true);
+// Record the GL commands for the frame into list.commands.
+// Large scenes are split into jobs; no GL calls are made.
+// With a `view` the draws go into its rectangle, scaled down with the scene,
+// and the scene is only cleared if `clear` says so; without one they cover it all.
+void recordScene(JobSystem& jobs, const ResourceManager& resources, const SceneResources& res, DrawList& list, double dt,
+                 const View* view = nullptr, bool clear = true);
+// With enableOverdrawCounting, draw what recordScene did a second time, into
+// the overdraw counter, in a command buffer of its own at the end of list.commands.
+// Nothing otherwise.
+void recordOverdraw(const ResourceManager& resources, const SceneResources& res, DrawList& list);
+// Post-process the scene into the window, or scale it up if it was drawn
+// smaller; nothing if neither. Goes after all of the frame's scene commands.
+// Context thread, post-processing takes its targets from a pool.
+void recordPresent(SceneResources& res, CommandBuffer& commands);
+// Issue the recorded commands, counting them into `stats`. Context thread only.
+void submitScene(const DrawList& list, FrameStats& stats);
+
+// Several cameras on the same scene, a split screen say.
+//
+// Drawn as N separate passes every view transforms, culls and draws the whole
+// scene on its own. The shared path below culls once against all the frusta,
+// transforms each thing once whatever number of views it is in, uploads the
+// model matrices once and draws every view from them: in one instanced draw
+// where the vertex shader can choose the viewport, one per view elsewhere.
+
+// GL guarantees at least this many viewports
+constexpr unsigned max_views = 16;
+
+// One thing as the multi-view shader reads it, four texels of a buffer texture
+struct ViewInstance {
+  AffineTransform model;
+  // Bit v set if the thing is in view v
+  uint32_t mask;
+  uint32_t unused[3];
+};
+static_assert(sizeof(ViewInstance) == 64, "ViewInstance is four RGBA32F texels");
+
+// The multi-view counterpart of DrawList, the same rules apply
+struct MultiViewList {
+  explicit MultiViewList(FrameArena& arena)
+    : views(FrameAllocator<View>(arena.local())),
+      view_projections(FrameAllocator<glm::mat4>(arena.local())),
+      visible(FrameAllocator<uint32_t>(arena.local())),
+      masks(FrameAllocator<uint32_t>(arena.local())),
+      instances(FrameAllocator<ViewInstance>(arena.local())),
+      commands(FrameAllocator<unsigned char>(arena.local())) {}
+
+  FrameVector<View> views;
+  FrameVector<glm::mat4> view_projections;
+  // The things in at least one view, and which views they are in
+  FrameVector<uint32_t> visible;
+  FrameVector<uint32_t> masks;
+  // One per visible thing, what gets uploaded
+  FrameVector<ViewInstance> instances;
+  // Refers to `instances`
+  CommandBuffer commands;
+};
+
+// Cull the bounding spheres (CullCache::spheres) against every view in one pass.
+// Throws invalid_argument for more than max_views views.
+void cullViews(const std::vector<View>& views, const std::vector<glm::vec4>& spheres, MultiViewList& list);
+// The model matrices of the visible things, spread over the job system like updateScene
+void updateViews(JobSystem& jobs, const std::vector<Thing>& things, const std::vector<float>& angles, MultiViewList& list);
+// Clear the scene and record the upload and the draws for all views
+void recordViews(const ResourceManager& resources, const SceneResources& res, MultiViewList& list, double dt);
+// Context thread only
+void submitViews(const MultiViewList& list, FrameStats& stats);
+
+#endif
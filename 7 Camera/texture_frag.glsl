@@ -6,8 +6,11 @@ out vec4 FragColor;
 
 uniform sampler2D pony;
 uniform float time;
+// Below 1 for transparent things
+uniform float opacity = 1.0;
   
 void main()
 {
-    FragColor = texture(pony, tex_coords);
+    vec4 color = texture(pony, tex_coords);
+    FragColor = vec4(color.rgb, color.a * opacity);
 }
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "batch_math.h"
+#include "batch_math_simd.h"
+
+using namespace std;
+
+glm::mat4 toMat4(const AffineTransform& a) {
+  glm::mat4 m(1.f);
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 4; col++)
+      m[col][row] = a.m[row][col];
+  }
+  return m;
+}
+
+AffineTransform toAffine(const glm::mat4& m) {
+  AffineTransform a;
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 4; col++)
+      a.m[row][col] = m[col][row];
+  }
+  return a;
+}
+
+namespace {
+
+// The reference the SIMD versions are checked against, and what runs where there are none
+
+void axisAngleScalar(size_t count, const glm::vec3* positions, const glm::vec3* axes,
+                     const float* scales, const float* angles, AffineTransform* out) {
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 a = glm::normalize(axes[i]);
+    float c = cos(angles[i]), s = sin(angles[i]);
+    glm::vec3 t = (1.f - c) * a;
+    float scale = scales[i];
+    auto& m = out[i].m;
+    m[0][0] = (c + t.x * a.x) * scale;
+    m[0][1] = (t.y * a.x - s * a.z) * scale;
+    m[0][2] = (t.z * a.x + s * a.y) * scale;
+    m[0][3] = positions[i].x;
+    m[1][0] = (t.x * a.y + s * a.z) * scale;
+    m[1][1] = (c + t.y * a.y) * scale;
+    m[1][2] = (t.z * a.y - s * a.x) * scale;
+    m[1][3] = positions[i].y;
+    m[2][0] = (t.x * a.z - s * a.y) * scale;
+    m[2][1] = (t.y * a.z + s * a.x) * scale;
+    m[2][2] = (c + t.z * a.z) * scale;
+    m[2][3] = positions[i].z;
+  }
+}
+
+void multiplyAffineScalar(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out) {
+  for (size_t i = 0; i < count; i++) {
+    AffineTransform product;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 4; c++)
+        product.m[r][c] = a.m[r][0] * b[i].m[0][c] + a.m[r][1] * b[i].m[1][c] + a.m[r][2] * b[i].m[2][c];
+      product.m[r][3] += a.m[r][3];
+    }
+    out[i] = product;
+  }
+}
+
+void modelViewProjectionScalar(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out) {
+  for (size_t i = 0; i < count; i++) {
+    auto& m = models[i].m;
+    glm::mat4 product;
+    for (int c = 0; c < 4; c++)
+      product[c] = view_projection[0] * m[0][c] + view_projection[1] * m[1][c] + view_projection[2] * m[2][c];
+    product[3] += view_projection[3];
+    out[i] = product;
+  }
+}
+
+size_t cullSpheresScalar(const glm::vec4 planes[6], size_t count, const glm::vec4* spheres, uint32_t* visible) {
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 center(spheres[i]);
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++)
+      inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -spheres[i].w;
+    if (inside)
+      visible[n++] = i;
+  }
+  return n;
+}
+
+size_t cullSpheresViewsScalar(const glm::vec4 (*planes)[6], unsigned views, size_t count, const glm::vec4* spheres,
+                              uint32_t* visible, uint32_t* masks) {
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 center(spheres[i]);
+    uint32_t mask = 0;
+    for (unsigned v = 0; v < views; v++) {
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; p++)
+        inside = glm::dot(glm::vec3(planes[v][p]), center) + planes[v][p].w >= -spheres[i].w;
+      mask |= (uint32_t)inside << v;
+    }
+    if (mask) {
+      visible[n] = i;
+      masks[n++] = mask;
+    }
+  }
+  return n;
+}
+
+void collideBoxesScalar(const OrientedBox* boxes, size_t count, const uint32_t* first, const uint32_t* second, BoxContact* out) {
+  for (size_t n = 0; n < count; n++) {
+    const OrientedBox& box_a = boxes[first[n]];
+    const OrientedBox& box_b = boxes[second[n]];
+    glm::vec3 d = glm::vec3(box_b.center[0], box_b.center[1], box_b.center[2]) -
+                  glm::vec3(box_a.center[0], box_a.center[1], box_a.center[2]);
+    float ha = box_a.half_size, hb = box_b.half_size;
+    glm::vec3 a[3], b[3];
+    for (int i = 0; i < 3; i++) {
+      a[i] = glm::vec3(box_a.axes[i][0], box_a.axes[i][1], box_a.axes[i][2]);
+      b[i] = glm::vec3(box_b.axes[i][0], box_b.axes[i][1], box_b.axes[i][2]);
+    }
+    float r[3][3], abs_r[3][3], ta[3], tb[3];
+    for (int i = 0; i < 3; i++) {
+      ta[i] = glm::dot(d, a[i]);
+      tb[i] = glm::dot(d, b[i]);
+      for (int j = 0; j < 3; j++) {
+        r[i][j] = glm::dot(a[i], b[j]);
+        abs_r[i][j] = fabs(r[i][j]);
+      }
+    }
+
+    float best = 3.4e38f;
+    glm::vec3 normal(0);
+    auto consider = [&](float depth, float margin, glm::vec3 axis) {
+      if (depth * margin < best) {
+        best = depth;
+        normal = axis;
+      }
+    };
+    for (int i = 0; i < 3; i++)
+      consider(ha + hb * (abs_r[i][0] + abs_r[i][1] + abs_r[i][2]) - fabs(ta[i]), 1, ta[i] < 0 ? -a[i] : a[i]);
+    for (int j = 0; j < 3; j++)
+      consider(ha * (abs_r[0][j] + abs_r[1][j] + abs_r[2][j]) + hb - fabs(tb[j]), 1, tb[j] < 0 ? -b[j] : b[j]);
+    for (int i = 0; i < 3; i++) {
+      int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      for (int j = 0; j < 3; j++) {
+        int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        glm::vec3 axis = glm::cross(a[i], b[j]);
+        float length = glm::length(axis);
+        if (length < 1e-2f)
+          continue;
+        float along = glm::dot(d, axis);
+        float depth = (ha * (abs_r[i1][j] + abs_r[i2][j]) + hb * (abs_r[i][j1] + abs_r[i][j2]) - fabs(along)) / length;
+        consider(depth, 1.05f, (along < 0 ? -axis : axis) / length);
+      }
+    }
+    out[n] = BoxContact{{normal.x, normal.y, normal.z}, best};
+  }
+}
+
+bool supported(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+  switch (level) {
+  case SimdLevel::Scalar:
+    return true;
+  case SimdLevel::SSE4:
+    return __builtin_cpu_supports("sse4.1");
+  case SimdLevel::AVX2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  case SimdLevel::AVX512:
+    return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return level == SimdLevel::Scalar;
+#endif
+}
+
+const BatchKernels* kernelsFor(SimdLevel level) {
+  switch (level) {
+#if defined(__x86_64__) || defined(__i386__)
+  case SimdLevel::AVX512:
+    return &batch_kernels_avx512;
+  case SimdLevel::AVX2:
+    return &batch_kernels_avx2;
+  case SimdLevel::SSE4:
+    return &batch_kernels_sse4;
+#endif
+  default:
+    return &batch_kernels_scalar;
+  }
+}
+
+// Picked on first use, see kernels()
+atomic<SimdLevel> current_level{SimdLevel::Scalar};
+atomic<const BatchKernels*> current_kernels{nullptr};
+
+const BatchKernels& kernels() {
+  const BatchKernels* k = current_kernels.load(memory_order_acquire);
+  if (!k) {
+    // Racing threads all come to the same answer
+    vglSetSimdLevel(SimdLevel::AVX512);
+    k = current_kernels.load(memory_order_acquire);
+  }
+  return *k;
+}
+
+}
+
+const BatchKernels batch_kernels_scalar = {
+  axisAngleScalar,
+  multiplyAffineScalar,
+  modelViewProjectionScalar,
+  cullSpheresScalar,
+  cullSpheresViewsScalar,
+  collideBoxesScalar,
+};
+
+SimdLevel vglSimdSupported() {
+  for (SimdLevel level : {SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE4}) {
+    if (supported(level))
+      return level;
+  }
+  return SimdLevel::Scalar;
+}
+
+SimdLevel vglSimdLevel() {
+  kernels();
+  return current_level.load(memory_order_relaxed);
+}
+
+void vglSetSimdLevel(SimdLevel level) {
+  SimdLevel supported_level = vglSimdSupported();
+  if (level > supported_level)
+    level = supported_level;
+  current_level.store(level, memory_order_relaxed);
+  current_kernels.store(kernelsFor(level), memory_order_release);
+}
+
+const char* vglSimdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::Scalar:
+    return "scalar";
+  case SimdLevel::SSE4:
+    return "sse4";
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+bool vglParseSimdLevel(const char* name, SimdLevel& level) {
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+    if (strcmp(name, vglSimdLevelName(l)) == 0) {
+      level = l;
+      return true;
+    }
+  }
+  return false;
+}
+
+void vglAxisAngleTransforms(size_t count, const glm::vec3* positions, const glm::vec3* axes,
+                            const float* scales, const float* angles, AffineTransform* out) {
+  kernels().axisAngle(count, positions, axes, scales, angles, out);
+}
+
+void vglMultiplyAffine(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out) {
+  kernels().multiplyAffine(a, count, b, out);
+}
+
+void vglModelViewProjection(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out) {
+  kernels().modelViewProjection(view_projection, count, models, out);
+}
+
+void vglFrustumPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]) {
+  // Gribb and Hartmann: in clip space the frustum is -w <= x, y, z <= w, so
+  // each plane is the last row of the matrix plus or minus one of the others
+  glm::mat4 rows = glm::transpose(view_projection);
+  planes[0] = rows[3] + rows[0];
+  planes[1] = rows[3] - rows[0];
+  planes[2] = rows[3] + rows[1];
+  planes[3] = rows[3] - rows[1];
+  planes[4] = rows[3] + rows[2];
+  planes[5] = rows[3] - rows[2];
+  for (int p = 0; p < 6; p++)
+    planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+size_t vglCullSpheres(const glm::vec4 planes[6], size_t count, const glm::vec4* spheres, uint32_t* visible) {
+  return kernels().cullSpheres(planes, count, spheres, visible);
+}
+
+size_t vglCullSpheresViews(const glm::vec4 (*planes)[6], unsigned views, size_t count, const glm::vec4* spheres,
+                           uint32_t* visible, uint32_t* masks) {
+  if (views > vgl_max_views)
+    throw invalid_argument{"Cannot cull for " + to_string(views) + " views, at most " + to_string(vgl_max_views)};
+  return kernels().cullSpheresViews(planes, views, count, spheres, visible, masks);
+}
+
+void vglCollideBoxes(const OrientedBox* boxes, size_t count, const uint32_t* first, const uint32_t* second, BoxContact* out) {
+  kernels().collideBoxes(boxes, count, first, second, out);
+}
@@ -0,0 +1,97 @@
+// Batched transform kernels for the render loop.
+//
+// Every kernel works on whole arrays and exists as plain C++ and in SSE4.1,
+// AVX2 and AVX-512 versions. The widest one the CPU supports is picked on
+// first use. Each computes the same as the glm expression noted with it, to
+// within float rounding; math_bench.cpp checks that and times them against glm.
+//
+// Objects are spread over the SIMD lanes where a kernel has per-object math
+// to do (axis-angle, culling, box collisions), while the matrix products keep one matrix per
+// register and save the work an affine matrix does not need.
+
+#ifndef BATCH_MATH_H
+#define BATCH_MATH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// The top three rows of a 4x4 matrix whose last row is 0 0 0 1, row-major.
+// A model matrix in 48 bytes instead of 64.
+struct AffineTransform {
+  float m[3][4];
+};
+
+glm::mat4 toMat4(const AffineTransform& a);
+AffineTransform toAffine(const glm::mat4& m);
+
+enum class SimdLevel { Scalar, SSE4, AVX2, AVX512 };
+
+// The widest level this CPU (and build) supports
+SimdLevel vglSimdSupported();
+// What the kernels run with
+SimdLevel vglSimdLevel();
+// Run the kernels with `level`, or the widest supported one below it.
+// For benchmarks; do not call while kernels are running on other threads.
+void vglSetSimdLevel(SimdLevel level);
+const char* vglSimdLevelName(SimdLevel level);
+// Parses the names above, false if `name` is none of them
+bool vglParseSimdLevel(const char* name, SimdLevel& level);
+
+// out[i] = translate(positions[i]) * rotate(angles[i], axes[i]) * scale(vec3(scales[i])).
+// Angles in radians; the axes need not be normalized, as with glm::rotate.
+void vglAxisAngleTransforms(size_t count, const glm::vec3* positions, const glm::vec3* axes,
+                            const float* scales, const float* angles, AffineTransform* out);
+
+// out[i] = a * b[i]
+void vglMultiplyAffine(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out);
+
+// out[i] = view_projection * models[i]
+void vglModelViewProjection(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out);
+
+// The six planes of the frustum of `view_projection` (left, right, bottom,
+// top, near, far) as (normal, d), normals unit length and pointing inwards
+void vglFrustumPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]);
+
+// Writes to `visible` the index of every sphere (center, radius) that is not
+// entirely behind one of the planes, in order, and returns how many there are.
+// `visible` needs room for `count` indices.
+size_t vglCullSpheres(const glm::vec4 planes[6], size_t count, const glm::vec4* spheres, uint32_t* visible);
+
+// Most views vglCullSpheresViews takes, one bit of a mask each
+constexpr unsigned vgl_max_views = 32;
+
+// vglCullSpheres against several views at once, planes[v] being view v's.
+// Writes the index of every sphere in at least one view to `visible` and
+// which views it is in, bit v for view v, to the same place in `masks`.
+// Both need room for `count` entries; throws invalid_argument for more than
+// vgl_max_views views.
+size_t vglCullSpheresViews(const glm::vec4 (*planes)[6], unsigned views, size_t count, const glm::vec4* spheres,
+                           uint32_t* visible, uint32_t* masks);
+
+// A cube as vglCollideBoxes sees it: the center, half the edge length, and
+// the cube's x, y and z axes in world space (the columns of its rotation),
+// unit length. 64 bytes.
+struct OrientedBox {
+  float center[3];
+  float half_size;
+  float axes[3][3];
+  float unused[3];
+};
+
+struct BoxContact {
+  // Unit length, from the first box towards the second
+  float normal[3];
+  // How far the boxes overlap along `normal`, zero or less if they do not
+  float depth;
+};
+
+// Separating axis test of boxes[first[i]] against boxes[second[i]] for every
+// i: of the 15 axes (three faces each, nine edge pairs) out[i] gets the one
+// they overlap least along, which is the way to push them apart. Edge axes
+// have to beat the faces by 5%, so that resting faces do not flip between
+// near-equal axes from one step to the next.
+void vglCollideBoxes(const OrientedBox* boxes, size_t count, const uint32_t* first, const uint32_t* second, BoxContact* out);
+
+#endif
@@ -0,0 +1,136 @@
+// AVX2 + FMA kernels, compiled with -mavx2 -mfma (see the Makefile)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define BATCH_MATH_KERNELS
+#include <immintrin.h>
+
+#include "batch_math_simd.h"
+
+namespace {
+
+struct Avx2 {
+  static constexpr size_t width = 8;
+  using V = __m256;
+  using I = __m256i;
+  using Mask = __m256;
+
+  static V set1(float x) { return _mm256_set1_ps(x); }
+  static V load(const float* p) { return _mm256_loadu_ps(p); }
+  template <int stride>
+  static V gather(const float* p) {
+    return _mm256_i32gather_ps(p, _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride), 4);
+  }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+  static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+  static V fnmadd(V a, V b, V c) { return _mm256_fnmadd_ps(a, b, c); }
+  static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+
+  static I truncate(V a) { return _mm256_cvttps_epi32(a); }
+  static V toFloat(I q) { return _mm256_cvtepi32_ps(q); }
+  static I iadd(I q, int k) { return _mm256_add_epi32(q, _mm256_set1_epi32(k)); }
+  static I iand(I q, int k) { return _mm256_and_si256(q, _mm256_set1_epi32(k)); }
+  static Mask bitSet(I q, int bit) {
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(iand(q, bit), _mm256_set1_epi32(bit)));
+  }
+
+  static V select(Mask m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+  static V negateIf(V a, Mask m) { return _mm256_xor_ps(a, _mm256_and_ps(m, _mm256_set1_ps(-0.f))); }
+  static Mask less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static Mask greaterEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+  static Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+  static uint32_t bits(Mask m) { return _mm256_movemask_ps(m); }
+
+  // Lane k of a, b, c and d to p + k * stride
+  static void storeRows(float* p, size_t stride, V a, V b, V c, V d) {
+    // A 4x4 transpose within each 128-bit half: the low half holds lanes 0-3, the high one 4-7
+    V ab_lo = _mm256_unpacklo_ps(a, b), ab_hi = _mm256_unpackhi_ps(a, b);
+    V cd_lo = _mm256_unpacklo_ps(c, d), cd_hi = _mm256_unpackhi_ps(c, d);
+    V row[4] = {
+      _mm256_shuffle_ps(ab_lo, cd_lo, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm256_shuffle_ps(ab_lo, cd_lo, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm256_shuffle_ps(ab_hi, cd_hi, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm256_shuffle_ps(ab_hi, cd_hi, _MM_SHUFFLE(3, 2, 3, 2)),
+    };
+    for (int k = 0; k < 4; k++) {
+      _mm_storeu_ps(p + k * stride, _mm256_castps256_ps128(row[k]));
+      _mm_storeu_ps(p + (k + 4) * stride, _mm256_extractf128_ps(row[k], 1));
+    }
+  }
+};
+
+// vbroadcastf128 without the aligned __m128 load _mm256_broadcast_ps takes
+__m256 broadcast4(const float* p) {
+  __m128 x = _mm_loadu_ps(p);
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(x), x, 1);
+}
+
+void multiplyAffine(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out) {
+  // Rows 0 and 1 of the product in one register, row 2 in a half one.
+  // Row r is a[r][0] * b.row0 + a[r][1] * b.row1 + a[r][2] * b.row2 + (0, 0, 0, a[r][3]).
+  __m256 a01[3];
+  __m128 a2[3];
+  for (int k = 0; k < 3; k++) {
+    a01[k] = _mm256_setr_m128(_mm_set1_ps(a.m[0][k]), _mm_set1_ps(a.m[1][k]));
+    a2[k] = _mm_set1_ps(a.m[2][k]);
+  }
+  __m256 t01 = _mm256_setr_ps(0, 0, 0, a.m[0][3], 0, 0, 0, a.m[1][3]);
+  __m128 t2 = _mm_setr_ps(0, 0, 0, a.m[2][3]);
+  for (size_t i = 0; i < count; i++) {
+    __m256 b0 = broadcast4(b[i].m[0]);
+    __m256 b1 = broadcast4(b[i].m[1]);
+    __m256 b2 = broadcast4(b[i].m[2]);
+    __m256 rows = _mm256_fmadd_ps(a01[0], b0, t01);
+    rows = _mm256_fmadd_ps(a01[1], b1, rows);
+    rows = _mm256_fmadd_ps(a01[2], b2, rows);
+    __m128 row2 = _mm_fmadd_ps(a2[0], _mm256_castps256_ps128(b0), t2);
+    row2 = _mm_fmadd_ps(a2[1], _mm256_castps256_ps128(b1), row2);
+    row2 = _mm_fmadd_ps(a2[2], _mm256_castps256_ps128(b2), row2);
+    _mm256_storeu_ps(out[i].m[0], rows);
+    _mm_storeu_ps(out[i].m[2], row2);
+  }
+}
+
+void modelViewProjection(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out) {
+  // Two columns of the product per register. The model's last row is 0 0 0 1:
+  // three products per column instead of four, plus vp.col3 for the last column.
+  const float* vp = reinterpret_cast<const float*>(&view_projection);
+  __m256 c0 = broadcast4(vp);
+  __m256 c1 = broadcast4(vp + 4);
+  __m256 c2 = broadcast4(vp + 8);
+  __m256 c3 = _mm256_setr_m128(_mm_setzero_ps(), _mm_loadu_ps(vp + 12));
+  // Element j of a model row across the four lanes of column j
+  __m256i columns01 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+  __m256i columns23 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+  for (size_t i = 0; i < count; i++) {
+    __m256 r0 = broadcast4(models[i].m[0]);
+    __m256 r1 = broadcast4(models[i].m[1]);
+    __m256 r2 = broadcast4(models[i].m[2]);
+    __m256 lo = _mm256_mul_ps(c0, _mm256_permutevar8x32_ps(r0, columns01));
+    lo = _mm256_fmadd_ps(c1, _mm256_permutevar8x32_ps(r1, columns01), lo);
+    lo = _mm256_fmadd_ps(c2, _mm256_permutevar8x32_ps(r2, columns01), lo);
+    __m256 hi = _mm256_fmadd_ps(c0, _mm256_permutevar8x32_ps(r0, columns23), c3);
+    hi = _mm256_fmadd_ps(c1, _mm256_permutevar8x32_ps(r1, columns23), hi);
+    hi = _mm256_fmadd_ps(c2, _mm256_permutevar8x32_ps(r2, columns23), hi);
+    float* o = reinterpret_cast<float*>(out + i);
+    _mm256_storeu_ps(o, lo);
+    _mm256_storeu_ps(o + 8, hi);
+  }
+}
+
+}
+
+const BatchKernels batch_kernels_avx2 = {
+  axisAngleKernel<Avx2>,
+  multiplyAffine,
+  modelViewProjection,
+  cullSpheresKernel<Avx2>,
+  cullSpheresViewsKernel<Avx2>,
+  collideBoxesKernel<Avx2>,
+};
+
+#endif
@@ -0,0 +1,118 @@
+// AVX-512F kernels, compiled with -mavx512f (see the Makefile)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define BATCH_MATH_KERNELS
+#include <immintrin.h>
+
+#include "batch_math_simd.h"
+
+namespace {
+
+struct Avx512 {
+  static constexpr size_t width = 16;
+  using V = __m512;
+  using I = __m512i;
+  using Mask = __mmask16;
+
+  static V set1(float x) { return _mm512_set1_ps(x); }
+  static V load(const float* p) { return _mm512_loadu_ps(p); }
+  template <int stride>
+  static V gather(const float* p) {
+    __m512i index = _mm512_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride,
+                                      8 * stride, 9 * stride, 10 * stride, 11 * stride, 12 * stride, 13 * stride, 14 * stride, 15 * stride);
+    return _mm512_i32gather_ps(index, p, 4);
+  }
+  static V add(V a, V b) { return _mm512_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm512_div_ps(a, b); }
+  static V sqrt(V a) { return _mm512_sqrt_ps(a); }
+  static V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+  static V fnmadd(V a, V b, V c) { return _mm512_fnmadd_ps(a, b, c); }
+  static V abs(V a) { return _mm512_abs_ps(a); }
+
+  static I truncate(V a) { return _mm512_cvttps_epi32(a); }
+  static V toFloat(I q) { return _mm512_cvtepi32_ps(q); }
+  static I iadd(I q, int k) { return _mm512_add_epi32(q, _mm512_set1_epi32(k)); }
+  static I iand(I q, int k) { return _mm512_and_epi32(q, _mm512_set1_epi32(k)); }
+  static Mask bitSet(I q, int bit) { return _mm512_test_epi32_mask(q, _mm512_set1_epi32(bit)); }
+
+  static V select(Mask m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); }
+  static V negateIf(V a, Mask m) { return _mm512_mask_sub_ps(a, m, _mm512_setzero_ps(), a); }
+  static Mask less(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+  static Mask greaterEqual(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+  static Mask maskAnd(Mask a, Mask b) { return a & b; }
+  static uint32_t bits(Mask m) { return m; }
+
+  // Lane k of a, b, c and d to p + k * stride
+  static void storeRows(float* p, size_t stride, V a, V b, V c, V d) {
+    // A 4x4 transpose within each 128-bit quarter: quarter q of row[k] is lane 4q + k
+    V ab_lo = _mm512_unpacklo_ps(a, b), ab_hi = _mm512_unpackhi_ps(a, b);
+    V cd_lo = _mm512_unpacklo_ps(c, d), cd_hi = _mm512_unpackhi_ps(c, d);
+    V row[4] = {
+      _mm512_shuffle_ps(ab_lo, cd_lo, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(ab_lo, cd_lo, _MM_SHUFFLE(3, 2, 3, 2)),
+      _mm512_shuffle_ps(ab_hi, cd_hi, _MM_SHUFFLE(1, 0, 1, 0)),
+      _mm512_shuffle_ps(ab_hi, cd_hi, _MM_SHUFFLE(3, 2, 3, 2)),
+    };
+    for (int k = 0; k < 4; k++) {
+      _mm_storeu_ps(p + k * stride, _mm512_extractf32x4_ps(row[k], 0));
+      _mm_storeu_ps(p + (k + 4) * stride, _mm512_extractf32x4_ps(row[k], 1));
+      _mm_storeu_ps(p + (k + 8) * stride, _mm512_extractf32x4_ps(row[k], 2));
+      _mm_storeu_ps(p + (k + 12) * stride, _mm512_extractf32x4_ps(row[k], 3));
+    }
+  }
+};
+
+void multiplyAffine(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out) {
+  // The whole product in the low 12 lanes: quarter r is row r, that is
+  // a[r][0] * b.row0 + a[r][1] * b.row1 + a[r][2] * b.row2 + (0, 0, 0, a[r][3])
+  __m512 ak[3];
+  for (int k = 0; k < 3; k++) {
+    ak[k] = _mm512_setr_ps(a.m[0][k], a.m[0][k], a.m[0][k], a.m[0][k],
+                           a.m[1][k], a.m[1][k], a.m[1][k], a.m[1][k],
+                           a.m[2][k], a.m[2][k], a.m[2][k], a.m[2][k], 0, 0, 0, 0);
+  }
+  __m512 t = _mm512_setr_ps(0, 0, 0, a.m[0][3], 0, 0, 0, a.m[1][3], 0, 0, 0, a.m[2][3], 0, 0, 0, 0);
+  for (size_t i = 0; i < count; i++) {
+    __m512 row = _mm512_fmadd_ps(ak[0], _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[0])), t);
+    row = _mm512_fmadd_ps(ak[1], _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[1])), row);
+    row = _mm512_fmadd_ps(ak[2], _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[2])), row);
+    _mm512_mask_storeu_ps(&out[i].m[0][0], 0x0fff, row);
+  }
+}
+
+void modelViewProjection(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out) {
+  // One product per register, quarter j is column j. The model's last row is
+  // 0 0 0 1: three products per column instead of four, plus vp.col3 for the last column.
+  const float* vp = reinterpret_cast<const float*>(&view_projection);
+  __m512 c0 = _mm512_broadcast_f32x4(_mm_loadu_ps(vp));
+  __m512 c1 = _mm512_broadcast_f32x4(_mm_loadu_ps(vp + 4));
+  __m512 c2 = _mm512_broadcast_f32x4(_mm_loadu_ps(vp + 8));
+  __m512 c3 = _mm512_insertf32x4(_mm512_setzero_ps(), _mm_loadu_ps(vp + 12), 3);
+  // Element j of a model row across the four lanes of quarter j
+  __m512i columns = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+  for (size_t i = 0; i < count; i++) {
+    __m512 r0 = _mm512_permutexvar_ps(columns, _mm512_castps128_ps512(_mm_loadu_ps(models[i].m[0])));
+    __m512 r1 = _mm512_permutexvar_ps(columns, _mm512_castps128_ps512(_mm_loadu_ps(models[i].m[1])));
+    __m512 r2 = _mm512_permutexvar_ps(columns, _mm512_castps128_ps512(_mm_loadu_ps(models[i].m[2])));
+    __m512 product = _mm512_fmadd_ps(c0, r0, c3);
+    product = _mm512_fmadd_ps(c1, r1, product);
+    product = _mm512_fmadd_ps(c2, r2, product);
+    _mm512_storeu_ps(reinterpret_cast<float*>(out + i), product);
+  }
+}
+
+}
+
+const BatchKernels batch_kernels_avx512 = {
+  axisAngleKernel<Avx512>,
+  multiplyAffine,
+  modelViewProjection,
+  cullSpheresKernel<Avx512>,
+  cullSpheresViewsKernel<Avx512>,
+  collideBoxesKernel<Avx512>,
+};
+
+#endif
@@ -0,0 +1,355 @@
+// Internal to batch_math: the kernel table every instruction set fills in,
+// and the kernels that spread objects over the SIMD lanes, written once
+// against a small wrapper (`S` below) that each instruction set provides.
+//
+// Included by the batch_math_<isa>.cpp files, which are compiled with that
+// instruction set enabled. Nothing they compile may end up shared with the
+// rest of the program: an inline function instantiated there (a glm operator,
+// std::min) could be emitted with AVX-512 instructions and then picked by the
+// linker for everyone. So the wrappers live in anonymous namespaces, and
+// matrices and vectors are only touched as plain floats.
+
+#ifndef BATCH_MATH_SIMD_H
+#define BATCH_MATH_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "batch_math.h"
+
+struct BatchKernels {
+  void (*axisAngle)(size_t count, const glm::vec3* positions, const glm::vec3* axes,
+                    const float* scales, const float* angles, AffineTransform* out);
+  void (*multiplyAffine)(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out);
+  void (*modelViewProjection)(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out);
+  size_t (*cullSpheres)(const glm::vec4 planes[6], size_t count, const glm::vec4* spheres, uint32_t* visible);
+  size_t (*cullSpheresViews)(const glm::vec4 (*planes)[6], unsigned views, size_t count, const glm::vec4* spheres,
+                             uint32_t* visible, uint32_t* masks);
+  void (*collideBoxes)(const OrientedBox* boxes, size_t count, const uint32_t* first, const uint32_t* second, BoxContact* out);
+};
+
+extern const BatchKernels batch_kernels_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+extern const BatchKernels batch_kernels_sse4;
+extern const BatchKernels batch_kernels_avx2;
+extern const BatchKernels batch_kernels_avx512;
+#endif
+
+#ifdef BATCH_MATH_KERNELS
+
+namespace {
+
+// sin and cos of every lane, after Cephes' sinf/cosf: reduce to [-pi/4, pi/4]
+// by multiples of pi/2 (split in three for precision), then a polynomial for
+// each, swapped and negated according to the octant. Good to a couple of ulp
+// for |x| up to a few thousand radians.
+template <class S>
+inline void sinCos(typename S::V x, typename S::V& sin, typename S::V& cos) {
+  using V = typename S::V;
+  V ax = S::abs(x);
+  auto q = S::truncate(S::mul(ax, S::set1(1.27323954473516f))); // 4 / pi
+  q = S::iand(S::iadd(q, 1), ~1);
+  V y = S::toFloat(q);
+  V r = S::fnmadd(y, S::set1(0.78515625f), ax);
+  r = S::fnmadd(y, S::set1(2.4187564849853515625e-4f), r);
+  r = S::fnmadd(y, S::set1(3.77489497744594108e-8f), r);
+  V z = S::mul(r, r);
+
+  V pc = S::fmadd(S::set1(2.443315711809948e-5f), z, S::set1(-1.388731625493765e-3f));
+  pc = S::fmadd(pc, z, S::set1(4.166664568298827e-2f));
+  pc = S::mul(S::mul(pc, z), z);
+  pc = S::fnmadd(S::set1(0.5f), z, pc);
+  pc = S::add(pc, S::set1(1.f));
+
+  V ps = S::fmadd(S::set1(-1.9515295891e-4f), z, S::set1(8.3321608736e-3f));
+  ps = S::fmadd(ps, z, S::set1(-1.6666654611e-1f));
+  ps = S::fmadd(S::mul(ps, z), r, r);
+
+  auto swap = S::bitSet(q, 2);
+  sin = S::select(swap, pc, ps);
+  cos = S::select(swap, ps, pc);
+  sin = S::negateIf(sin, S::bitSet(q, 4));
+  sin = S::negateIf(sin, S::less(x, S::set1(0.f)));
+  cos = S::negateIf(cos, S::bitSet(S::iadd(q, 2), 4));
+}
+
+template <class S>
+inline void axisAngleBlock(const float* positions, const float* axes, const float* scales, const float* angles, float* out) {
+  using V = typename S::V;
+  V ax = S::template gather<3>(axes);
+  V ay = S::template gather<3>(axes + 1);
+  V az = S::template gather<3>(axes + 2);
+  // glm::normalize
+  V inv = S::div(S::set1(1.f), S::sqrt(S::fmadd(ax, ax, S::fmadd(ay, ay, S::mul(az, az)))));
+  ax = S::mul(ax, inv);
+  ay = S::mul(ay, inv);
+  az = S::mul(az, inv);
+
+  V s, c;
+  sinCos<S>(S::load(angles), s, c);
+  V t = S::sub(S::set1(1.f), c);
+  V tx = S::mul(t, ax), ty = S::mul(t, ay), tz = S::mul(t, az);
+  V scale = S::load(scales);
+
+  // Rows of the rotation as glm::rotate builds it, times the scale
+  V r00 = S::mul(S::fmadd(tx, ax, c), scale);
+  V r01 = S::mul(S::fnmadd(s, az, S::mul(ty, ax)), scale);
+  V r02 = S::mul(S::fmadd(s, ay, S::mul(tz, ax)), scale);
+  V r10 = S::mul(S::fmadd(s, az, S::mul(tx, ay)), scale);
+  V r11 = S::mul(S::fmadd(ty, ay, c), scale);
+  V r12 = S::mul(S::fnmadd(s, ax, S::mul(tz, ay)), scale);
+  V r20 = S::mul(S::fnmadd(s, ay, S::mul(tx, az)), scale);
+  V r21 = S::mul(S::fmadd(s, ax, S::mul(ty, az)), scale);
+  V r22 = S::mul(S::fmadd(tz, az, c), scale);
+
+  S::storeRows(out, 12, r00, r01, r02, S::template gather<3>(positions));
+  S::storeRows(out + 4, 12, r10, r11, r12, S::template gather<3>(positions + 1));
+  S::storeRows(out + 8, 12, r20, r21, r22, S::template gather<3>(positions + 2));
+}
+
+template <class S>
+void axisAngleKernel(size_t count, const glm::vec3* positions, const glm::vec3* axes,
+                     const float* scales, const float* angles, AffineTransform* out) {
+  constexpr size_t W = S::width;
+  size_t i = 0;
+  for (; i + W <= count; i += W)
+    axisAngleBlock<S>(&positions[i].x, &axes[i].x, scales + i, angles + i, &out[i].m[0][0]);
+  if (i == count)
+    return;
+
+  // The rest goes through the same code, padded, so that every object gets the same rounding
+  float pad_positions[3 * W], pad_axes[3 * W], pad_scales[W], pad_angles[W], pad_out[12 * W];
+  for (size_t k = 0; k < W; k++) {
+    size_t from = i + k < count ? i + k : count - 1;
+    for (int d = 0; d < 3; d++) {
+      pad_positions[3 * k + d] = (&positions[from].x)[d];
+      pad_axes[3 * k + d] = (&axes[from].x)[d];
+    }
+    pad_scales[k] = scales[from];
+    pad_angles[k] = angles[from];
+  }
+  axisAngleBlock<S>(pad_positions, pad_axes, pad_scales, pad_angles, pad_out);
+  for (size_t k = 0; i + k < count; k++) {
+    for (int f = 0; f < 12; f++)
+      (&out[i + k].m[0][0])[f] = pad_out[12 * k + f];
+  }
+}
+
+template <class S>
+size_t cullSpheresKernel(const glm::vec4 planes[6], size_t count, const glm::vec4* spheres, uint32_t* visible) {
+  using V = typename S::V;
+  constexpr size_t W = S::width;
+  V px[6], py[6], pz[6], pd[6];
+  for (int p = 0; p < 6; p++) {
+    const float* plane = &planes[p].x;
+    px[p] = S::set1(plane[0]);
+    py[p] = S::set1(plane[1]);
+    pz[p] = S::set1(plane[2]);
+    pd[p] = S::set1(plane[3]);
+  }
+
+  // Bit k set if sphere k of the block is not entirely behind any plane
+  auto block = [&](const float* sphere) {
+    V cx = S::template gather<4>(sphere);
+    V cy = S::template gather<4>(sphere + 1);
+    V cz = S::template gather<4>(sphere + 2);
+    V radius = S::template gather<4>(sphere + 3);
+    auto inside = S::greaterEqual(S::fmadd(px[0], cx, S::fmadd(py[0], cy, S::fmadd(pz[0], cz, pd[0]))), S::sub(S::set1(0.f), radius));
+    for (int p = 1; p < 6; p++) {
+      V distance = S::fmadd(px[p], cx, S::fmadd(py[p], cy, S::fmadd(pz[p], cz, pd[p])));
+      inside = S::maskAnd(inside, S::greaterEqual(distance, S::sub(S::set1(0.f), radius)));
+    }
+    return S::bits(inside);
+  };
+
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    for (uint32_t bits = block(&spheres[i].x); bits; bits &= bits - 1)
+      visible[n++] = i + __builtin_ctz(bits);
+  }
+  if (i < count) {
+    float pad[4 * W];
+    for (size_t k = 0; k < W; k++) {
+      size_t from = i + k < count ? i + k : count - 1;
+      for (int f = 0; f < 4; f++)
+        pad[4 * k + f] = (&spheres[from].x)[f];
+    }
+    uint32_t bits = block(pad) & ((1u << (count - i)) - 1);
+    for (; bits; bits &= bits - 1)
+      visible[n++] = i + __builtin_ctz(bits);
+  }
+  return n;
+}
+
+// Same test against every view's planes, the spheres loaded once for all of them
+template <class S>
+size_t cullSpheresViewsKernel(const glm::vec4 (*planes)[6], unsigned views, size_t count, const glm::vec4* spheres,
+                              uint32_t* visible, uint32_t* masks) {
+  using V = typename S::V;
+  constexpr size_t W = S::width;
+
+  // Bit k of bits[v] set if sphere k of the block is in view v. Returns the union.
+  uint32_t bits[vgl_max_views];
+  auto block = [&](const float* sphere) {
+    V cx = S::template gather<4>(sphere);
+    V cy = S::template gather<4>(sphere + 1);
+    V cz = S::template gather<4>(sphere + 2);
+    V neg_radius = S::sub(S::set1(0.f), S::template gather<4>(sphere + 3));
+    uint32_t any = 0;
+    for (unsigned v = 0; v < views; v++) {
+      const float* plane = &planes[v][0].x;
+      auto inside = S::greaterEqual(S::fmadd(S::set1(plane[0]), cx, S::fmadd(S::set1(plane[1]), cy, S::fmadd(S::set1(plane[2]), cz, S::set1(plane[3])))), neg_radius);
+      for (int p = 1; p < 6; p++) {
+        plane = &planes[v][p].x;
+        V distance = S::fmadd(S::set1(plane[0]), cx, S::fmadd(S::set1(plane[1]), cy, S::fmadd(S::set1(plane[2]), cz, S::set1(plane[3]))));
+        inside = S::maskAnd(inside, S::greaterEqual(distance, neg_radius));
+      }
+      bits[v] = S::bits(inside);
+      any |= bits[v];
+    }
+    return any;
+  };
+  size_t n = 0;
+  // Turns the per-view bits around into a view mask per visible sphere
+  auto emit = [&](size_t first, uint32_t any) {
+    for (; any; any &= any - 1) {
+      unsigned k = __builtin_ctz(any);
+      uint32_t mask = 0;
+      for (unsigned v = 0; v < views; v++)
+        mask |= (bits[v] >> k & 1) << v;
+      visible[n] = first + k;
+      masks[n++] = mask;
+    }
+  };
+
+  size_t i = 0;
+  for (; i + W <= count; i += W)
+    emit(i, block(&spheres[i].x));
+  if (i < count) {
+    float pad[4 * W];
+    for (size_t k = 0; k < W; k++) {
+      size_t from = i + k < count ? i + k : count - 1;
+      for (int f = 0; f < 4; f++)
+        pad[4 * k + f] = (&spheres[from].x)[f];
+    }
+    emit(i, block(pad) & ((1u << (count - i)) - 1));
+  }
+  return n;
+}
+
+// Fields of an OrientedBox collideBoxesBlock reads, the padding left out
+constexpr int box_fields = 13;
+
+// in holds box_fields arrays of W floats for the first boxes, then as many for
+// the second ones; out gets one BoxContact per lane
+template <class S>
+inline void collideBoxesBlock(const float* in, float* out) {
+  using V = typename S::V;
+  constexpr size_t W = S::width;
+  auto field = [&](int box, int f) { return S::load(in + (box * box_fields + f) * W); };
+
+  V d[3], a[3][3], b[3][3];
+  for (int c = 0; c < 3; c++)
+    d[c] = S::sub(field(1, c), field(0, c));
+  V ha = field(0, 3), hb = field(1, 3);
+  for (int i = 0; i < 3; i++) {
+    for (int c = 0; c < 3; c++) {
+      a[i][c] = field(0, 4 + 3 * i + c);
+      b[i][c] = field(1, 4 + 3 * i + c);
+    }
+  }
+  auto dot = [](const V* x, const V* y) { return S::fmadd(x[0], y[0], S::fmadd(x[1], y[1], S::mul(x[2], y[2]))); };
+
+  // r[i][j] = a_i . b_j. Near-parallel edges are skipped below rather than
+  // padded with an epsilon, which would throw the depths off.
+  V r[3][3], abs_r[3][3], ta[3], tb[3];
+  for (int i = 0; i < 3; i++) {
+    ta[i] = dot(d, a[i]);
+    tb[i] = dot(d, b[i]);
+    for (int j = 0; j < 3; j++) {
+      r[i][j] = dot(a[i], b[j]);
+      abs_r[i][j] = S::abs(r[i][j]);
+    }
+  }
+
+  V best = S::set1(3.4e38f), nx = S::set1(0.f), ny = S::set1(0.f), nz = S::set1(0.f);
+  // Keep the axis `axis` (unit length, signed towards the second box) if `depth` beats the best so far by `margin`
+  auto consider = [&](V depth, V margin, V x, V y, V z) {
+    auto better = S::less(S::mul(depth, margin), best);
+    best = S::select(better, depth, best);
+    nx = S::select(better, x, nx);
+    ny = S::select(better, y, ny);
+    nz = S::select(better, z, nz);
+  };
+  V zero = S::set1(0.f), one = S::set1(1.f);
+  for (int i = 0; i < 3; i++) {
+    V rb = S::mul(hb, S::add(abs_r[i][0], S::add(abs_r[i][1], abs_r[i][2])));
+    V depth = S::sub(S::add(ha, rb), S::abs(ta[i]));
+    auto flip = S::less(ta[i], zero);
+    consider(depth, one, S::negateIf(a[i][0], flip), S::negateIf(a[i][1], flip), S::negateIf(a[i][2], flip));
+  }
+  for (int j = 0; j < 3; j++) {
+    V ra = S::mul(ha, S::add(abs_r[0][j], S::add(abs_r[1][j], abs_r[2][j])));
+    V depth = S::sub(S::add(ra, hb), S::abs(tb[j]));
+    auto flip = S::less(tb[j], zero);
+    consider(depth, one, S::negateIf(b[j][0], flip), S::negateIf(b[j][1], flip), S::negateIf(b[j][2], flip));
+  }
+  for (int i = 0; i < 3; i++) {
+    int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; j++) {
+      int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+      V axis[3] = {
+        S::fnmadd(a[i][2], b[j][1], S::mul(a[i][1], b[j][2])),
+        S::fnmadd(a[i][0], b[j][2], S::mul(a[i][2], b[j][0])),
+        S::fnmadd(a[i][1], b[j][0], S::mul(a[i][0], b[j][1])),
+      };
+      V length = S::sqrt(dot(axis, axis));
+      // Parallel edges have no axis of their own, the faces cover them
+      auto parallel = S::less(length, S::set1(1e-2f));
+      V inv = S::div(one, S::select(parallel, one, length));
+      V ra = S::mul(ha, S::add(abs_r[i1][j], abs_r[i2][j]));
+      V rb = S::mul(hb, S::add(abs_r[i][j1], abs_r[i][j2]));
+      V along = dot(d, axis);
+      V depth = S::mul(S::sub(S::add(ra, rb), S::abs(along)), inv);
+      depth = S::select(parallel, S::set1(3.4e38f), depth);
+      auto flip = S::less(along, zero);
+      consider(depth, S::set1(1.05f), S::negateIf(S::mul(axis[0], inv), flip), S::negateIf(S::mul(axis[1], inv), flip),
+               S::negateIf(S::mul(axis[2], inv), flip));
+    }
+  }
+  S::storeRows(out, 4, nx, ny, nz, best);
+}
+
+template <class S>
+void collideBoxesKernel(const OrientedBox* boxes, size_t count, const uint32_t* first, const uint32_t* second, BoxContact* out) {
+  constexpr size_t W = S::width;
+  // The pairs' boxes are all over the array, so they are copied into lanes one by one
+  float in[2 * box_fields * W], pad_out[4 * W];
+  for (size_t i = 0; i < count; i += W) {
+    for (size_t k = 0; k < W; k++) {
+      size_t from = i + k < count ? i + k : count - 1;
+      const float* box_a = boxes[first[from]].center;
+      const float* box_b = boxes[second[from]].center;
+      for (int f = 0; f < box_fields; f++) {
+        in[f * W + k] = box_a[f];
+        in[(box_fields + f) * W + k] = box_b[f];
+      }
+    }
+    if (i + W <= count) {
+      collideBoxesBlock<S>(in, out[i].normal);
+      continue;
+    }
+    collideBoxesBlock<S>(in, pad_out);
+    for (size_t k = 0; i + k < count; k++) {
+      for (int f = 0; f < 4; f++)
+        (&out[i + k].normal[0])[f] = pad_out[4 * k + f];
+    }
+  }
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+// SSE4.1 kernels, compiled with -msse4.1 (see the Makefile)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define BATCH_MATH_KERNELS
+#include <immintrin.h>
+
+#include "batch_math_simd.h"
+
+namespace {
+
+struct Sse4 {
+  static constexpr size_t width = 4;
+  using V = __m128;
+  using I = __m128i;
+  using Mask = __m128;
+
+  static V set1(float x) { return _mm_set1_ps(x); }
+  static V load(const float* p) { return _mm_loadu_ps(p); }
+  template <int stride>
+  static V gather(const float* p) { return _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm_div_ps(a, b); }
+  static V sqrt(V a) { return _mm_sqrt_ps(a); }
+  // No FMA before AVX2
+  static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static V fnmadd(V a, V b, V c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+  static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+
+  static I truncate(V a) { return _mm_cvttps_epi32(a); }
+  static V toFloat(I q) { return _mm_cvtepi32_ps(q); }
+  static I iadd(I q, int k) { return _mm_add_epi32(q, _mm_set1_epi32(k)); }
+  static I iand(I q, int k) { return _mm_and_si128(q, _mm_set1_epi32(k)); }
+  static Mask bitSet(I q, int bit) {
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(iand(q, bit), _mm_set1_epi32(bit)));
+  }
+
+  static V select(Mask m, V a, V b) { return _mm_blendv_ps(b, a, m); }
+  static V negateIf(V a, Mask m) { return _mm_xor_ps(a, _mm_and_ps(m, _mm_set1_ps(-0.f))); }
+  static Mask less(V a, V b) { return _mm_cmplt_ps(a, b); }
+  static Mask greaterEqual(V a, V b) { return _mm_cmpge_ps(a, b); }
+  static Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+  static uint32_t bits(Mask m) { return _mm_movemask_ps(m); }
+
+  // Lane k of a, b, c and d to p + k * stride
+  static void storeRows(float* p, size_t stride, V a, V b, V c, V d) {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(p, a);
+    _mm_storeu_ps(p + stride, b);
+    _mm_storeu_ps(p + 2 * stride, c);
+    _mm_storeu_ps(p + 3 * stride, d);
+  }
+};
+
+template <int i>
+__m128 splat(__m128 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i)); }
+
+// Column j of vp * model, from the columns of vp and the rows of the model
+template <int j>
+__m128 column(const __m128 c[3], __m128 r0, __m128 r1, __m128 r2, __m128 base) {
+  __m128 col = _mm_add_ps(_mm_mul_ps(c[0], splat<j>(r0)), base);
+  col = _mm_add_ps(_mm_mul_ps(c[1], splat<j>(r1)), col);
+  return _mm_add_ps(_mm_mul_ps(c[2], splat<j>(r2)), col);
+}
+
+void multiplyAffine(const AffineTransform& a, size_t count, const AffineTransform* b, AffineTransform* out) {
+  // Row r of the product is a[r][0] * b.row0 + a[r][1] * b.row1 + a[r][2] * b.row2 + (0, 0, 0, a[r][3])
+  __m128 ar[3][3], at[3];
+  for (int r = 0; r < 3; r++) {
+    for (int k = 0; k < 3; k++)
+      ar[r][k] = _mm_set1_ps(a.m[r][k]);
+    at[r] = _mm_setr_ps(0, 0, 0, a.m[r][3]);
+  }
+  for (size_t i = 0; i < count; i++) {
+    __m128 b0 = _mm_loadu_ps(b[i].m[0]);
+    __m128 b1 = _mm_loadu_ps(b[i].m[1]);
+    __m128 b2 = _mm_loadu_ps(b[i].m[2]);
+    for (int r = 0; r < 3; r++) {
+      __m128 row = _mm_add_ps(_mm_mul_ps(ar[r][0], b0), at[r]);
+      row = _mm_add_ps(_mm_mul_ps(ar[r][1], b1), row);
+      row = _mm_add_ps(_mm_mul_ps(ar[r][2], b2), row);
+      _mm_storeu_ps(out[i].m[r], row);
+    }
+  }
+}
+
+void modelViewProjection(const glm::mat4& view_projection, size_t count, const AffineTransform* models, glm::mat4* out) {
+  // The model's last row is 0 0 0 1: three products per column instead of four
+  const float* vp = reinterpret_cast<const float*>(&view_projection);
+  __m128 c[3] = {_mm_loadu_ps(vp), _mm_loadu_ps(vp + 4), _mm_loadu_ps(vp + 8)};
+  __m128 c3 = _mm_loadu_ps(vp + 12);
+  __m128 zero = _mm_setzero_ps();
+  for (size_t i = 0; i < count; i++) {
+    __m128 r0 = _mm_loadu_ps(models[i].m[0]);
+    __m128 r1 = _mm_loadu_ps(models[i].m[1]);
+    __m128 r2 = _mm_loadu_ps(models[i].m[2]);
+    float* o = reinterpret_cast<float*>(out + i);
+    _mm_storeu_ps(o, column<0>(c, r0, r1, r2, zero));
+    _mm_storeu_ps(o + 4, column<1>(c, r0, r1, r2, zero));
+    _mm_storeu_ps(o + 8, column<2>(c, r0, r1, r2, zero));
+    _mm_storeu_ps(o + 12, column<3>(c, r0, r1, r2, c3));
+  }
+}
+
+}
+
+const BatchKernels batch_kernels_sse4 = {
+  axisAngleKernel<Sse4>,
+  multiplyAffine,
+  modelViewProjection,
+  cullSpheresKernel<Sse4>,
+  cullSpheresViewsKernel<Sse4>,
+  collideBoxesKernel<Sse4>,
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cmath>
+
+#include "batch_math.h"
+#include "camera.h"
+#include "log.h"
+
+using namespace std;
+
+namespace {
+
+constexpr float far_plane = 100;
+// Straight up or down and turning would spin the view around
+constexpr double max_pitch = 89;
+
+}
+
+void CameraState::setPosition(const glm::vec3& p) {
+  if (p == pos)
+    return;
+  pos = p;
+  invalidate(View);
+}
+
+void CameraState::setOrientation(const glm::quat& q) {
+  if (q == rotation)
+    return;
+  rotation = q;
+  pitch = glm::degrees(asin(clamp(direction().y, -1.f, 1.f)));
+  invalidate(View);
+}
+
+glm::vec3 CameraState::direction() const {
+  return rotation * glm::vec3(0, 0, -1);
+}
+
+void CameraState::lookAlong(const glm::vec3& dir) {
+  // Yaw around world up, then pitch around the camera's own x axis
+  glm::vec3 d = glm::normalize(dir);
+  float yaw = atan2(-d.x, -d.z);
+  float p = asin(clamp(d.y, -1.f, 1.f));
+  setOrientation(glm::angleAxis(yaw, world_up) * glm::angleAxis(p, glm::vec3(1, 0, 0)));
+}
+
+void CameraState::turn(double yaw, double pitch_change) {
+  double new_pitch = clamp(pitch + pitch_change, -max_pitch, max_pitch);
+  pitch_change = new_pitch - pitch;
+  if (yaw == 0 && pitch_change == 0)
+    return;
+  // Yaw on the left turns around the world's up, pitch on the right around the camera's x axis
+  rotation = glm::normalize(glm::angleAxis((float)glm::radians(-yaw), world_up) * rotation *
+                            glm::angleAxis((float)glm::radians(pitch_change), glm::vec3(1, 0, 0)));
+  pitch = new_pitch;
+  invalidate(View);
+
+  glm::vec3 dir = direction();
+  VGL_LOG(TRACE, Camera, "dir %g, %g, %g", dir.x, dir.y, dir.z);
+}
+
+void CameraState::setFov(double degrees) {
+  if (degrees == fov_degrees)
+    return;
+  fov_degrees = degrees;
+  invalidate(Projection);
+}
+
+void CameraState::setZNear(double z) {
+  if (z == near_plane)
+    return;
+  near_plane = z;
+  invalidate(Projection);
+}
+
+void CameraState::setAspectRatio(double ratio) {
+  if (ratio == aspect)
+    return;
+  aspect = ratio;
+  invalidate(Projection);
+}
+
+const glm::mat4& CameraState::view() const {
+  update();
+  return view_matrix;
+}
+
+const glm::mat4& CameraState::projection() const {
+  update();
+  return projection_matrix;
+}
+
+const glm::mat4& CameraState::viewProjection() const {
+  update();
+  return view_projection;
+}
+
+const glm::mat4& CameraState::inverseViewProjection() const {
+  update();
+  return inverse_view_projection;
+}
+
+const glm::vec4* CameraState::frustumPlanes() const {
+  update();
+  return planes;
+}
+
+void CameraState::invalidate(unsigned what) {
+  dirty |= what;
+  changes++;
+}
+
+void CameraState::update() const {
+  if (!dirty)
+    return;
+  // The inverse rotation, then the eye to the origin
+  if (dirty & View)
+    view_matrix = glm::translate(glm::mat4_cast(glm::conjugate(rotation)), -pos);
+  if (dirty & Projection)
+    projection_matrix = glm::perspective((float)glm::radians(fov_degrees), (float)aspect, (float)near_plane, far_plane);
+  view_projection = projection_matrix * view_matrix;
+  inverse_view_projection = glm::inverse(view_projection);
+  vglFrustumPlanes(view_projection, planes);
+  dirty = 0;
+}
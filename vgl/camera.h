@@ -0,0 +1,105 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/string_cast.hpp>
+
+#include "input.h"
+
+class InputRecorder;
+
+// The camera never rolls, up is always this
+const glm::vec3 world_up(0, 1, 0);
+
+// Where the camera is and how it projects.
+//
+// Orientation is a quaternion; the matrices are built when asked for and
+// cached until a setter changes what they depend on. version() counts those
+// changes, so anything derived from the camera (culling, uploads) can keep
+// its result for as long as the version stays the same.
+//
+// The matrix getters fill the caches, so a camera shared between threads
+// needs its lock for them as much as for the setters.
+class CameraState {
+public:
+  const glm::vec3& position() const { return pos; }
+  void setPosition(const glm::vec3& p);
+  void move(const glm::vec3& delta) { setPosition(pos + delta); }
+
+  const glm::quat& orientation() const { return rotation; }
+  void setOrientation(const glm::quat& q);
+  // Where the camera looks, unit length
+  glm::vec3 direction() const;
+  // Face along `dir` with no roll
+  void lookAlong(const glm::vec3& dir);
+  // Turn right by `yaw` and up by `pitch` degrees. Pitch stops short of straight up and down.
+  void turn(double yaw, double pitch);
+
+  // FOV in degrees, vertical
+  double fov() const { return fov_degrees; }
+  void setFov(double degrees);
+  double zNear() const { return near_plane; }
+  void setZNear(double z);
+  double aspectRatio() const { return aspect; }
+  void setAspectRatio(double ratio);
+
+  const glm::mat4& view() const;
+  const glm::mat4& projection() const;
+  const glm::mat4& viewProjection() const;
+  const glm::mat4& inverseViewProjection() const;
+  // Left, right, bottom, top, near, far, see vglFrustumPlanes
+  const glm::vec4* frustumPlanes() const;
+
+  // Goes up whenever the matrices change
+  uint64_t version() const { return changes; }
+
+  // Key and mouse button events, queued by the callbacks for handleKeys
+  InputState input;
+
+  // FOV when not zooming. Can be changed with keys.
+  double default_fov = 90;
+
+  // last camera position
+  double lastX = 0, lastY = 0;
+  bool firstMouseCall = true;
+
+  // Where the callbacks also send the events, if anywhere
+  InputRecorder* recorder = nullptr;
+
+  // glfwGetTime() of the latest input event, for measuring input-to-swap latency
+  double last_input_time = 0;
+
+  // The mouse callback runs on the main thread while the simulation thread
+  // moves the camera, so both take this while touching the state above.
+  // Keys and buttons go through `input` and do not need it.
+  std::mutex input_mutex;
+
+private:
+  enum Dirty : unsigned { View = 1, Projection = 2 };
+  void invalidate(unsigned what);
+  void update() const;
+
+  glm::vec3 pos = glm::vec3(0, 0, 1.5); // aka eye
+  glm::quat rotation{1, 0, 0, 0}; // identity looks down -z
+  // Kept alongside `rotation` for the limit in turn()
+  double pitch = 0;
+  double fov_degrees = default_fov;
+  double near_plane = 0.01;
+  double aspect = 4. / 3;
+
+  uint64_t changes = 0;
+  mutable unsigned dirty = View | Projection;
+  mutable glm::mat4 view_matrix, projection_matrix, view_projection, inverse_view_projection;
+  mutable glm::vec4 planes[6];
+};
+
+#endif
@@ -0,0 +1,331 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "command_buffer.h"
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// glad is generated for GL 3.3, so the viewport array entry point is looked up by vglLoadViewportArray
+using ViewportIndexedfProc = void (APIENTRY*)(GLuint index, GLfloat x, GLfloat y, GLfloat width, GLfloat height);
+ViewportIndexedfProc viewport_indexed = nullptr;
+
+struct ClearCmd { GLbitfield mask; };
+struct ClearColorBufferCmd { GLfloat value[4]; };
+struct NameCmd { GLuint name; };
+struct CapabilityCmd { GLenum capability; };
+struct DepthMaskCmd { GLboolean write; };
+struct BlendFuncCmd { GLenum source, destination; };
+struct BindFramebufferCmd { GLenum target; GLuint framebuffer; };
+struct BindTextureCmd { GLuint unit; GLenum target; GLuint texture; };
+struct BindBufferBaseCmd { GLenum target; GLuint index; GLuint buffer; };
+struct BufferSubDataCmd { GLenum target; GLuint buffer; GLintptr offset; GLsizeiptr size; };
+struct BufferDataRefCmd { GLenum target; GLuint buffer; GLsizeiptr size; const void* data; GLenum usage; };
+struct Uniform1iCmd { GLint location; GLint value; };
+struct Uniform1fCmd { GLint location; GLfloat value; };
+struct Uniform2fCmd { GLint location; GLfloat x, y; };
+struct UniformMatrix4fvCmd { GLint location; GLfloat matrix[16]; };
+struct UniformMatrix4fvRefCmd { GLint location; const glm::mat4* matrix; };
+// Followed by the matrices
+struct UniformMatrix4fvArrayCmd { GLint location; GLsizei count; };
+struct ViewportCmd { GLuint index; GLint x, y; GLsizei width, height; };
+struct DrawArraysCmd { GLenum mode; GLint first; GLsizei count; };
+struct DrawArraysInstancedCmd { GLenum mode; GLint first; GLsizei count; GLsizei instances; };
+struct QueryCmd { GLenum target; GLuint query; };
+
+constexpr size_t alignment = 4;
+// Whatever does not fit in the 24 bits of the header's size field
+constexpr size_t max_command_size = (1 << 24) - 1;
+
+// Commands are stored unaligned as far as the compiler knows, so read them with memcpy.
+// For these sizes it compiles down to plain loads.
+template <class T>
+T read(const unsigned char* p) {
+  T value;
+  memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+}
+
+bool vglLoadViewportArray() {
+  bool core = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+  if (!core && !glfwExtensionSupported("GL_ARB_viewport_array"))
+    return false;
+  viewport_indexed = reinterpret_cast<ViewportIndexedfProc>(glfwGetProcAddress("glViewportIndexedf"));
+  return viewport_indexed != nullptr;
+}
+
+template <class T>
+void CommandBuffer::push(Op op, const T& payload, const void* extra, size_t extra_size) {
+  size_t size = sizeof(Header) + sizeof(T) + extra_size;
+  size = (size + alignment - 1) & ~(alignment - 1);
+  if (size > max_command_size)
+    throw length_error{"CommandBuffer: command too large"};
+  size_t at = data.size();
+  data.resize(at + size);
+  Header header = (uint32_t)op | (uint32_t)size << 8;
+  memcpy(&data[at], &header, sizeof(header));
+  memcpy(&data[at + sizeof(header)], &payload, sizeof(T));
+  if (extra_size)
+    memcpy(&data[at + sizeof(header) + sizeof(T)], extra, extra_size);
+}
+
+void CommandBuffer::clear(GLbitfield mask) {
+  push(Op::Clear, ClearCmd{mask});
+}
+
+void CommandBuffer::clearColorBuffer(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  push(Op::ClearColorBuffer, ClearColorBufferCmd{{r, g, b, a}});
+}
+
+void CommandBuffer::enable(GLenum capability) {
+  push(Op::Enable, CapabilityCmd{capability});
+}
+
+void CommandBuffer::disable(GLenum capability) {
+  push(Op::Disable, CapabilityCmd{capability});
+}
+
+void CommandBuffer::depthMask(GLboolean write) {
+  push(Op::DepthMask, DepthMaskCmd{write});
+}
+
+void CommandBuffer::blendFunc(GLenum source, GLenum destination) {
+  push(Op::BlendFunc, BlendFuncCmd{source, destination});
+}
+
+void CommandBuffer::bindFramebuffer(GLenum target, GLuint framebuffer) {
+  push(Op::BindFramebuffer, BindFramebufferCmd{target, framebuffer});
+}
+
+void CommandBuffer::useProgram(GLuint program) {
+  push(Op::UseProgram, NameCmd{program});
+}
+
+void CommandBuffer::bindVertexArray(GLuint vao) {
+  push(Op::BindVertexArray, NameCmd{vao});
+}
+
+void CommandBuffer::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  push(Op::BindTexture, BindTextureCmd{unit, target, texture});
+}
+
+void CommandBuffer::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  push(Op::BindBufferBase, BindBufferBaseCmd{target, index, buffer});
+}
+
+void CommandBuffer::bufferSubData(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+  push(Op::BufferSubData, BufferSubDataCmd{target, buffer, offset, size}, data, size);
+}
+
+void CommandBuffer::bufferDataRef(GLenum target, GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {
+  push(Op::BufferDataRef, BufferDataRefCmd{target, buffer, size, data, usage});
+}
+
+void CommandBuffer::uniform1i(GLint location, GLint value) {
+  push(Op::Uniform1i, Uniform1iCmd{location, value});
+}
+
+void CommandBuffer::uniform1f(GLint location, GLfloat value) {
+  push(Op::Uniform1f, Uniform1fCmd{location, value});
+}
+
+void CommandBuffer::uniform2f(GLint location, GLfloat x, GLfloat y) {
+  push(Op::Uniform2f, Uniform2fCmd{location, x, y});
+}
+
+void CommandBuffer::uniformMatrix4fv(GLint location, const glm::mat4& matrix) {
+  UniformMatrix4fvCmd cmd;
+  cmd.location = location;
+  memcpy(cmd.matrix, glm::value_ptr(matrix), sizeof(cmd.matrix));
+  push(Op::UniformMatrix4fv, cmd);
+}
+
+void CommandBuffer::uniformMatrix4fvRef(GLint location, const glm::mat4* matrix) {
+  push(Op::UniformMatrix4fvRef, UniformMatrix4fvRefCmd{location, matrix});
+}
+
+void CommandBuffer::uniformMatrix4fv(GLint location, GLsizei count, const glm::mat4* matrices) {
+  push(Op::UniformMatrix4fvArray, UniformMatrix4fvArrayCmd{location, count}, matrices, count * sizeof(glm::mat4));
+}
+
+void CommandBuffer::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  push(Op::Viewport, ViewportCmd{0, x, y, width, height});
+}
+
+void CommandBuffer::viewportIndexed(GLuint index, GLint x, GLint y, GLsizei width, GLsizei height) {
+  push(Op::ViewportIndexed, ViewportCmd{index, x, y, width, height});
+}
+
+void CommandBuffer::drawArrays(GLenum mode, GLint first, GLsizei count) {
+  push(Op::DrawArrays, DrawArraysCmd{mode, first, count});
+}
+
+void CommandBuffer::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+  push(Op::DrawArraysInstanced, DrawArraysInstancedCmd{mode, first, count, instances});
+}
+
+void CommandBuffer::beginQuery(GLenum target, GLuint query) {
+  push(Op::BeginQuery, QueryCmd{target, query});
+}
+
+void CommandBuffer::endQuery(GLenum target) {
+  push(Op::EndQuery, QueryCmd{target, 0});
+}
+
+void CommandBuffer::replay(FrameStats& stats) const {
+  VGL_PROFILE_ZONE("CommandBuffer::replay");
+
+  const unsigned char* p = data.data();
+  const unsigned char* end = p + data.size();
+  uint64_t calls = 0, draws = 0, bytes = 0;
+
+  while (p < end) {
+    auto header = read<Header>(p);
+    const unsigned char* payload = p + sizeof(Header);
+    switch ((Op)(header & 0xff)) {
+    case Op::Clear:
+      glClear(read<ClearCmd>(payload).mask);
+      break;
+    case Op::ClearColorBuffer:
+      glClearBufferfv(GL_COLOR, 0, read<ClearColorBufferCmd>(payload).value);
+      break;
+    case Op::Enable:
+      glEnable(read<CapabilityCmd>(payload).capability);
+      break;
+    case Op::Disable:
+      glDisable(read<CapabilityCmd>(payload).capability);
+      break;
+    case Op::DepthMask:
+      glDepthMask(read<DepthMaskCmd>(payload).write);
+      break;
+    case Op::BlendFunc: {
+      auto cmd = read<BlendFuncCmd>(payload);
+      glBlendFunc(cmd.source, cmd.destination);
+      break;
+    }
+    case Op::BindFramebuffer: {
+      auto cmd = read<BindFramebufferCmd>(payload);
+      glBindFramebuffer(cmd.target, cmd.framebuffer);
+      break;
+    }
+    case Op::UseProgram:
+      glUseProgram(read<NameCmd>(payload).name);
+      break;
+    case Op::BindVertexArray:
+      glBindVertexArray(read<NameCmd>(payload).name);
+      break;
+    case Op::BindTexture: {
+      auto cmd = read<BindTextureCmd>(payload);
+      glActiveTexture(GL_TEXTURE0 + cmd.unit);
+      glBindTexture(cmd.target, cmd.texture);
+      calls++;
+      break;
+    }
+    case Op::BindBufferBase: {
+      auto cmd = read<BindBufferBaseCmd>(payload);
+      glBindBufferBase(cmd.target, cmd.index, cmd.buffer);
+      break;
+    }
+    case Op::BufferSubData: {
+      auto cmd = read<BufferSubDataCmd>(payload);
+      glBindBuffer(cmd.target, cmd.buffer);
+      glBufferSubData(cmd.target, cmd.offset, cmd.size, payload + sizeof(BufferSubDataCmd));
+      calls++;
+      bytes += cmd.size;
+      break;
+    }
+    case Op::BufferDataRef: {
+      auto cmd = read<BufferDataRefCmd>(payload);
+      glBindBuffer(cmd.target, cmd.buffer);
+      glBufferData(cmd.target, cmd.size, cmd.data, cmd.usage);
+      calls++;
+      bytes += cmd.size;
+      break;
+    }
+    case Op::Uniform1i: {
+      auto cmd = read<Uniform1iCmd>(payload);
+      glUniform1i(cmd.location, cmd.value);
+      bytes += sizeof(GLint);
+      break;
+    }
+    case Op::Uniform1f: {
+      auto cmd = read<Uniform1fCmd>(payload);
+      glUniform1f(cmd.location, cmd.value);
+      bytes += sizeof(GLfloat);
+      break;
+    }
+    case Op::Uniform2f: {
+      auto cmd = read<Uniform2fCmd>(payload);
+      glUniform2f(cmd.location, cmd.x, cmd.y);
+      bytes += 2 * sizeof(GLfloat);
+      break;
+    }
+    case Op::UniformMatrix4fv:
+      // Straight from the buffer, no need to copy the matrix out first
+      glUniformMatrix4fv(read<GLint>(payload), 1, GL_FALSE,
+                         reinterpret_cast<const GLfloat*>(payload + offsetof(UniformMatrix4fvCmd, matrix)));
+      bytes += 16 * sizeof(GLfloat);
+      break;
+    case Op::UniformMatrix4fvRef: {
+      auto cmd = read<UniformMatrix4fvRefCmd>(payload);
+      glUniformMatrix4fv(cmd.location, 1, GL_FALSE, glm::value_ptr(*cmd.matrix));
+      bytes += 16 * sizeof(GLfloat);
+      break;
+    }
+    case Op::UniformMatrix4fvArray: {
+      auto cmd = read<UniformMatrix4fvArrayCmd>(payload);
+      glUniformMatrix4fv(cmd.location, cmd.count, GL_FALSE,
+                         reinterpret_cast<const GLfloat*>(payload + sizeof(UniformMatrix4fvArrayCmd)));
+      bytes += cmd.count * 16 * sizeof(GLfloat);
+      break;
+    }
+    case Op::Viewport: {
+      auto cmd = read<ViewportCmd>(payload);
+      glViewport(cmd.x, cmd.y, cmd.width, cmd.height);
+      break;
+    }
+    case Op::ViewportIndexed: {
+      auto cmd = read<ViewportCmd>(payload);
+      viewport_indexed(cmd.index, cmd.x, cmd.y, cmd.width, cmd.height);
+      break;
+    }
+    case Op::DrawArrays: {
+      auto cmd = read<DrawArraysCmd>(payload);
+      glDrawArrays(cmd.mode, cmd.first, cmd.count);
+      draws++;
+      break;
+    }
+    case Op::DrawArraysInstanced: {
+      auto cmd = read<DrawArraysInstancedCmd>(payload);
+      glDrawArraysInstanced(cmd.mode, cmd.first, cmd.count, cmd.instances);
+      draws++;
+      break;
+    }
+    case Op::BeginQuery: {
+      auto cmd = read<QueryCmd>(payload);
+      glBeginQuery(cmd.target, cmd.query);
+      break;
+    }
+    case Op::EndQuery:
+      glEndQuery(read<QueryCmd>(payload).target);
+      break;
+    }
+    calls++;
+    p += header >> 8;
+  }
+
+  stats.gl_calls += calls;
+  stats.draw_calls += draws;
+  stats.bytes_uploaded += bytes;
+}
@@ -0,0 +1,115 @@
+// CPU-side GL command buffers.
+//
+// GL calls can only be made on the context thread, but working out which
+// calls to make does not need the context. Worker threads record into their
+// own CommandBuffer and the render thread replays the buffers in order.
+// The commands are per-frame data, so they usually live in a FrameArena.
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frame_arena.h"
+#include "frame_stats.h"
+
+class CommandBuffer {
+public:
+  explicit CommandBuffer(const FrameAllocator<unsigned char>& allocator = {}) : data(allocator) {}
+
+  void clear(GLbitfield mask);
+  // Clears color attachment 0 to that value, whatever glClearColor says
+  void clearColorBuffer(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+  void enable(GLenum capability);
+  void disable(GLenum capability);
+  void depthMask(GLboolean write);
+  void blendFunc(GLenum source, GLenum destination);
+  void bindFramebuffer(GLenum target, GLuint framebuffer);
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  void bindTexture(GLuint unit, GLenum target, GLuint texture);
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  // The data is copied into the command buffer
+  void bufferSubData(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+  // New storage for the whole buffer, filled from `data`. Only keeps the
+  // pointer, like uniformMatrix4fvRef. The old storage is orphaned, so the
+  // upload does not wait for draws still reading it.
+  void bufferDataRef(GLenum target, GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+  void uniform1i(GLint location, GLint value);
+  void uniform1f(GLint location, GLfloat value);
+  void uniform2f(GLint location, GLfloat x, GLfloat y);
+  void uniformMatrix4fv(GLint location, const glm::mat4& matrix);
+  // Same, but only keeps a pointer: the matrix has to stay put until the buffer is replayed.
+  // A quarter of the size, which adds up with one matrix per draw.
+  void uniformMatrix4fvRef(GLint location, const glm::mat4* matrix);
+  // A uniform array of `count` matrices, copied
+  void uniformMatrix4fv(GLint location, GLsizei count, const glm::mat4* matrices);
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  // Viewport `index` of the array, only if vglLoadViewportArray() said yes
+  void viewportIndexed(GLuint index, GLint x, GLint y, GLsizei width, GLsizei height);
+  void drawArrays(GLenum mode, GLint first, GLsizei count);
+  void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+  // Queries around some of the commands, see GpuQueryRing
+  void beginQuery(GLenum target, GLuint query);
+  void endQuery(GLenum target);
+
+  // Issue the recorded calls. Must run on the context thread.
+  void replay(FrameStats& stats) const;
+
+  // Forget the commands but keep the memory
+  void reset() { data.clear(); }
+  // Make room for `bytes` more bytes of commands, saves regrowing an arena allocation
+  void reserve(size_t bytes) { data.reserve(data.size() + bytes); }
+  bool empty() const { return data.empty(); }
+  size_t bytes() const { return data.size(); }
+
+private:
+  enum class Op : uint8_t {
+    Clear,
+    ClearColorBuffer,
+    Enable,
+    Disable,
+    DepthMask,
+    BlendFunc,
+    BindFramebuffer,
+    UseProgram,
+    BindVertexArray,
+    BindTexture,
+    BindBufferBase,
+    BufferSubData,
+    BufferDataRef,
+    Uniform1i,
+    Uniform1f,
+    Uniform2f,
+    UniformMatrix4fv,
+    UniformMatrix4fvRef,
+    UniformMatrix4fvArray,
+    Viewport,
+    ViewportIndexed,
+    DrawArrays,
+    DrawArraysInstanced,
+    BeginQuery,
+    EndQuery,
+  };
+
+  // Every command starts with a 32-bit header: the Op in the low byte and
+  // the size of the whole command (header, payload, padding to 4 bytes) above it.
+  using Header = uint32_t;
+
+  template <class T>
+  void push(Op op, const T& payload, const void* extra = nullptr, size_t extra_size = 0);
+
+  FrameVector<unsigned char> data;
+};
+
+// Looks up glViewportIndexedf, which the GL 3.3 glad leaves out. False if the
+// context has neither GL 4.1 nor ARB_viewport_array, in which case
+// viewportIndexed() must not be replayed. Needs the context current.
+bool vglLoadViewportArray();
+
+#endif
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <mutex>
+
+#include <GLFW/glfw3.h>
+
+#include "camera.h"
+#include "input.h"
+#include "input_record.h"
+#include "log.h"
+#include "vgl.h"
+
+using namespace std;
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+  //cout << "Key event!\n" << flush;
+
+  CameraState *cam = static_cast<CameraState *>(glfwGetWindowUserPointer(window));
+
+  // Not interested in repeats, they only mess things up with jerky motion
+  // If a key has been pressed, we *know* it's still pressed if it hasn't been released
+  // (big brain moment)
+  if (action == GLFW_REPEAT || key < 0 || key > GLFW_KEY_LAST)
+    return;
+
+  double now = glfwGetTime();
+  InputEvent event{InputEvent::Key, (uint8_t)action, (int16_t)key, now};
+  cam->input.push(event);
+  if (cam->recorder)
+    cam->recorder->record(event);
+  cam->last_input_time = now;
+
+  VGL_LOG(TRACE, Input, "key %d action %d", key, action);
+}
+
+void turnCamera(CameraState& cam, double xPos, double yPos) {
+  if (cam.firstMouseCall) {
+    cam.lastX = xPos;
+    cam.lastY = yPos;
+    cam.firstMouseCall = false;
+    return;
+  }
+
+  constexpr double sensitivity = 0.1;
+
+  double xOffset = xPos - cam.lastX;
+  double yOffset = yPos - cam.lastY;
+  cam.lastX = xPos;
+  cam.lastY = yPos;
+
+  // Right and up on the screen turn right and up
+  cam.turn(xOffset * sensitivity, -yOffset * sensitivity);
+}
+
+void mouse_callback (GLFWwindow* window, double xPos, double yPos) {
+  // Looking around is applied right here rather than queued: the render
+  // thread late-latches the direction, so it has to be current.
+  auto cam = static_cast<CameraState *>(glfwGetWindowUserPointer(window));
+  double now = glfwGetTime();
+  if (cam->recorder)
+    cam->recorder->recordCursor(now, xPos, yPos);
+
+  lock_guard<mutex> lock(cam->input_mutex);
+  cam->last_input_time = now;
+  turnCamera(*cam, xPos, yPos);
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+  auto cam = static_cast<CameraState *>(glfwGetWindowUserPointer(window));
+
+  double now = glfwGetTime();
+  InputEvent event{InputEvent::MouseButton, (uint8_t)action, (int16_t)button, now};
+  cam->input.push(event);
+  if (cam->recorder)
+    cam->recorder->record(event);
+  cam->last_input_time = now;
+
+  VGL_LOG(TRACE, Input, "mouse button %d action %d", button, action);
+}
+
+void handleKeys(CameraState& cam, double now, double step) {
+  // The camera only rebuilds its projection if something here changed it
+  bool projection_changed = false;
+
+  // Runs on the simulation thread, the only consumer of the queue
+  cam.input.drain([&](const InputEvent& event) {
+    if (event.kind == InputEvent::MouseButton && event.code == GLFW_MOUSE_BUTTON_RIGHT) {
+      lock_guard<mutex> lock(cam.input_mutex);
+      if (event.action == GLFW_PRESS)
+        // "Aiming down sights" style zoom
+        cam.setFov(cam.default_fov * 0.5);
+      else
+        cam.setFov(cam.default_fov);
+      projection_changed = true;
+    }
+  });
+
+  lock_guard<mutex> lock(cam.input_mutex);
+
+  constexpr float speed = 0.05;
+  // Scale the per-frame amounts so that they do not depend on the step rate
+  float step_scale = step * 60;
+  glm::vec3 dir = cam.direction();
+  cam.input.held.forEach([&](int key) {
+    // A key pressed after the step's time but before it ran has not been held yet
+    float dt = max(0., now - cam.input.pressed_at[key]);
+    float dts = speed * dt * step_scale;
+
+    switch (action_map[key]) {
+      case Action::Forward:
+        cam.move(dir * dts);
+        VGL_LOG(TRACE, Camera, "up");
+        break;
+      case Action::Back:
+        cam.move(-dir * dts);
+        VGL_LOG(TRACE, Camera, "down");
+        break;
+      case Action::Left:
+        cam.move(-glm::normalize(glm::cross(dir, world_up)) * dts);
+        break;
+      case Action::Right:
+        cam.move(glm::normalize(glm::cross(dir, world_up)) * dts);
+        break;
+      case Action::Up:
+        cam.move(world_up * dts);
+        break;
+      case Action::Down:
+        cam.move(-world_up * dts);
+        break;
+      case Action::FovNarrower:
+        cam.default_fov -= 1 * dt * step_scale;
+        break;
+      case Action::FovWider:
+        cam.default_fov += 1 * dt * step_scale;
+        break;
+      case Action::NearCloser:
+        cam.setZNear(cam.zNear() - 0.01 * dt * step_scale);
+        projection_changed = true;
+        break;
+      case Action::NearFarther:
+        cam.setZNear(cam.zNear() + 0.01 * dt * step_scale);
+        projection_changed = true;
+        break;
+      case Action::None:
+        break;
+    }
+  });
+
+  if (projection_changed)
+    VGL_LOG(DEBUG, Camera, "FOV = %g, zNear = %g", cam.fov(), cam.zNear());
+}
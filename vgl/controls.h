@@ -0,0 +1,20 @@
+#ifndef CONTROLS_H
+#define CONTROLS_H
+
+#include <GLFW/glfw3.h>
+
+#include "camera.h"
+#include "vgl.h"
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouse_callback (GLFWwindow* window, double xPos, double yPos);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+// What mouse_callback does with a cursor position: turn the camera by how far
+// the cursor moved since the last one. Takes cam.input_mutex being held.
+void turnCamera(CameraState& cam, double xPos, double yPos);
+// Move the camera according to the keys being held at time `now`, on the
+// clock of the input events. `step` is the time being simulated; movement was
+// tuned for one call per 60 Hz frame.
+void handleKeys(CameraState& cam, double now, double step = 1. / 60);
+
+#endif
\ No newline at end of file
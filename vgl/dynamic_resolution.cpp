@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "dynamic_resolution.h"
+#include "log.h"
+
+using namespace std;
+
+namespace {
+
+// Further back than any GpuTimer delivers
+constexpr size_t history_size = 64;
+
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionConfig& cfg)
+  : cfg(cfg), history(history_size) {
+  if (!(cfg.min_scale > 0 && cfg.min_scale <= cfg.max_scale && cfg.max_scale <= 1))
+    throw invalid_argument{"DynamicResolution: scale bounds must satisfy 0 < min <= max <= 1"};
+  if (!(cfg.budget_ms > 0 && cfg.step > 0))
+    throw invalid_argument{"DynamicResolution: budget and step must be positive"};
+  // Full resolution until there is something to go by
+  current = cfg.max_scale;
+}
+
+float DynamicResolution::nextFrame() {
+  history[frames++ % history.size()] = current;
+  return current;
+}
+
+void DynamicResolution::report(uint64_t frame, double gpu_ms) {
+  if (frame >= frames || frames - frame > history.size())
+    return;
+  float rendered_at = history[frame % history.size()];
+  double full_ms = gpu_ms / (rendered_at * rendered_at);
+  estimate = estimate == 0 ? full_ms : estimate + cfg.smoothing * (full_ms - estimate);
+
+  auto predicted = [&](float scale) { return estimate * scale * scale; };
+  float previous = current;
+  if (predicted(current) > cfg.budget_ms) {
+    // Over budget: straight down to the largest step that fits
+    float fits = sqrt(cfg.budget_ms / estimate);
+    current = max(cfg.min_scale, min(current, quantize(floor(fits / cfg.step) * cfg.step)));
+    settled = 0;
+  } else {
+    float higher = min(cfg.max_scale, quantize(current + cfg.step));
+    if (higher > current && predicted(higher) <= cfg.budget_ms * cfg.raise_below) {
+      if (++settled >= cfg.settle_frames) {
+        current = higher;
+        settled = 0;
+      }
+    } else {
+      settled = 0;
+    }
+  }
+  if (current != previous)
+    VGL_LOG(DEBUG, Render, "resolution scale %.2f -> %.2f, %.2f ms at full resolution", previous, current, estimate);
+}
+
+float DynamicResolution::quantize(float scale) const {
+  // Rounding to the nearest step, so float error cannot make two steps of one
+  return max(cfg.min_scale, min(cfg.max_scale, (float)(lround(scale / cfg.step) * cfg.step)));
+}
@@ -0,0 +1,65 @@
+// Dynamic resolution: picks the scale the scene is rendered at so that the
+// GPU time of a frame stays within a budget.
+//
+// GPU times come in a few frames late (see GpuTimer) and are taken to go with
+// the number of pixels, the square of the scale. From them the controller
+// keeps a smoothed estimate of what a frame would take at full resolution.
+// It drops the scale as soon as the estimate says the current one is over
+// budget, but only raises it one step at a time, after the estimate has said
+// for a while that the higher scale stays well under budget. Between the two
+// thresholds it holds still, so it does not flip back and forth.
+//
+// No GL, any thread, though one at a time.
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cstdint>
+#include <vector>
+
+struct DynamicResolutionConfig {
+  // GPU milliseconds a frame may take
+  double budget_ms = 16.7;
+  // Bounds of the scale, of the width and height each
+  float min_scale = 0.5f;
+  float max_scale = 1;
+  // Scales are multiples of this. Each new one reallocates the render target,
+  // so they should not be too fine.
+  float step = 0.05f;
+  // Only go up when the higher scale is estimated at this fraction of the budget or less...
+  double raise_below = 0.85;
+  // ...for this many measurements in a row
+  int settle_frames = 30;
+  // Weight of a new measurement in the estimate
+  double smoothing = 0.2;
+};
+
+class DynamicResolution {
+public:
+  // Throws invalid_argument for bounds that are out of order or outside (0, 1]
+  explicit DynamicResolution(const DynamicResolutionConfig& cfg);
+
+  // The scale to render the next frame at. Call it once per frame, before the
+  // frame is rendered; frames are numbered by these calls, from 0, which is
+  // how GpuTimer numbers them too.
+  float nextFrame();
+  // The GPU took `gpu_ms` for `frame`. Results for frames too far back are ignored.
+  void report(uint64_t frame, double gpu_ms);
+
+  float scale() const { return current; }
+  // What a frame is estimated to take at full resolution, 0 before the first report
+  double fullResolutionMs() const { return estimate; }
+
+private:
+  float quantize(float scale) const;
+
+  DynamicResolutionConfig cfg;
+  float current;
+  // Scale of the recent frames, by frame number
+  std::vector<float> history;
+  uint64_t frames = 0;
+  double estimate = 0;
+  int settled = 0;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "ecs.h"
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// Bytes per component of each type. Written once per type before its id is
+// handed out, read without locking after.
+size_t component_sizes[max_component_types];
+mutex types_mutex;
+size_t type_count = 0;
+
+// Every column starts on a cache line
+constexpr size_t column_alignment = 64;
+
+size_t alignUp(size_t offset) {
+  return (offset + column_alignment - 1) / column_alignment * column_alignment;
+}
+
+// The types of a mask, lowest id first
+template <class F>
+void forEachType(ComponentMask mask, F&& fn) {
+  for (size_t id = 0; mask; id++, mask >>= 1)
+    if (mask & 1)
+      fn(id);
+}
+
+}
+
+size_t vglRegisterComponent(size_t size, size_t alignment) {
+  if (alignment > column_alignment)
+    throw invalid_argument{"Components aligned to more than " + to_string(column_alignment) + " bytes are not supported"};
+  lock_guard<mutex> lock(types_mutex);
+  if (type_count == max_component_types)
+    throw length_error{"More than " + to_string(max_component_types) + " component types"};
+  component_sizes[type_count] = size;
+  return type_count++;
+}
+
+uint32_t EntityWorld::archetypeOf(ComponentMask mask) {
+  auto found = archetype_index.find(mask);
+  if (found != archetype_index.end())
+    return found->second;
+
+  auto archetype = make_unique<Archetype>();
+  archetype->mask = mask;
+  size_t row_bytes = sizeof(Entity), columns = 1;
+  forEachType(mask, [&](size_t id) {
+    row_bytes += component_sizes[id];
+    columns++;
+  });
+  // Less what rounding every column up to a cache line can take
+  archetype->capacity = (chunk_bytes - columns * column_alignment) / row_bytes;
+  if (archetype->capacity == 0)
+    throw length_error{"Components too big for a chunk of " + to_string(chunk_bytes) + " bytes"};
+  size_t offset = alignUp(archetype->capacity * sizeof(Entity));
+  forEachType(mask, [&](size_t id) {
+    archetype->offsets[id] = offset;
+    offset = alignUp(offset + archetype->capacity * component_sizes[id]);
+  });
+
+  uint32_t index = archetypes.size();
+  archetypes.push_back(std::move(archetype));
+  archetype_index.emplace(mask, index);
+  return index;
+}
+
+Entity EntityWorld::allocate(ComponentMask mask) {
+  uint32_t archetype = archetypeOf(mask);
+  uint32_t index;
+  if (!free_indices.empty()) {
+    index = free_indices.back();
+    free_indices.pop_back();
+  } else {
+    index = records.size();
+    records.emplace_back();
+  }
+  place(archetype, index);
+  live++;
+  return Entity{index, records[index].generation};
+}
+
+void EntityWorld::place(uint32_t archetype_index, uint32_t index) {
+  Archetype& archetype = *archetypes[archetype_index];
+  if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+    archetype.chunks.emplace_back();
+  Chunk& chunk = archetype.chunks.back();
+  Record& record = records[index];
+  record.archetype = archetype_index;
+  record.chunk = archetype.chunks.size() - 1;
+  record.row = chunk.count++;
+  record.alive = true;
+  handles(chunk)[record.row] = Entity{index, record.generation};
+}
+
+void EntityWorld::unlink(const Record& record) {
+  Archetype& archetype = *archetypes[record.archetype];
+  Chunk& chunk = archetype.chunks[record.chunk];
+  Chunk& last = archetype.chunks.back();
+  size_t last_row = last.count - 1;
+  if (&chunk != &last || record.row != last_row) {
+    Entity moved = handles(last)[last_row];
+    handles(chunk)[record.row] = moved;
+    forEachType(archetype.mask, [&](size_t id) {
+      size_t size = component_sizes[id], offset = archetype.offsets[id];
+      memcpy(chunk.data->bytes + offset + record.row * size, last.data->bytes + offset + last_row * size, size);
+    });
+    records[moved.index].chunk = record.chunk;
+    records[moved.index].row = record.row;
+  }
+  if (--last.count == 0)
+    archetype.chunks.pop_back();
+}
+
+void EntityWorld::destroy(Entity e) {
+  if (!alive(e))
+    return;
+  Record& record = records[e.index];
+  unlink(record);
+  record.alive = false;
+  record.generation++;
+  free_indices.push_back(e.index);
+  live--;
+}
+
+bool EntityWorld::alive(Entity e) const {
+  return e.index < records.size() && records[e.index].alive && records[e.index].generation == e.generation;
+}
+
+void EntityWorld::migrate(Entity e, ComponentMask mask) {
+  Record old = records[e.index];
+  uint32_t to_index = archetypeOf(mask);
+  place(to_index, e.index);
+  Archetype& from = *archetypes[old.archetype];
+  Archetype& to = *archetypes[to_index];
+  const Record& now = records[e.index];
+  Chunk& from_chunk = from.chunks[old.chunk];
+  Chunk& to_chunk = to.chunks[now.chunk];
+  forEachType(from.mask & mask, [&](size_t id) {
+    size_t size = component_sizes[id];
+    memcpy(to_chunk.data->bytes + to.offsets[id] + now.row * size,
+           from_chunk.data->bytes + from.offsets[id] + old.row * size, size);
+  });
+  unlink(old);
+}
+
+void* EntityWorld::component(Entity e, size_t id) {
+  if (!alive(e))
+    return nullptr;
+  const Record& record = records[e.index];
+  const Archetype& archetype = *archetypes[record.archetype];
+  if (!(archetype.mask & (ComponentMask{1} << id)))
+    return nullptr;
+  Chunk& chunk = archetypes[record.archetype]->chunks[record.chunk];
+  return chunk.data->bytes + archetype.offsets[id] + record.row * component_sizes[id];
+}
+
+vector<EntityWorld::ChunkRef> EntityWorld::matching(ComponentMask mask) {
+  vector<ChunkRef> chunks;
+  size_t first = 0;
+  for (auto& archetype : archetypes) {
+    if ((archetype->mask & mask) != mask)
+      continue;
+    for (auto& chunk : archetype->chunks) {
+      chunks.push_back(ChunkRef{archetype.get(), &chunk, first});
+      first += chunk.count;
+    }
+  }
+  return chunks;
+}
+
+size_t EntityWorld::count(ComponentMask mask) const {
+  size_t n = 0;
+  for (auto& archetype : archetypes)
+    if ((archetype->mask & mask) == mask)
+      for (auto& chunk : archetype->chunks)
+        n += chunk.count;
+  return n;
+}
+
+void SystemScheduler::add(const char* name, ComponentMask reads, ComponentMask writes, System fn) {
+  size_t wave = 0;
+  for (auto& other : systems) {
+    bool conflict = (writes & (other.reads | other.writes)) || (other.writes & reads);
+    if (conflict)
+      wave = max(wave, other.wave + 1);
+  }
+  systems.push_back(Entry{name, reads, writes, std::move(fn), wave});
+  wave_count = max(wave_count, wave + 1);
+}
+
+void SystemScheduler::run(JobSystem& jobs, EntityWorld& world) {
+  VGL_PROFILE_ZONE("SystemScheduler::run");
+  for (size_t wave = 0; wave < wave_count; wave++) {
+    JobCounter counter;
+    for (auto& entry : systems) {
+      if (entry.wave != wave)
+        continue;
+      Entry* system = &entry;
+      jobs.run(counter, [system, &jobs, &world] {
+        VGL_PROFILE_ZONE(system->name);
+        system->fn(jobs, world);
+      });
+    }
+    jobs.wait(counter);
+  }
+}
@@ -0,0 +1,243 @@
+// Entity-component storage by archetype, and a scheduler for the systems
+// that work on it.
+//
+// An entity is a handle; what it has is components, plain structs of any
+// trivially copyable type. The entities with the same set of component types
+// make up an archetype, which keeps them in chunks of chunk_bytes with a
+// column per type, so that a query that wants two of an entity's ten
+// components only goes through the memory of those two. Adding a component
+// to an entity, or removing one, moves it to the archetype of its new set.
+//
+//   EntityWorld world;
+//   Entity e = world.create(Position{...}, Velocity{...});
+//   world.each<Position, const Velocity>([&](size_t first, size_t count, Position* p, const Velocity* v) {
+//     for (size_t i = 0; i < count; i++) ...
+//   });
+//
+// A query visits the archetypes that have all of its types, in the order
+// they were made, and their chunks in order; `first` is how many entities
+// came before the chunk. Creating or destroying entities and adding or
+// removing components moves others around, so neither that order nor the
+// column pointers outlast them.
+//
+// A system declares the components it reads and writes. SystemScheduler
+// runs the systems that do not conflict, where neither writes what the other
+// reads or writes, at the same time, and the others in the order they were added.
+
+#ifndef ECS_H
+#define ECS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs.h"
+
+using ComponentMask = uint64_t;
+constexpr size_t max_component_types = 64;
+// Small enough that a chunk's columns stay in L1 while a system goes through them
+constexpr size_t chunk_bytes = 16 * 1024;
+
+// The id of a new component type, in the order of first use.
+// Throws length_error past max_component_types.
+size_t vglRegisterComponent(size_t size, size_t alignment);
+
+template <class T>
+size_t componentId() {
+  static_assert(std::is_trivially_copyable<T>::value, "components are moved around with memcpy");
+  static const size_t id = vglRegisterComponent(sizeof(T), alignof(T));
+  return id;
+}
+
+// The types as a mask, const or not. Reads and writes of systems are given this way.
+template <class... Ts>
+ComponentMask componentMask() {
+  return (ComponentMask{0} | ... | (ComponentMask{1} << componentId<std::remove_const_t<Ts>>()));
+}
+
+struct Entity {
+  uint32_t index = UINT32_MAX;
+  // Goes up every time the index is reused, so that handles to a destroyed entity stay dead
+  uint32_t generation = 0;
+};
+
+class EntityWorld {
+public:
+  EntityWorld() = default;
+  EntityWorld(const EntityWorld&) = delete;
+  EntityWorld& operator=(const EntityWorld&) = delete;
+
+  // An entity with one component of each type. No type may come twice.
+  template <class... Ts>
+  Entity create(const Ts&... components);
+  // Nothing if the entity is not alive
+  void destroy(Entity e);
+  bool alive(Entity e) const;
+  // Live entities
+  size_t size() const { return live; }
+
+  // The entity's component, null if it is not alive or has none of that type
+  template <class T>
+  T* get(Entity e);
+  // Sets the component, moving the entity to another archetype if it had
+  // none of that type. Nothing if the entity is not alive.
+  template <class T>
+  void add(Entity e, const T& component);
+  template <class T>
+  void remove(Entity e);
+
+  // fn(first, count, columns...) for every chunk of the entities that have all of Ts
+  template <class... Ts, class F>
+  void each(F&& fn);
+  // The same with the chunks spread over the job system, at least
+  // `min_chunks` to a job. fn must not create, destroy, add or remove.
+  template <class... Ts, class F>
+  void parallelEach(JobSystem& jobs, F&& fn, size_t min_chunks = 1);
+  // Entities that have all of the mask's types
+  size_t count(ComponentMask mask) const;
+
+private:
+  struct alignas(64) ChunkData {
+    unsigned char bytes[chunk_bytes];
+  };
+  struct Chunk {
+    std::unique_ptr<ChunkData> data{new ChunkData};
+    size_t count = 0;
+  };
+  struct Archetype {
+    ComponentMask mask = 0;
+    // Entities a chunk has room for
+    size_t capacity = 0;
+    // Where each type's column starts in a chunk; the handles come first, at 0
+    size_t offsets[max_component_types] = {};
+    std::vector<Chunk> chunks;
+  };
+  // Where an entity is, by its index
+  struct Record {
+    uint32_t archetype = 0, chunk = 0, row = 0;
+    uint32_t generation = 0;
+    bool alive = false;
+  };
+  struct ChunkRef {
+    Archetype* archetype;
+    Chunk* chunk;
+    size_t first;
+  };
+
+  static Entity* handles(Chunk& chunk) { return reinterpret_cast<Entity*>(chunk.data->bytes); }
+  template <class T>
+  static T* column(const Archetype& archetype, Chunk& chunk) {
+    return reinterpret_cast<T*>(chunk.data->bytes + archetype.offsets[componentId<std::remove_const_t<T>>()]);
+  }
+
+  uint32_t archetypeOf(ComponentMask mask);
+  // A fresh entity in the archetype of `mask`, its components unset
+  Entity allocate(ComponentMask mask);
+  // A row at the end of the archetype for entity `index`, recorded as alive there
+  void place(uint32_t archetype, uint32_t index);
+  // Take the entity's row out of its archetype, moving the last one into it
+  void unlink(const Record& record);
+  // Move a live entity to the archetype of `mask`, keeping the components both have
+  void migrate(Entity e, ComponentMask mask);
+  // Null if dead or missing
+  void* component(Entity e, size_t id);
+  std::vector<ChunkRef> matching(ComponentMask mask);
+
+  std::vector<std::unique_ptr<Archetype>> archetypes;
+  std::unordered_map<ComponentMask, uint32_t> archetype_index;
+  std::vector<Record> records;
+  std::vector<uint32_t> free_indices;
+  size_t live = 0;
+};
+
+class SystemScheduler {
+public:
+  using System = std::function<void(JobSystem&, EntityWorld&)>;
+
+  // `name` must outlive the scheduler, a string literal say. The system may
+  // use the job system itself, parallelEach say.
+  void add(const char* name, ComponentMask reads, ComponentMask writes, System fn);
+  // Runs every system once: in waves, each system in the wave after the last
+  // one that has a system added before it that it conflicts with
+  void run(JobSystem& jobs, EntityWorld& world);
+
+  size_t size() const { return systems.size(); }
+  size_t waves() const { return wave_count; }
+
+private:
+  struct Entry {
+    const char* name;
+    ComponentMask reads, writes;
+    System fn;
+    size_t wave;
+  };
+  std::vector<Entry> systems;
+  size_t wave_count = 0;
+};
+
+template <class... Ts>
+Entity EntityWorld::create(const Ts&... components) {
+  Entity e = allocate(componentMask<Ts...>());
+  (std::memcpy(component(e, componentId<Ts>()), &components, sizeof(Ts)), ...);
+  return e;
+}
+
+template <class T>
+T* EntityWorld::get(Entity e) {
+  return static_cast<T*>(component(e, componentId<T>()));
+}
+
+template <class T>
+void EntityWorld::add(Entity e, const T& value) {
+  if (!alive(e))
+    return;
+  ComponentMask bit = ComponentMask{1} << componentId<T>();
+  const Record& record = records[e.index];
+  if (!(archetypes[record.archetype]->mask & bit))
+    migrate(e, archetypes[record.archetype]->mask | bit);
+  *get<T>(e) = value;
+}
+
+template <class T>
+void EntityWorld::remove(Entity e) {
+  if (!alive(e))
+    return;
+  ComponentMask bit = ComponentMask{1} << componentId<T>();
+  const Record& record = records[e.index];
+  if (archetypes[record.archetype]->mask & bit)
+    migrate(e, archetypes[record.archetype]->mask & ~bit);
+}
+
+template <class... Ts, class F>
+void EntityWorld::each(F&& fn) {
+  static_assert(sizeof...(Ts) > 0, "a query needs at least one component type");
+  ComponentMask mask = componentMask<Ts...>();
+  size_t first = 0;
+  for (auto& archetype : archetypes) {
+    if ((archetype->mask & mask) != mask)
+      continue;
+    for (auto& chunk : archetype->chunks) {
+      fn(first, chunk.count, column<Ts>(*archetype, chunk)...);
+      first += chunk.count;
+    }
+  }
+}
+
+template <class... Ts, class F>
+void EntityWorld::parallelEach(JobSystem& jobs, F&& fn, size_t min_chunks) {
+  static_assert(sizeof...(Ts) > 0, "a query needs at least one component type");
+  std::vector<ChunkRef> chunks = matching(componentMask<Ts...>());
+  jobs.parallelFor(0, chunks.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      auto& ref = chunks[i];
+      fn(ref.first, ref.chunk->count, column<Ts>(*ref.archetype, *ref.chunk)...);
+    }
+  }, min_chunks);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "frame_arena.h"
+
+using namespace std;
+
+LinearArena::LinearArena(size_t block_size) : block_size(block_size) {}
+
+void* LinearArena::allocate(size_t size, size_t align) {
+  for (;;) {
+    if (current < blocks.size()) {
+      auto& block = blocks[current];
+      uintptr_t begin = (uintptr_t)block.data.get();
+      uintptr_t at = (begin + offset + align - 1) & ~(uintptr_t)(align - 1);
+      if (at + size <= begin + block.size) {
+        used_bytes += at + size - (begin + offset);
+        offset = at + size - begin;
+        return (void*)at;
+      }
+      if (current + 1 < blocks.size()) {
+        current++;
+        offset = 0;
+        continue;
+      }
+    }
+    // Out of room: at least double the capacity so that a growing frame needs few blocks
+    size_t size_needed = max({block_size, size + align, capacity()});
+    blocks.push_back(Block{make_unique<unsigned char[]>(size_needed), size_needed});
+    current = blocks.size() - 1;
+    offset = 0;
+  }
+}
+
+void LinearArena::reset() {
+#ifndef NDEBUG
+  if (live != 0)
+    frameArenaFailure("frame allocation outlived its frame");
+  // Whoever still holds a pointer into the frame gets garbage rather than stale data that looks right
+  for (size_t i = 0; i <= current && i < blocks.size(); i++)
+    memset(blocks[i].data.get(), 0xdd, i == current ? offset : blocks[i].size);
+#endif
+  if (blocks.size() > 1) {
+    size_t total = capacity();
+    blocks.clear();
+    blocks.push_back(Block{make_unique<unsigned char[]>(total), total});
+  }
+  current = 0;
+  offset = 0;
+  used_bytes = 0;
+  gen++;
+}
+
+size_t LinearArena::capacity() const {
+  size_t total = 0;
+  for (auto& block : blocks)
+    total += block.size;
+  return total;
+}
+
+FrameArena::FrameArena(unsigned frames_in_flight, size_t block_size)
+  : slots(max(1u, frames_in_flight)), block_size(block_size) {}
+
+void FrameArena::beginFrame() {
+  peak = max(peak, frameBytes());
+  slot = (slot + 1) % slots.size();
+  for (auto& arena : slots[slot])
+    arena->reset();
+}
+
+LinearArena& FrameArena::local(size_t index) {
+  auto& arenas = slots[slot];
+  while (arenas.size() <= index)
+    arenas.push_back(make_unique<LinearArena>(block_size));
+  return *arenas[index];
+}
+
+size_t FrameArena::frameBytes() const {
+  size_t total = 0;
+  for (auto& arena : slots[slot])
+    total += arena->used();
+  return total;
+}
+
+size_t FrameArena::peakBytes() const {
+  return max(peak, frameBytes());
+}
+
+void frameArenaFailure(const char* message) {
+  // Straight to stderr, the log is asynchronous and we are about to abort
+  cerr << "FrameArena: " << message << '\n';
+  abort();
+}
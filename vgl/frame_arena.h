@@ -0,0 +1,151 @@
+// Per-frame linear allocation for transient render data.
+//
+// Draw lists, command buffers and other scratch data only live for one frame.
+// Instead of going through malloc they bump a pointer in a LinearArena, and
+// the whole arena is released at once when its frame slot comes around again.
+// FrameArena keeps one slot per frame in flight, so data the previous frames
+// may still be using is not overwritten, and one LinearArena per thread in
+// each slot, so workers never contend.
+//
+// Debug builds (no NDEBUG) poison released memory and abort if an allocation
+// made through FrameAllocator is still alive when its slot is reused.
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+class LinearArena {
+public:
+  explicit LinearArena(size_t block_size = 64 << 10);
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  // Only for the thread the arena was handed to
+  void* allocate(size_t size, size_t align);
+  // Releases everything. If the last frame needed several blocks they are
+  // merged into one, so that a steady load ends up never allocating.
+  void reset();
+
+  // Bytes handed out since the last reset, alignment padding included
+  size_t used() const { return used_bytes; }
+  size_t capacity() const;
+  // Bumped by every reset
+  uint64_t generation() const { return gen; }
+
+#ifndef NDEBUG
+  // Allocations made through FrameAllocator and not deallocated yet
+  std::atomic<int64_t> live{0};
+#endif
+
+private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  size_t current = 0;
+  size_t offset = 0;
+  size_t used_bytes = 0;
+  size_t block_size;
+  uint64_t gen = 0;
+};
+
+class FrameArena {
+public:
+  // One slot per frame in flight, see PacingConfig::max_frames_in_flight
+  explicit FrameArena(unsigned frames_in_flight = 2, size_t block_size = 64 << 10);
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // Moves to the next slot and releases what was allocated in it frames_in_flight
+  // frames ago. Call it after FramePacer::beginFrame, which has waited for that frame.
+  void beginFrame();
+
+  // The current slot's arena for worker `index`, 0 being the thread that owns
+  // the FrameArena. Call it on the owning thread and hand the result to the worker.
+  LinearArena& local(size_t index = 0);
+
+  // Bytes allocated so far in the current frame, over all threads
+  size_t frameBytes() const;
+  // The most any frame has allocated
+  size_t peakBytes() const;
+
+private:
+  std::vector<std::vector<std::unique_ptr<LinearArena>>> slots;
+  size_t slot = 0;
+  size_t block_size;
+  size_t peak = 0;
+};
+
+// Aborts with `message`, used when frame memory is misused
+[[noreturn]] void frameArenaFailure(const char* message);
+
+// Lets standard containers allocate from a LinearArena, FrameVector below.
+// Deallocation is a no-op, the memory comes back when the arena is reset.
+// Without an arena it falls back on operator new, so that containers can be
+// default constructed and moved into place later.
+template <class T>
+class FrameAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  FrameAllocator() = default;
+  explicit FrameAllocator(LinearArena& arena) : arena(&arena), generation(arena.generation()) {}
+  template <class U>
+  FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena), generation(other.generation) {}
+
+  T* allocate(size_t n) {
+    if (n > SIZE_MAX / sizeof(T))
+      throw std::bad_array_new_length{};
+    if (!arena)
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+#ifndef NDEBUG
+    if (arena->generation() != generation)
+      frameArenaFailure("FrameAllocator used after its frame ended");
+    arena->live++;
+#endif
+    return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept {
+    if (!arena) {
+      ::operator delete(p);
+      return;
+    }
+#ifndef NDEBUG
+    if (arena->generation() != generation)
+      frameArenaFailure("frame allocation outlived its frame");
+    arena->live--;
+#endif
+  }
+
+  template <class U>
+  bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+  template <class U>
+  bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+  template <class U>
+  friend class FrameAllocator;
+
+  LinearArena* arena = nullptr;
+  uint64_t generation = 0;
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -0,0 +1,26 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "frame_stats.h"
+
+using namespace std;
+
+Percentiles percentiles(vector<double> samples) {
+  Percentiles p;
+  if (samples.empty())
+    return p;
+
+  sort(samples.begin(), samples.end());
+  auto rank = [&](double q) {
+    size_t i = (size_t)ceil(q * samples.size());
+    return samples[i == 0 ? 0 : i - 1];
+  };
+  p.p50 = rank(0.50);
+  p.p95 = rank(0.95);
+  p.p99 = rank(0.99);
+  p.max = samples.back();
+  p.mean = accumulate(samples.begin(), samples.end(), 0.) / samples.size();
+  return p;
+}
@@ -0,0 +1,73 @@
+// Per-frame timing and counters, collected by the render loop and reported by the benchmark
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct FrameStats {
+  // CPU time spent in each stage of the frame, in milliseconds
+  double input_ms = 0;
+  // Stepping the rigid bodies, when the things are simulated
+  double physics_ms = 0;
+  double update_ms = 0;
+  double cull_ms = 0;
+  double sort_ms = 0;
+  double record_ms = 0;
+  double submit_ms = 0;
+  double swap_ms = 0;
+  // Waiting for the GPU and for the frame limiter, see FramePacer
+  double pace_ms = 0;
+  double frame_ms = 0;
+
+  // From the input that went into the frame to the swap returning.
+  // Negative when there was no new input.
+  double latency_ms = -1;
+
+  // What the GPU took for the frame's commands, see GpuTimer. Negative when
+  // it was not measured.
+  double gpu_ms = -1;
+  // Of the window's width and height the scene was drawn at, see DynamicResolution
+  float resolution_scale = 1;
+  // Samples of opaque things that passed the depth test per pixel of the
+  // scene. 1 if nothing was ever drawn over. Negative when not measured.
+  double opaque_overdraw = -1;
+  // Samples that passed in each pass of the scene, see PassQueries
+  double background_samples = -1, opaque_samples = -1, transparent_samples = -1, present_samples = -1;
+  // Fragments written to a pixel of the scene on average and at most, see OverdrawCounter
+  double overdraw_mean = -1, overdraw_max = -1;
+
+  uint64_t draw_calls = 0;
+  uint64_t gl_calls = 0;
+  uint64_t bytes_uploaded = 0;
+  // Taken from the FrameArena
+  uint64_t arena_bytes = 0;
+};
+
+// Measures consecutive stages of a frame: every lap() returns the
+// milliseconds since the previous lap (or since construction).
+class StageClock {
+public:
+  StageClock() : last(std::chrono::steady_clock::now()) {}
+
+  double lap() {
+    auto now = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - last).count();
+    last = now;
+    return ms;
+  }
+
+private:
+  std::chrono::steady_clock::time_point last;
+};
+
+struct Percentiles {
+  double p50 = 0, p95 = 0, p99 = 0, max = 0, mean = 0;
+};
+
+// Nearest-rank percentiles. Takes the samples by value because it has to sort them.
+Percentiles percentiles(std::vector<double> samples);
+
+#endif
@@ -0,0 +1,185 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "fullscreen_pass.h"
+#include "vgl.h"
+
+using namespace std;
+
+namespace {
+
+// Not a file, the name is the key of the programs built with it
+const char* const vertex_name = "vgl fullscreen";
+
+const char* const vertex_src = R"(#version 330 core
+out vec2 tex_coords;
+
+void main()
+{
+    // Texture coordinates (0, 0), (2, 0) and (0, 2): a triangle twice the
+    // size of the output, which is its lower left quarter
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    tex_coords = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* const bilinear_name = "vgl upscale bilinear";
+
+const char* const bilinear_src = R"(#version 330 core
+in vec2 tex_coords;
+out vec4 FragColor;
+
+uniform sampler2D source;
+
+void main()
+{
+    FragColor = texture(source, tex_coords);
+}
+)";
+
+const char* const edge_aware_name = "vgl upscale edge aware";
+
+const char* const edge_aware_src = R"(#version 330 core
+in vec2 tex_coords;
+out vec4 FragColor;
+
+uniform sampler2D source;
+// How quickly a luma difference counts as an edge
+uniform float sharpness = 4.0;
+
+void main()
+{
+    // The four texels around the pixel and where it sits between them
+    ivec2 last = textureSize(source, 0) - 1;
+    vec2 p = tex_coords * vec2(last + 1) - 0.5;
+    ivec2 i = ivec2(floor(p));
+    vec2 f = p - floor(p);
+    vec4 a = texelFetch(source, clamp(i, ivec2(0), last), 0);
+    vec4 b = texelFetch(source, clamp(i + ivec2(1, 0), ivec2(0), last), 0);
+    vec4 c = texelFetch(source, clamp(i + ivec2(0, 1), ivec2(0), last), 0);
+    vec4 d = texelFetch(source, clamp(i + ivec2(1, 1), ivec2(0), last), 0);
+
+    const vec3 luma = vec3(0.299, 0.587, 0.114);
+    float la = dot(a.rgb, luma), lb = dot(b.rgb, luma), lc = dot(c.rgb, luma), ld = dot(d.rgb, luma);
+    vec2 gradient = 0.5 * vec2(lb + ld - la - lc, lc + ld - la - lb);
+
+    // Across an edge the ramp between the texels steepens towards a step,
+    // along it and where there is none the weights stay bilinear
+    float edge = clamp(length(gradient) * sharpness, 0.0, 1.0);
+    vec2 across = abs(gradient) / max(length(gradient), 1e-6);
+    f = mix(f, smoothstep(0.25, 0.75, f), edge * across);
+    FragColor = mix(mix(a, b, f.x), mix(c, d, f.x), f.y);
+}
+)";
+
+ShaderHandle loadUpscaleShader(ResourceManager& resources, const char* name, const char* src) {
+  ShaderHandle handle = resources.loadShader(vertex_name, name, vertex_src, src);
+  GLuint program = resources.get(handle);
+  glUseProgram(program);
+  vglBindSampler(program, "source", 0);
+  return handle;
+}
+
+}
+
+bool vglParseUpscale(const char* name, Upscale& upscale) {
+  if (strcmp(name, "bilinear") == 0)
+    upscale = Upscale::Bilinear;
+  else if (strcmp(name, "edge") == 0)
+    upscale = Upscale::EdgeAware;
+  else
+    return false;
+  return true;
+}
+
+const char* vglUpscaleName(Upscale upscale) {
+  return upscale == Upscale::EdgeAware ? "edge" : "bilinear";
+}
+
+Upscaler::Upscaler(ResourceManager& resources) : resources(resources) {
+  bilinear_shader = loadUpscaleShader(resources, bilinear_name, bilinear_src);
+  edge_aware_shader = loadUpscaleShader(resources, edge_aware_name, edge_aware_src);
+  empty_vao = resources.createVertexArray("fullscreen VAO");
+}
+
+Upscaler::~Upscaler() {
+  resources.release(bilinear_shader);
+  resources.release(edge_aware_shader);
+  resources.release(empty_vao);
+}
+
+void Upscaler::record(CommandBuffer& commands, GLuint texture, GLuint output, int width, int height, Upscale upscale) const {
+  commands.disable(GL_DEPTH_TEST);
+  commands.bindFramebuffer(GL_FRAMEBUFFER, output);
+  commands.viewport(0, 0, width, height);
+  commands.bindVertexArray(resources.get(empty_vao));
+  commands.useProgram(resources.get(upscale == Upscale::EdgeAware ? edge_aware_shader : bilinear_shader));
+  commands.bindTexture(0, GL_TEXTURE_2D, texture);
+  commands.drawArrays(GL_TRIANGLES, 0, 3);
+}
+
+FullscreenPass::FullscreenPass(ResourceManager& resources, const char* fragment_file_name, const string& fragment_src,
+                               float scale, Upscale upscale)
+  : resources(resources), upscaler(resources), target(resources, string{fragment_file_name} + " target", false),
+    filter(upscale) {
+  shader = resources.loadShader(vertex_name, fragment_file_name, vertex_src, fragment_src);
+  output_size_loc = glGetUniformLocation(resources.get(shader), "output_size");
+  // Core profile draws need one bound, even with no attributes
+  empty_vao = resources.createVertexArray("fullscreen VAO");
+  setScale(scale);
+}
+
+FullscreenPass::~FullscreenPass() {
+  resources.release(shader);
+  resources.release(empty_vao);
+}
+
+void FullscreenPass::setOutput(GLuint framebuffer, int width, int height) {
+  if (framebuffer == output && width == output_width && height == output_height)
+    return;
+  output = framebuffer;
+  output_width = width;
+  output_height = height;
+  updateTarget();
+}
+
+void FullscreenPass::setScale(float scale) {
+  scale = clamp(scale, 1.f / 16, 1.f);
+  if (scale == shading_scale)
+    return;
+  shading_scale = scale;
+  updateTarget();
+}
+
+void FullscreenPass::updateTarget() {
+  if (shading_scale < 1 && output_width > 0 && output_height > 0) {
+    shaded_width = max(1, (int)lround(output_width * shading_scale));
+    shaded_height = max(1, (int)lround(output_height * shading_scale));
+    target.resize(shaded_width, shaded_height);
+  } else {
+    shaded_width = output_width;
+    shaded_height = output_height;
+    target.release();
+  }
+}
+
+void FullscreenPass::begin(CommandBuffer& commands) const {
+  commands.disable(GL_DEPTH_TEST);
+  commands.bindFramebuffer(GL_FRAMEBUFFER, target ? target.framebuffer() : output);
+  commands.viewport(0, 0, shaded_width, shaded_height);
+  commands.bindVertexArray(resources.get(empty_vao));
+  commands.useProgram(resources.get(shader));
+  if (output_size_loc >= 0)
+    commands.uniform2f(output_size_loc, output_width, output_height);
+}
+
+void FullscreenPass::end(CommandBuffer& commands) const {
+  commands.drawArrays(GL_TRIANGLES, 0, 3);
+  if (target)
+    upscaler.record(commands, target.texture(), output, output_width, output_height, filter);
+}
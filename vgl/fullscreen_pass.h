@@ -0,0 +1,117 @@
+// Full-screen passes: a fragment shader run once for every pixel.
+//
+// There is no vertex buffer. The vertex shader makes one triangle out of
+// gl_VertexID that is big enough to cover the whole output, so every pixel is
+// shaded exactly once; a quad of two triangles would shade the pixels along
+// its diagonal twice. The fragment shader gets `in vec2 tex_coords`, 0 to 1
+// across the output, and can declare `uniform vec2 output_size` to get the
+// size of the output in pixels.
+//
+// A pass can shade into its own render target at a fraction of the output
+// resolution and have that scaled up into the output. Smooth but expensive
+// layers (backgrounds, fog) hardly change at half the width and height, and
+// that shades a quarter of the pixels.
+
+#ifndef FULLSCREEN_PASS_H
+#define FULLSCREEN_PASS_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+#include "command_buffer.h"
+#include "render_target.h"
+#include "resources.h"
+
+enum class Upscale {
+  // The GPU's linear filtering
+  Bilinear,
+  // Bilinear along edges in the low resolution image and steeper across
+  // them, so that they stay sharp. Only a few more instructions.
+  EdgeAware,
+};
+
+// "bilinear" or "edge"
+bool vglParseUpscale(const char* name, Upscale& upscale);
+const char* vglUpscaleName(Upscale upscale);
+
+// Draws a texture over the whole of an output, filtered by Upscale
+class Upscaler {
+public:
+  // Builds the filters' programs. Context thread.
+  explicit Upscaler(ResourceManager& resources);
+  ~Upscaler();
+
+  Upscaler(const Upscaler&) = delete;
+  Upscaler& operator=(const Upscaler&) = delete;
+
+  // Draws `texture` into `output` (0 for the window), `width` by `height`
+  // pixels. Leaves depth testing off, texture unit 0 active and the output
+  // bound, its size as the viewport.
+  void record(CommandBuffer& commands, GLuint texture, GLuint output, int width, int height, Upscale upscale) const;
+
+private:
+  ResourceManager& resources;
+  ShaderHandle bilinear_shader, edge_aware_shader;
+  VertexArrayHandle empty_vao;
+};
+
+class FullscreenPass {
+public:
+  // Builds `fragment_src` with the full-screen vertex shader. The file name is
+  // only the key the program is shared by, see ResourceManager::loadShader.
+  // Throws like vglBuildShader. Everything but begin() and end() is for the
+  // context thread.
+  FullscreenPass(ResourceManager& resources, const char* fragment_file_name, const std::string& fragment_src,
+                 float scale = 1, Upscale upscale = Upscale::Bilinear);
+  // Releases the GL objects, the ResourceManager deletes them once the GPU is done
+  ~FullscreenPass();
+
+  FullscreenPass(const FullscreenPass&) = delete;
+  FullscreenPass& operator=(const FullscreenPass&) = delete;
+
+  // For looking up the fragment shader's uniforms
+  GLuint program() const { return resources.get(shader); }
+
+  // Where the pass ends up: `framebuffer` (0 for the window), `width` by
+  // `height` pixels. Nothing is drawn before this is called. Cheap when nothing changed.
+  void setOutput(GLuint framebuffer, int width, int height);
+  // Shade at `scale` times the output width and height, scaled up afterwards.
+  // At 1 the pass shades straight into the output. Clamped to [1/16, 1].
+  void setScale(float scale);
+  float scale() const { return shading_scale; }
+  void setUpscale(Upscale upscale) { filter = upscale; }
+  Upscale upscale() const { return filter; }
+  // What the fragment shader runs at, in pixels
+  int shadedWidth() const { return shaded_width; }
+  int shadedHeight() const { return shaded_height; }
+
+  // Recording, from any thread: begin() binds the pass's target and leaves
+  // its program in use for the caller's uniforms, end() draws and scales the
+  // result up into the output if it was shaded smaller. Both leave depth
+  // testing off, the pass's empty vertex array bound and the output's size as
+  // the viewport.
+  void begin(CommandBuffer& commands) const;
+  void end(CommandBuffer& commands) const;
+
+private:
+  // Makes the render target match the output size and scale
+  void updateTarget();
+
+  ResourceManager& resources;
+  ShaderHandle shader;
+  VertexArrayHandle empty_vao;
+  GLint output_size_loc = -1;
+  Upscaler upscaler;
+
+  // Only allocated while shading below the output resolution
+  RenderTarget target;
+
+  GLuint output = 0;
+  int output_width = 0, output_height = 0;
+  int shaded_width = 0, shaded_height = 0;
+  float shading_scale = 0;
+  Upscale filter;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifdef VGL_GL_DEBUG
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+
+#include "gl_debug.h"
+#include "log.h"
+#include "vgl.h"
+
+// KHR_debug, core in GL 4.3. The GL 3.3 glad has none of it, so the tokens
+// are here and the entry points are looked up by vglDebugInit.
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#endif
+#ifndef GL_CONTEXT_LOST
+#define GL_CONTEXT_LOST 0x0507
+#endif
+
+namespace {
+
+using DebugProc = void (APIENTRY*)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                   const GLchar* message, const void* user);
+using DebugMessageCallbackProc = void (APIENTRY*)(DebugProc callback, const void* user);
+using DebugMessageControlProc = void (APIENTRY*)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                 const GLuint* ids, GLboolean enable);
+using ObjectLabelProc = void (APIENTRY*)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+using PushDebugGroupProc = void (APIENTRY*)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+using PopDebugGroupProc = void (APIENTRY*)();
+
+DebugMessageCallbackProc debug_message_callback = nullptr;
+DebugMessageControlProc debug_message_control = nullptr;
+ObjectLabelProc object_label = nullptr;
+PushDebugGroupProc push_debug_group = nullptr;
+PopDebugGroupProc pop_debug_group = nullptr;
+
+// Set once all of the above are loaded
+bool enabled = false;
+
+template <class Proc>
+bool load(Proc& proc, const char* name) {
+  proc = reinterpret_cast<Proc>(glfwGetProcAddress(name));
+  return proc != nullptr;
+}
+
+const char* sourceName(GLenum source) {
+  switch (source) {
+  case GL_DEBUG_SOURCE_API: return "api";
+  case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+  case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+  case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+  case GL_DEBUG_SOURCE_APPLICATION: return "application";
+  default: return "other";
+  }
+}
+
+const char* typeName(GLenum type) {
+  switch (type) {
+  case GL_DEBUG_TYPE_ERROR: return "error";
+  case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+  case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+  case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+  case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+  case GL_DEBUG_TYPE_MARKER: return "marker";
+  default: return "other";
+  }
+}
+
+// May be called from a driver thread, which the logger is fine with
+void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                            GLsizei length, const GLchar* message, const void* user) {
+  switch (severity) {
+  case GL_DEBUG_SEVERITY_HIGH:
+    VGL_LOG(ERROR, GL, "%s %s %u: %s", sourceName(source), typeName(type), id, message);
+    break;
+  case GL_DEBUG_SEVERITY_MEDIUM:
+    VGL_LOG(WARN, GL, "%s %s %u: %s", sourceName(source), typeName(type), id, message);
+    break;
+  case GL_DEBUG_SEVERITY_LOW:
+    VGL_LOG(INFO, GL, "%s %s %u: %s", sourceName(source), typeName(type), id, message);
+    break;
+  default:
+    VGL_LOG(DEBUG, GL, "%s %s %u: %s", sourceName(source), typeName(type), id, message);
+  }
+}
+
+#if defined(VGL_GL_VALIDATE) && defined(GLAD_DEBUG)
+// glad's debug generator calls this after every GL function
+void validateCall(const char* name, void* funcptr, int len_args, ...) {
+  // glGetError itself goes through here too
+  if (!strcmp(name, "glGetError"))
+    return;
+  // Bounded like vglCheckError: a lost context never stops reporting
+  GLenum error;
+  for (int asked = 0; asked < 16 && (error = glad_glGetError()) != GL_NO_ERROR; asked++) {
+    VGL_LOG(ERROR, GL, "%s: error 0x%x", name, error);
+    if (error == GL_CONTEXT_LOST)
+      break;
+  }
+}
+#endif
+
+}
+
+void vglDebugHints() {
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+}
+
+bool vglDebugInit() {
+  bool core = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3);
+  if (!core && !glfwExtensionSupported("GL_KHR_debug")) {
+    VGL_LOG(WARN, GL, "no KHR_debug, falling back to vglCheckError");
+    return false;
+  }
+  if (!load(debug_message_callback, "glDebugMessageCallback") || !load(debug_message_control, "glDebugMessageControl") ||
+      !load(object_label, "glObjectLabel") || !load(push_debug_group, "glPushDebugGroup") ||
+      !load(pop_debug_group, "glPopDebugGroup")) {
+    VGL_LOG(WARN, GL, "KHR_debug functions missing, falling back to vglCheckError");
+    return false;
+  }
+
+  glEnable(GL_DEBUG_OUTPUT);
+#ifdef VGL_GL_VALIDATE
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#ifdef GLAD_DEBUG
+  glad_set_post_callback(validateCall);
+#else
+  VGL_LOG(WARN, GL, "glad was not generated with the debug generator, not checking every call");
+#endif
+#endif
+  debug_message_callback(debugCallback, nullptr);
+  // Our own groups would echo back as notifications on every push and pop
+  debug_message_control(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+  debug_message_control(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+  enabled = true;
+  return true;
+}
+
+void vglObjectLabel(GLenum identifier, GLuint name, const char* label) {
+  if (enabled)
+    object_label(identifier, name, -1, label);
+}
+
+GlDebugGroup::GlDebugGroup(const char* name) {
+  if (enabled)
+    push_debug_group(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+GlDebugGroup::~GlDebugGroup() {
+  if (enabled)
+    pop_debug_group();
+}
+
+#endif
@@ -0,0 +1,65 @@
+// GL debug layer built on KHR_debug.
+//
+// Compiled in with VGL_GL_DEBUG (make GL_DEBUG=1). The driver then reports
+// errors and warnings through a callback instead of us polling glGetError,
+// objects carry readable labels and passes show up as named groups in
+// RenderDoc/apitrace. Without VGL_GL_DEBUG everything here expands to nothing.
+//
+// VGL_GL_VALIDATE (make GL_DEBUG=validate) additionally makes the callback
+// synchronous, so it fires inside the offending call, and checks glGetError
+// after every single GL call when glad was generated with its debug generator.
+// Very slow, only for tracking bugs down.
+
+#ifndef GL_DEBUG_H
+#define GL_DEBUG_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if defined(VGL_GL_VALIDATE) && !defined(VGL_GL_DEBUG)
+#define VGL_GL_DEBUG
+#endif
+
+#ifdef VGL_GL_DEBUG
+
+// The KHR_debug object identifiers that VGL_GL_LABEL takes, which the GL 3.3 glad leaves out
+#ifndef GL_BUFFER
+#define GL_BUFFER 0x82E0
+#define GL_SHADER 0x82E1
+#define GL_PROGRAM 0x82E2
+#define GL_QUERY 0x82E3
+#endif
+
+// Before glfwCreateWindow: ask for a debug context
+void vglDebugHints();
+// After glad is loaded: install the callback. Returns false without GL 4.3 or KHR_debug.
+bool vglDebugInit();
+void vglObjectLabel(GLenum identifier, GLuint name, const char* label);
+
+// Names the GL commands issued in the scope
+class GlDebugGroup {
+public:
+  explicit GlDebugGroup(const char* name);
+  ~GlDebugGroup();
+
+  GlDebugGroup(const GlDebugGroup&) = delete;
+  GlDebugGroup& operator=(const GlDebugGroup&) = delete;
+};
+
+#define VGL_GL_CONCAT_(a, b) a##b
+#define VGL_GL_CONCAT(a, b) VGL_GL_CONCAT_(a, b)
+#define VGL_GL_DEBUG_HINTS() vglDebugHints()
+#define VGL_GL_DEBUG_INIT() vglDebugInit()
+#define VGL_GL_LABEL(identifier, name, label) vglObjectLabel(identifier, name, label)
+#define VGL_GL_GROUP(name) GlDebugGroup VGL_GL_CONCAT(vgl_gl_group_, __LINE__){name}
+
+#else
+
+#define VGL_GL_DEBUG_HINTS() do {} while (0)
+#define VGL_GL_DEBUG_INIT() do {} while (0)
+#define VGL_GL_LABEL(identifier, name, label) do {} while (0)
+#define VGL_GL_GROUP(name) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#include <glad/glad.h>
+
+#include "gpu_timer.h"
+
+using namespace std;
+
+GpuQueryRing::GpuQueryRing(GLenum target, int slots)
+  : queries(slots), slot_frame(slots), pending(slots) {
+  glGenQueries(slots, queries.data());
+}
+
+GpuQueryRing::~GpuQueryRing() {
+  glDeleteQueries(queries.size(), queries.data());
+}
+
+GLuint GpuQueryRing::next() {
+  size_t slot = frames % queries.size();
+  // Still running after going round the whole ring: give up on it rather than wait
+  if (pending[slot] && !collect(slot)) {
+    pending[slot] = false;
+    lost++;
+  }
+  slot_frame[slot] = frames;
+  return queries[slot];
+}
+
+void GpuQueryRing::submitted() {
+  pending[frames % queries.size()] = true;
+  frames++;
+}
+
+bool GpuQueryRing::poll(uint64_t& frame, GLuint64& value) {
+  // Oldest first: the GPU finishes them in order, so stop at the first that is not done
+  uint64_t first = frames > queries.size() ? frames - queries.size() : 0;
+  for (uint64_t f = first; f < frames; f++) {
+    size_t slot = f % queries.size();
+    if (pending[slot] && !collect(slot))
+      break;
+  }
+  if (!have_result)
+    return false;
+  frame = result_frame;
+  value = result;
+  have_result = false;
+  return true;
+}
+
+bool GpuQueryRing::collect(size_t slot) {
+  GLint available = 0;
+  glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return false;
+  GLuint64 value = 0;
+  glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &value);
+  pending[slot] = false;
+  if (!have_result || slot_frame[slot] > result_frame) {
+    result_frame = slot_frame[slot];
+    result = value;
+    have_result = true;
+  }
+  return true;
+}
+
+void GpuTimer::end() {
+  glEndQuery(GL_TIME_ELAPSED);
+  ring.submitted();
+}
+
+bool GpuTimer::poll(uint64_t& frame, double& ms) {
+  GLuint64 ns;
+  if (!ring.poll(frame, ns))
+    return false;
+  ms = ns * 1e-6;
+  return true;
+}
@@ -0,0 +1,75 @@
+// GPU time of a frame's GL commands, always on, unlike the profiler's GPU zones.
+// And the ring of queries underneath, for counting other things per frame.
+//
+// Each frame gets a query from a small ring. The result is only read once the
+// GPU says it is there, a few frames later, so the CPU never waits for it. A
+// query still pending when its slot comes round again is overwritten and its
+// frame goes unmeasured.
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+class GpuQueryRing {
+public:
+  // `slots` queries of `target` (GL_TIME_ELAPSED, GL_SAMPLES_PASSED...),
+  // enough for that many frames in flight. Everything here is for the
+  // context thread, the destructor included.
+  explicit GpuQueryRing(GLenum target, int slots = 6);
+  ~GpuQueryRing();
+
+  GpuQueryRing(const GpuQueryRing&) = delete;
+  GpuQueryRing& operator=(const GpuQueryRing&) = delete;
+
+  // The query for the next frame, to begin and end around its commands,
+  // straight away or recorded into a CommandBuffer. Frames are numbered by
+  // these calls, from 0. Call submitted() once it has been ended.
+  GLuint next();
+  void submitted();
+
+  // The newest result the GPU has finished since the last call, if any.
+  // `frame` is the number of the frame it belongs to.
+  bool poll(uint64_t& frame, GLuint64& value);
+
+  // Frames that went unmeasured so far
+  uint64_t dropped() const { return lost; }
+
+private:
+  // Reads the result of `slot` if the GPU has it
+  bool collect(size_t slot);
+
+  std::vector<GLuint> queries;
+  // Frame each slot's query measures, and whether it still has to be read
+  std::vector<uint64_t> slot_frame;
+  std::vector<bool> pending;
+  uint64_t frames = 0;
+
+  bool have_result = false;
+  uint64_t result_frame = 0;
+  GLuint64 result = 0;
+  uint64_t lost = 0;
+};
+
+class GpuTimer {
+public:
+  explicit GpuTimer(int slots = 6) : ring(GL_TIME_ELAPSED, slots) {}
+
+  // Around the commands to time, once per frame. Frames are numbered by the
+  // begin() calls, from 0. Only one GL_TIME_ELAPSED query can be active at a time.
+  void begin() { glBeginQuery(GL_TIME_ELAPSED, ring.next()); }
+  void end();
+
+  // The newest measurement since the last call, see GpuQueryRing::poll
+  bool poll(uint64_t& frame, double& ms);
+
+  uint64_t dropped() const { return ring.dropped(); }
+
+private:
+  GpuQueryRing ring;
+};
+
+#endif
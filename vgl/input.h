@@ -0,0 +1,133 @@
+// Event-driven input.
+//
+// The GLFW callbacks push events into a lock-free queue; the simulation
+// drains it once per step and keeps a set of the keys being held. Work per
+// step is proportional to the number of held keys, not to GLFW_KEY_LAST.
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "spsc_ring.h"
+
+// What a key does. Bindings are fixed at compile time, see key_bindings.
+enum class Action : uint8_t {
+  None,
+  Forward,
+  Back,
+  Left,
+  Right,
+  Up,
+  Down,
+  FovNarrower,
+  FovWider,
+  NearCloser,
+  NearFarther,
+};
+
+struct KeyBinding {
+  int key;
+  Action action;
+};
+
+constexpr KeyBinding key_bindings[] = {
+  {GLFW_KEY_W, Action::Forward},
+  {GLFW_KEY_UP, Action::Forward},
+  {GLFW_KEY_S, Action::Back},
+  {GLFW_KEY_DOWN, Action::Back},
+  {GLFW_KEY_A, Action::Left},
+  {GLFW_KEY_LEFT, Action::Left},
+  {GLFW_KEY_D, Action::Right},
+  {GLFW_KEY_RIGHT, Action::Right},
+  {GLFW_KEY_SPACE, Action::Up},
+  {GLFW_KEY_LEFT_CONTROL, Action::Down},
+  {GLFW_KEY_RIGHT_CONTROL, Action::Down},
+  {GLFW_KEY_LEFT_BRACKET, Action::FovNarrower},
+  {GLFW_KEY_RIGHT_BRACKET, Action::FovWider},
+  {GLFW_KEY_J, Action::NearCloser},
+  {GLFW_KEY_K, Action::NearFarther},
+};
+
+constexpr std::array<Action, GLFW_KEY_LAST + 1> makeActionMap() {
+  std::array<Action, GLFW_KEY_LAST + 1> map{};
+  for (auto& binding : key_bindings)
+    map[binding.key] = binding.action;
+  return map;
+}
+
+// Key to action lookup table, built by the compiler
+constexpr auto action_map = makeActionMap();
+
+// Set of held keys. Iterating visits only the set bits.
+class KeySet {
+public:
+  void set(int key) { words[key / 64] |= uint64_t(1) << (key % 64); }
+  void reset(int key) { words[key / 64] &= ~(uint64_t(1) << (key % 64)); }
+  bool test(int key) const { return words[key / 64] >> (key % 64) & 1; }
+
+  template <class F>
+  void forEach(F&& f) const {
+    for (int w = 0; w < num_words; w++)
+      for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+        f(w * 64 + __builtin_ctzll(bits));
+  }
+
+private:
+  static constexpr int num_words = (GLFW_KEY_LAST + 64) / 64;
+  uint64_t words[num_words] = {};
+};
+
+struct InputEvent {
+  enum Kind : uint8_t { Key, MouseButton } kind;
+  // GLFW_PRESS or GLFW_RELEASE
+  uint8_t action;
+  // Key or mouse button
+  int16_t code;
+  // glfwGetTime() when the callback saw it
+  double time;
+};
+
+class InputState {
+public:
+  // Producer side, called from the GLFW callbacks on the main thread
+  void push(const InputEvent& event) {
+    if (!events.push(event))
+      dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Consumer side: takes the queued events, updates the held keys and hands
+  // every event to `on_event` as well.
+  template <class F>
+  void drain(F&& on_event) {
+    InputEvent event;
+    while (events.pop(event)) {
+      if (event.kind == InputEvent::Key) {
+        if (event.action == GLFW_PRESS) {
+          held.set(event.code);
+          pressed_at[event.code] = event.time;
+        } else {
+          held.reset(event.code);
+        }
+      }
+      on_event(event);
+    }
+  }
+
+  // Only for the consumer
+  KeySet held;
+  // When each held key went down
+  double pressed_at[GLFW_KEY_LAST + 1] = {};
+
+  // Events lost because the queue was full
+  std::atomic<uint64_t> dropped{0};
+
+private:
+  SpscRing<InputEvent, 1024> events;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include "camera.h"
+#include "controls.h"
+#include "input_record.h"
+
+using namespace std;
+
+namespace {
+
+const char magic[4] = {'V', 'G', 'L', 'I'};
+constexpr uint32_t version = 1;
+
+struct Record {
+  // Since the previous record
+  uint32_t delta_us;
+  uint8_t kind;
+  uint8_t action;
+  int16_t code;
+};
+static_assert(sizeof(Record) == 8, "records are 8 bytes on disk");
+
+// After InputEvent::Key and MouseButton
+constexpr uint8_t cursor_kind = 2;
+
+}
+
+InputRecorder::InputRecorder(const string& path, double start)
+  : out(path, ios::binary), start(start) {
+  if (!out)
+    throw runtime_error{"Cannot write input recording " + path};
+  out.write(magic, sizeof magic);
+  out.write(reinterpret_cast<const char*>(&version), sizeof version);
+}
+
+void InputRecorder::record(const InputEvent& event) {
+  write(event.time, event.kind, event.action, event.code);
+}
+
+void InputRecorder::recordCursor(double time, double x, double y) {
+  write(time, cursor_kind, 0, 0);
+  double position[2] = {x, y};
+  out.write(reinterpret_cast<const char*>(position), sizeof position);
+}
+
+void InputRecorder::write(double time, uint8_t kind, uint8_t action, int16_t code) {
+  // Whole microseconds since the start, never going backwards
+  uint64_t us = max<int64_t>(llround((time - start) * 1e6), last_us);
+  // A gap of over an hour between two events is stretched to what fits
+  Record r{(uint32_t)min<uint64_t>(us - last_us, UINT32_MAX), kind, action, code};
+  last_us += r.delta_us;
+  out.write(reinterpret_cast<const char*>(&r), sizeof r);
+  count++;
+}
+
+InputReplay::InputReplay(const string& path) {
+  ifstream in(path, ios::binary);
+  if (!in)
+    throw runtime_error{"Cannot read input recording " + path};
+  char header[sizeof magic];
+  uint32_t file_version = 0;
+  if (!in.read(header, sizeof header) || memcmp(header, magic, sizeof magic) != 0)
+    throw runtime_error{path + " is not an input recording"};
+  if (!in.read(reinterpret_cast<char*>(&file_version), sizeof file_version) || file_version != version)
+    throw runtime_error{path + ": unsupported input recording version " + to_string(file_version)};
+
+  uint64_t us = 0;
+  Record r;
+  while (in.read(reinterpret_cast<char*>(&r), sizeof r)) {
+    us += r.delta_us;
+    Event event{us * 1e-6, r.kind, r.action, r.code, 0, 0};
+    if (r.kind == cursor_kind) {
+      double position[2];
+      if (!in.read(reinterpret_cast<char*>(position), sizeof position))
+        break;
+      event.x = position[0];
+      event.y = position[1];
+    } else if (r.kind != InputEvent::Key && r.kind != InputEvent::MouseButton) {
+      throw runtime_error{path + ": corrupt input recording"};
+    }
+    events.push_back(event);
+  }
+  done.store(events.empty(), memory_order_release);
+}
+
+void InputReplay::feed(double time, CameraState& cam) {
+  for (; next < events.size() && events[next].time <= time; next++) {
+    auto& event = events[next];
+    if (event.kind == cursor_kind) {
+      lock_guard<mutex> lock(cam.input_mutex);
+      turnCamera(cam, event.x, event.y);
+    } else {
+      cam.input.push({(InputEvent::Kind)event.kind, event.action, event.code, event.time});
+    }
+  }
+  if (next == events.size())
+    done.store(true, memory_order_release);
+}
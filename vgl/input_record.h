@@ -0,0 +1,83 @@
+// Recording input to a file and playing it back.
+//
+// InputRecorder is fed by the GLFW callbacks and writes every key, mouse
+// button and cursor event with its time. InputReplay reads the file back and
+// hands the events to a camera on a virtual clock, the time since the
+// recording started, however fast or slow the program runs. Every replay of a
+// recording flies exactly the same path; compared with the recorded session an
+// event can land one simulation step earlier or later.
+//
+// The file is the magic "VGLI", a version, then one 8 byte record per event
+// (microseconds since the previous one, kind, action, code), cursor events
+// followed by the position as two doubles. Native byte order.
+
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "input.h"
+
+class CameraState;
+
+class InputRecorder {
+public:
+  // Event times count from `start` (glfwGetTime() seconds).
+  // Throws runtime_error if `path` cannot be written.
+  InputRecorder(const std::string& path, double start);
+
+  InputRecorder(const InputRecorder&) = delete;
+  InputRecorder& operator=(const InputRecorder&) = delete;
+
+  // From the GLFW callbacks, all on the main thread
+  void record(const InputEvent& event);
+  void recordCursor(double time, double x, double y);
+
+  size_t events() const { return count; }
+
+private:
+  void write(double time, uint8_t kind, uint8_t action, int16_t code);
+
+  std::ofstream out;
+  const double start;
+  uint64_t last_us = 0;
+  size_t count = 0;
+};
+
+class InputReplay {
+public:
+  // Reads the whole recording. Throws runtime_error if `path` is not one;
+  // a recording cut short by a crash plays up to where it stops.
+  explicit InputReplay(const std::string& path);
+
+  // Hand `cam` every event up to `time`, seconds since the recording started:
+  // keys and buttons go into cam.input with their recorded time, cursor
+  // moves turn the camera the way mouse_callback does. Call it from the thread
+  // that drains cam.input, with `time` never going backwards.
+  void feed(double time, CameraState& cam);
+
+  // Every event has been fed
+  bool finished() const { return done.load(std::memory_order_acquire); }
+  // Time of the last event
+  double duration() const { return events.empty() ? 0 : events.back().time; }
+
+private:
+  struct Event {
+    double time;
+    // InputEvent::Kind, or a cursor move
+    uint8_t kind;
+    uint8_t action;
+    int16_t code;
+    double x, y;
+  };
+
+  std::vector<Event> events;
+  size_t next = 0;
+  std::atomic<bool> done{false};
+};
+
+#endif
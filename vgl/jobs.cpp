@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "jobs.h"
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// Which JobSystem the current thread belongs to, and as which worker
+thread_local const JobSystem* current_system = nullptr;
+thread_local int current_index = -1;
+
+// Spin this many times looking for work before going to sleep
+constexpr int idle_spins = 256;
+
+void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  this_thread::yield();
+#endif
+}
+
+}
+
+JobSystem::JobSystem(int requested_workers, bool pin_threads) {
+  // The thread's place is kept in one thread_local, a second system would take it over
+  if (current_system)
+    throw logic_error{"JobSystem: this thread already takes part in another JobSystem"};
+  unsigned worker_count = requested_workers;
+  if (requested_workers < 0) {
+    unsigned hardware = thread::hardware_concurrency();
+    worker_count = hardware > 1 ? hardware - 1 : 0;
+  }
+  workers.resize(worker_count + 1);
+  for (unsigned i = 0; i <= worker_count; i++) {
+    workers[i] = make_unique<Worker>();
+    workers[i]->random = 0x9e3779b9u * (i + 1);
+  }
+
+  current_system = this;
+  current_index = 0;
+  for (unsigned i = 1; i <= worker_count; i++)
+    workers[i]->thread = thread(&JobSystem::workerLoop, this, i, pin_threads);
+}
+
+JobSystem::~JobSystem() {
+  {
+    lock_guard<mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (size_t i = 1; i < workers.size(); i++)
+    workers[i]->thread.join();
+  if (current_system == this) {
+    current_system = nullptr;
+    current_index = -1;
+  }
+}
+
+int JobSystem::threadIndex() const {
+  return current_system == this ? current_index : -1;
+}
+
+JobSystem::Job* JobSystem::allocate(Worker& self) {
+  // Slots are handed out round robin, skipping the ones still in use. Waiting
+  // for them to free up is not an option: the job holding one may be further
+  // up this very thread's stack, waiting for its children.
+  for (size_t tries = 0; tries < pool_size; tries++) {
+    Job* job = &self.pool[self.next_job++ & (pool_size - 1)];
+    if (!job->busy.load(memory_order_acquire)) {
+      job->busy.store(true, memory_order_relaxed);
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::push(Worker& self, Job* job) {
+  if (!self.deque.push(job)) {
+    // Deque full, there is plenty to steal already
+    execute(job);
+    return;
+  }
+  // Seq_cst against the sleeper count, see workerLoop
+  queued.fetch_add(1, memory_order_seq_cst);
+  if (sleepers.load(memory_order_seq_cst) > 0) {
+    lock_guard<mutex> lock(sleep_mutex);
+    wake.notify_one();
+  }
+}
+
+bool JobSystem::runOne(Worker& self) {
+  Job* job;
+  if (self.deque.pop(job)) {
+    queued.fetch_sub(1, memory_order_relaxed);
+    execute(job);
+    return true;
+  }
+  // Try every other thread once, starting at a random one so that thieves spread out
+  size_t count = workers.size();
+  self.random ^= self.random << 13;
+  self.random ^= self.random >> 17;
+  self.random ^= self.random << 5;
+  size_t start = self.random % count;
+  for (size_t i = 0; i < count; i++) {
+    Worker& victim = *workers[(start + i) % count];
+    if (&victim == &self || victim.deque.empty())
+      continue;
+    if (victim.deque.steal(job)) {
+      queued.fetch_sub(1, memory_order_relaxed);
+      execute(job);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::execute(Job* job) {
+  JobCounter* counter = job->counter;
+  job->call(*job);
+  job->busy.store(false, memory_order_release);
+  counter->pending.fetch_sub(1, memory_order_release);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+  int index = threadIndex();
+  while (!counter.done()) {
+    if (index < 0 || !runOne(*workers[index]))
+      cpuRelax();
+  }
+}
+
+bool JobSystem::runPending() {
+  int index = threadIndex();
+  return index >= 0 && runOne(*workers[index]);
+}
+
+void JobSystem::workerLoop(unsigned index, bool pin) {
+  current_system = this;
+  current_index = index;
+#ifdef VGL_PROFILE
+  string name = "job worker " + to_string(index);
+  VGL_PROFILE_THREAD(name.c_str());
+#endif
+#ifdef __linux__
+  if (pin) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % max(1u, thread::hardware_concurrency()), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#else
+  (void)pin;
+#endif
+
+  Worker& self = *workers[index];
+  int idle = 0;
+  while (!stopping.load(memory_order_relaxed)) {
+    if (runOne(self)) {
+      idle = 0;
+      continue;
+    }
+    if (++idle < idle_spins) {
+      cpuRelax();
+      continue;
+    }
+    // Nothing to do for a while. push() bumps `queued` before it looks at
+    // `sleepers` and we do the opposite, so one of us sees the other.
+    unique_lock<mutex> lock(sleep_mutex);
+    sleepers.fetch_add(1, memory_order_seq_cst);
+    wake.wait(lock, [&] { return stopping.load() || queued.load(memory_order_seq_cst) > 0; });
+    sleepers.fetch_sub(1, memory_order_relaxed);
+    idle = 0;
+  }
+}
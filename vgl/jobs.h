@@ -0,0 +1,194 @@
+// Work-stealing job system.
+//
+// Every thread taking part (the workers and the thread that created the
+// JobSystem) has its own WorkDeque. A thread runs its own jobs newest first,
+// which keeps their data in its cache, and when it runs out steals the oldest
+// job of another thread, which tends to be the biggest piece of work left.
+//
+//   JobCounter counter;
+//   jobs.run(counter, [&] { ... });
+//   jobs.run(counter, [&] { ... });
+//   jobs.wait(counter);  // runs jobs itself until both are done
+//
+// Dependencies go through counters: a job may run children on the counter it
+// was started with, which then only reaches zero once they are done too, or
+// on a counter of its own and wait for it. Waiting never blocks a thread that
+// could be running jobs instead.
+//
+// Jobs are small and fixed-size. The callable is stored inline, so keep the
+// captures to a few pointers.
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "work_deque.h"
+
+class JobCounter {
+public:
+  bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<int> pending{0};
+};
+
+class JobSystem {
+public:
+  // Starts `workers` threads besides the calling one. -1 means one per
+  // hardware thread, the calling thread included. With `pin_threads` worker i
+  // is bound to CPU i (Linux only), which keeps the scheduler from migrating them.
+  // A thread takes part in one job system at a time: throws logic_error if the
+  // calling thread created another one that is still alive, or is its worker.
+  explicit JobSystem(int workers = -1, bool pin_threads = false);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // Queues fn() and counts it in `counter`. From a thread that does not take
+  // part in the job system the job just runs right away.
+  template <class F>
+  void run(JobCounter& counter, F&& fn);
+
+  // Runs queued jobs until `counter` drops to zero
+  void wait(JobCounter& counter);
+  // Runs one queued job, for a thread that has its own waiting to do.
+  // False if there was none, or if the thread is not part of the job system.
+  bool runPending();
+
+  // Calls fn(chunk_begin, chunk_end) over [begin, end) in parallel and waits.
+  // The range is split in halves down to a grain of about eight chunks per
+  // thread, but never below `min_grain` items: idle threads steal the big
+  // halves first, so the load balances without many jobs.
+  template <class F>
+  void parallelFor(size_t begin, size_t end, F&& fn, size_t min_grain = 1);
+
+  // The workers plus the thread that created the JobSystem
+  unsigned threads() const { return workers.size(); }
+  // 0 on the thread that created the JobSystem, 1.. on the workers, -1 elsewhere
+  int threadIndex() const;
+
+private:
+  static constexpr size_t job_storage = 40;
+
+  // One cache line
+  struct alignas(64) Job {
+    alignas(std::max_align_t) unsigned char storage[job_storage];
+    void (*call)(Job&);
+    JobCounter* counter;
+    // Still queued or running, the slot cannot be reused yet
+    std::atomic<bool> busy{false};
+  };
+
+  static constexpr size_t deque_size = 4096;
+  // Jobs are taken round robin from a pool per thread, twice the deque so
+  // that a full deque still leaves room for the jobs being run
+  static constexpr size_t pool_size = 2 * deque_size;
+
+  struct Worker {
+    WorkDeque<Job*, deque_size> deque;
+    std::unique_ptr<Job[]> pool{new Job[pool_size]};
+    size_t next_job = 0;
+    uint32_t random = 0;
+    std::thread thread;
+  };
+
+  template <class F>
+  static void call(Job& job) {
+    F& fn = *std::launder(reinterpret_cast<F*>(job.storage));
+    fn();
+    fn.~F();
+  }
+
+  template <class F>
+  struct ForRange;
+
+  // Null when the whole pool is in use
+  Job* allocate(Worker& self);
+  void push(Worker& self, Job* job);
+  // Runs one job, own first, else stolen. False if there was none to be found.
+  bool runOne(Worker& self);
+  void execute(Job* job);
+  void workerLoop(unsigned index, bool pin);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  // Queued and not taken yet. Workers only go to sleep when this is zero.
+  alignas(64) std::atomic<int> queued{0};
+  std::atomic<int> sleepers{0};
+  std::atomic<bool> stopping{false};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+};
+
+template <class F>
+void JobSystem::run(JobCounter& counter, F&& fn) {
+  using Fn = std::decay_t<F>;
+  static_assert(sizeof(Fn) <= job_storage, "job captures too much, capture a pointer to a struct instead");
+  static_assert(alignof(Fn) <= alignof(std::max_align_t), "job callable is over-aligned");
+
+  int index = threadIndex();
+  if (index < 0) {
+    fn();
+    return;
+  }
+  Worker& self = *workers[index];
+  Job* job = allocate(self);
+  if (!job) {
+    // Every job of this thread is still in flight, no point in queueing more
+    fn();
+    return;
+  }
+  new (job->storage) Fn(std::forward<F>(fn));
+  job->call = &call<Fn>;
+  job->counter = &counter;
+  counter.pending.fetch_add(1, std::memory_order_relaxed);
+  push(self, job);
+}
+
+// Shared by all the jobs of one parallelFor, lives on the waiting thread's stack
+template <class F>
+struct JobSystem::ForRange {
+  JobSystem* jobs;
+  JobCounter counter;
+  F* fn;
+  size_t grain;
+
+  void split(size_t begin, size_t end) {
+    // Hand out the upper halves, keep the lower one
+    while (end - begin > grain) {
+      size_t middle = begin + (end - begin) / 2;
+      jobs->run(counter, [this, middle, end] { split(middle, end); });
+      end = middle;
+    }
+    (*fn)(begin, end);
+  }
+};
+
+template <class F>
+void JobSystem::parallelFor(size_t begin, size_t end, F&& fn, size_t min_grain) {
+  if (begin >= end)
+    return;
+  size_t count = end - begin;
+  if (threads() == 1 || threadIndex() < 0 || count <= min_grain) {
+    fn(begin, end);
+    return;
+  }
+  ForRange<std::remove_reference_t<F>> range{this, {}, &fn, std::max<size_t>({1, min_grain, count / (threads() * 8)})};
+  range.split(begin, end);
+  wait(range.counter);
+}
+
+#endif
@@ -0,0 +1,162 @@
+// Microbenchmarks for the job system.
+//
+//   spawn     empty jobs queued and run by the spawning thread alone: the bare cost of a job
+//   steal     empty jobs queued by one thread and run by whoever gets them, and how many got stolen
+//   nested    a binary tree of jobs, each waiting for its two children
+//   for       parallelFor over a fixed amount of work with 1, 2, 4, ... threads
+//
+// Usage: ./jobs_bench [--jobs N] [--items N] [--max-threads T] [--pin]
+// Build with make VARIANT=release jobs_bench, debug builds measure the debug checks.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+using namespace std;
+
+namespace {
+
+struct Config {
+  size_t jobs = 1 << 20;
+  size_t items = 1 << 24;
+  unsigned max_threads = max(1u, thread::hardware_concurrency());
+  bool pin = false;
+};
+
+double elapsedMs(chrono::steady_clock::time_point since) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+// Queues the jobs in batches so that they fit in the deque and the pool
+template <class F>
+double spawnAndWait(JobSystem& jobs, size_t count, F fn) {
+  auto start = chrono::steady_clock::now();
+  const size_t batch = 1024;
+  for (size_t done = 0; done < count; done += batch) {
+    JobCounter counter;
+    for (size_t i = 0; i < batch; i++)
+      jobs.run(counter, fn);
+    jobs.wait(counter);
+  }
+  return elapsedMs(start);
+}
+
+void benchSpawn(const Config& cfg) {
+  JobSystem jobs(0);
+  double ms = spawnAndWait(jobs, cfg.jobs, [] {});
+  printf("spawn   %zu jobs, one thread:  %8.1f ns/job\n", cfg.jobs, ms * 1e6 / cfg.jobs);
+}
+
+void benchSteal(const Config& cfg) {
+  JobSystem jobs(cfg.max_threads - 1, cfg.pin);
+  atomic<size_t> stolen{0};
+  JobSystem* system = &jobs;
+  double ms = spawnAndWait(jobs, cfg.jobs, [system, &stolen] {
+    if (system->threadIndex() != 0)
+      stolen.fetch_add(1, memory_order_relaxed);
+  });
+  printf("steal   %zu jobs, %u threads:  %8.1f ns/job, %.1f%% stolen\n", cfg.jobs, jobs.threads(),
+         ms * 1e6 / cfg.jobs, 100. * stolen / cfg.jobs);
+}
+
+struct Tree {
+  JobSystem* jobs;
+  atomic<size_t> leaves{0};
+
+  void node(int depth) {
+    if (depth == 0) {
+      leaves.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+    JobCounter children;
+    jobs->run(children, [this, depth] { node(depth - 1); });
+    jobs->run(children, [this, depth] { node(depth - 1); });
+    jobs->wait(children);
+  }
+};
+
+void benchNested(const Config& cfg) {
+  JobSystem jobs(cfg.max_threads - 1, cfg.pin);
+  int depth = max(1, (int)log2((double)cfg.jobs) - 1);
+  Tree tree{&jobs};
+  auto start = chrono::steady_clock::now();
+  tree.node(depth);
+  double ms = elapsedMs(start);
+  size_t count = (size_t(2) << depth) - 2;
+  printf("nested  %zu jobs, depth %d, %u threads:  %8.1f ns/job, %zu leaves\n", count, depth, jobs.threads(),
+         ms * 1e6 / count, tree.leaves.load());
+}
+
+void benchParallelFor(const Config& cfg) {
+  vector<float> data(cfg.items);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (float)i;
+
+  // 1, 2, 4, ... and max_threads itself
+  vector<unsigned> thread_counts;
+  for (unsigned threads = 1; threads < cfg.max_threads; threads *= 2)
+    thread_counts.push_back(threads);
+  thread_counts.push_back(cfg.max_threads);
+
+  double single_ms = 0;
+  for (unsigned threads : thread_counts) {
+    JobSystem jobs(threads - 1, cfg.pin);
+    auto work = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        data[i] = sqrt(data[i] * 0.5f + 1.f);
+    };
+    // One untimed round to wake the workers and warm the caches
+    jobs.parallelFor(0, data.size(), work, 4096);
+    const int rounds = 5;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+      jobs.parallelFor(0, data.size(), work, 4096);
+    double ms = elapsedMs(start) / rounds;
+    if (threads == 1)
+      single_ms = ms;
+    printf("for     %zu items, %2u threads:  %8.2f ms, speedup %.2f\n", cfg.items, threads, ms, single_ms / ms);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  Config cfg;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--pin") {
+      cfg.pin = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "usage: jobs_bench [--jobs N] [--items N] [--max-threads T] [--pin]\n");
+      return 2;
+    }
+    const char* value = argv[++i];
+    if (arg == "--jobs")
+      cfg.jobs = strtoull(value, nullptr, 10);
+    else if (arg == "--items")
+      cfg.items = strtoull(value, nullptr, 10);
+    else if (arg == "--max-threads")
+      cfg.max_threads = max(1, atoi(value));
+    else {
+      fprintf(stderr, "usage: jobs_bench [--jobs N] [--items N] [--max-threads T] [--pin]\n");
+      return 2;
+    }
+  }
+
+  benchSpawn(cfg);
+  benchSteal(cfg);
+  benchNested(cfg);
+  benchParallelFor(cfg);
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "spsc_ring.h"
+
+using namespace std;
+
+namespace {
+
+// Longer messages get truncated
+constexpr size_t max_message = 240;
+
+struct LogRecord {
+  double time;
+  LogLevel level;
+  LogCategory category;
+  char text[max_message];
+};
+
+// One per thread that has logged. Never freed, so that messages from
+// threads that have exited are still written.
+struct ThreadQueue {
+  SpscRing<LogRecord, 512> records;
+  atomic<uint64_t> dropped{0};
+  int tid;
+};
+
+const char* level_names[] = {"trace", "debug", "info", "warn", "error"};
+const char* category_names[] = {"general", "input", "camera", "render", "sim", "gl"};
+static_assert(sizeof(category_names) / sizeof(*category_names) == (size_t)LogCategory::Count,
+              "every category needs a name");
+
+class Logger {
+public:
+  Logger() : start(chrono::steady_clock::now()), writer(&Logger::run, this) {
+    for (auto& enabled : categories)
+      enabled = true;
+  }
+
+  ~Logger() {
+    running = false;
+    writer.join();
+  }
+
+  ThreadQueue* queue() {
+    thread_local ThreadQueue* queue = nullptr;
+    if (!queue) {
+      lock_guard<mutex> lock(registry_mutex);
+      registry.emplace_back(new ThreadQueue);
+      queue = registry.back().get();
+      queue->tid = registry.size();
+    }
+    return queue;
+  }
+
+  double now() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+
+  void flush() {
+    auto ticket = ++flush_requested;
+    while (flushed.load() < ticket && running)
+      this_thread::yield();
+  }
+
+  atomic<bool> categories[(size_t)LogCategory::Count];
+
+private:
+  // Writes out whatever the queues hold; returns whether there was anything
+  bool drain() {
+    bool any = false;
+    lock_guard<mutex> lock(registry_mutex);
+    for (auto& queue : registry) {
+      LogRecord record;
+      while (queue->records.pop(record)) {
+        fprintf(stderr, "%10.4f [%d] %s/%s: %s\n", record.time, queue->tid,
+                category_names[(size_t)record.category], level_names[(size_t)record.level], record.text);
+        any = true;
+      }
+      auto dropped = queue->dropped.exchange(0);
+      if (dropped)
+        fprintf(stderr, "%10.4f [%d] log: dropped %llu messages\n", now(), queue->tid,
+                (unsigned long long)dropped);
+    }
+    return any;
+  }
+
+  void run() {
+    // Poll with a backoff instead of waking up on every message: a condition
+    // variable would make the logging threads take a lock.
+    auto idle = chrono::microseconds(100);
+    while (running) {
+      // Everything logged before these flush requests is in the queues by now
+      auto requested = flush_requested.load();
+      if (drain())
+        idle = chrono::microseconds(100);
+      else
+        idle = min(idle * 2, chrono::microseconds(10000));
+      if (requested != flushed.load()) {
+        fflush(stderr);
+        flushed = requested;
+      } else {
+        this_thread::sleep_for(idle);
+      }
+    }
+    drain();
+    fflush(stderr);
+  }
+
+  chrono::steady_clock::time_point start;
+  mutex registry_mutex;
+  vector<unique_ptr<ThreadQueue>> registry;
+  atomic<bool> running{true};
+  atomic<uint64_t> flush_requested{0};
+  atomic<uint64_t> flushed{0};
+  thread writer;
+};
+
+Logger& logger() {
+  static Logger logger;
+  return logger;
+}
+
+}
+
+void vglLog(LogLevel level, LogCategory category, const char* format, ...) {
+  auto& log = logger();
+  if (!log.categories[(size_t)category].load(memory_order_relaxed))
+    return;
+
+  LogRecord record;
+  record.time = log.now();
+  record.level = level;
+  record.category = category;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(record.text, sizeof(record.text), format, args);
+  va_end(args);
+
+  auto queue = log.queue();
+  if (!queue->records.push(record))
+    queue->dropped.fetch_add(1, memory_order_relaxed);
+}
+
+void vglLogEnable(LogCategory category, bool enabled) {
+  logger().categories[(size_t)category] = enabled;
+}
+
+void vglLogFlush() {
+  logger().flush();
+}
@@ -0,0 +1,45 @@
+// Asynchronous logging.
+//
+//   VGL_LOG(DEBUG, Input, "key %d", key);
+//
+// Messages below VGL_LOG_LEVEL (make LOG_LEVEL=TRACE|DEBUG|INFO|WARN|ERROR|OFF)
+// are compiled out, arguments and all. Enabled messages are formatted on the
+// calling thread into that thread's lock-free queue and written out by a
+// background thread, so logging never waits for the terminal. If a queue is
+// full the message is dropped and counted rather than blocking.
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+
+#define VGL_LOG_LEVEL_TRACE 0
+#define VGL_LOG_LEVEL_DEBUG 1
+#define VGL_LOG_LEVEL_INFO 2
+#define VGL_LOG_LEVEL_WARN 3
+#define VGL_LOG_LEVEL_ERROR 4
+#define VGL_LOG_LEVEL_OFF 5
+
+#ifndef VGL_LOG_LEVEL
+#define VGL_LOG_LEVEL VGL_LOG_LEVEL_INFO
+#endif
+
+enum class LogLevel : uint8_t { Trace, Debug, Info, Warn, Error };
+
+enum class LogCategory : uint8_t { General, Input, Camera, Render, Sim, GL, Count };
+
+void vglLog(LogLevel level, LogCategory category, const char* format, ...)
+  __attribute__((format(printf, 3, 4)));
+
+// Turn a category off (or back on) at run time
+void vglLogEnable(LogCategory category, bool enabled);
+// Wait until everything logged so far has been written
+void vglLogFlush();
+
+#define VGL_LOG(level, category, ...)                                                 \
+  do {                                                                                \
+    if constexpr (VGL_LOG_LEVEL_##level >= VGL_LOG_LEVEL)                             \
+      vglLog((LogLevel)VGL_LOG_LEVEL_##level, LogCategory::category, __VA_ARGS__);    \
+  } while (0)
+
+#endif
@@ -0,0 +1,393 @@
+// Microbenchmarks and accuracy checks for the batch_math kernels.
+//
+//   axis-angle   translate * rotate * scale of every object, against glm::translate, rotate and scale
+//   affine       a parent transform times every model matrix, against glm's mat4 product
+//   mvp          the view-projection times every model matrix, against glm's mat4 product
+//   cull         spheres against the frustum planes, against the same test written out plainly
+//   cull-views   spheres against four frusta at once, against cull once per view
+//   boxes        separating axis test of pairs of cubes, against the projections onto every axis in doubles
+//
+// Every kernel runs at each SIMD level the CPU has, on the same inputs as
+// glm, and its output is compared with glm's. Anything further off than float
+// rounding explains makes it exit with 1, so it doubles as the kernels' test.
+//
+// Usage: ./math_bench [--count N] [--rounds R]
+// Build with make VARIANT=release math_bench, debug builds measure the debug checks.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "batch_math.h"
+
+using namespace std;
+
+namespace {
+
+struct Config {
+  size_t count = 100000;
+  int rounds = 20;
+};
+
+struct Inputs {
+  vector<glm::vec3> positions, axes;
+  vector<float> scales, angles;
+  vector<glm::vec4> spheres;
+  glm::mat4 view_projection;
+  AffineTransform parent;
+  // Pairs 2k, 2k + 1, close enough that about half of them overlap
+  vector<OrientedBox> boxes;
+  vector<uint32_t> first, second;
+};
+
+Inputs makeInputs(size_t count) {
+  Inputs in;
+  mt19937 gen(1);
+  uniform_real_distribution<float> position(-50, 50), axis(-1, 1), scale(0.1f, 2), angle(0, 2 * M_PI);
+  for (size_t i = 0; i < count; i++) {
+    in.positions.emplace_back(position(gen), position(gen), position(gen));
+    // Not normalized on purpose, glm::rotate takes any length
+    in.axes.emplace_back(axis(gen), axis(gen), axis(gen) + 1.5f);
+    in.scales.push_back(scale(gen));
+    in.angles.push_back(angle(gen));
+    in.spheres.emplace_back(in.positions.back(), in.scales.back() * 1.7320508f);
+  }
+  uniform_real_distribution<float> offset(-0.8f, 0.8f), half(0.05f, 0.5f);
+  for (size_t i = 0; i < 2 * count; i++) {
+    glm::vec3 center = i % 2 ? glm::vec3(in.boxes.back().center[0], in.boxes.back().center[1], in.boxes.back().center[2]) +
+                                   glm::vec3(offset(gen), offset(gen), offset(gen))
+                             : glm::vec3(position(gen), position(gen), position(gen));
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.f), angle(gen), glm::vec3(axis(gen), axis(gen), axis(gen) + 1.5f));
+    OrientedBox box{{center.x, center.y, center.z}, half(gen), {}, {}};
+    for (int a = 0; a < 3; a++) {
+      for (int c = 0; c < 3; c++)
+        box.axes[a][c] = rotation[a][c];
+    }
+    in.boxes.push_back(box);
+    (i % 2 ? in.second : in.first).push_back(i);
+  }
+  in.view_projection = glm::perspective(glm::radians(70.f), 4.f / 3, 0.1f, 100.f) *
+                       glm::lookAt(glm::vec3(10, 20, 80), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+  in.parent = toAffine(glm::rotate(glm::translate(glm::mat4(1.f), glm::vec3(1, -2, 3)), 0.7f, glm::vec3(0.3f, 1, 0.2f)));
+  return in;
+}
+
+// Best of `rounds`, in nanoseconds per object
+template <class F>
+double timeNs(const Config& cfg, F fn) {
+  double best = 1e300;
+  for (int r = 0; r < cfg.rounds; r++) {
+    auto start = chrono::steady_clock::now();
+    fn();
+    best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+  }
+  return best / cfg.count;
+}
+
+// Largest difference relative to the magnitude of the expected values
+double maxError(const vector<glm::mat4>& expected, const vector<glm::mat4>& actual) {
+  double worst = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    double magnitude = 1;
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++)
+        magnitude = max(magnitude, (double)fabs(expected[i][c][r]));
+    }
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++)
+        worst = max(worst, fabs((double)expected[i][c][r] - actual[i][c][r]) / magnitude);
+    }
+  }
+  return worst;
+}
+
+vector<glm::mat4> toMat4s(const vector<AffineTransform>& affine) {
+  vector<glm::mat4> result;
+  for (auto& a : affine)
+    result.push_back(toMat4(a));
+  return result;
+}
+
+// A few float ulp of the largest element, after a handful of operations
+constexpr double tolerance = 1e-5;
+bool failed = false;
+
+void report(const char* kernel, const char* level, double ns, double glm_ns, double error) {
+  bool ok = error <= tolerance;
+  failed |= !ok;
+  printf("%-10s %-7s %7.2f ns/object  %5.2fx glm  max error %.1e%s\n", kernel, level, ns, glm_ns / ns, error,
+         ok ? "" : "  FAILED");
+}
+
+vector<SimdLevel> levels() {
+  vector<SimdLevel> result;
+  for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512}) {
+    if (level <= vglSimdSupported())
+      result.push_back(level);
+  }
+  return result;
+}
+
+void benchAxisAngle(const Config& cfg, const Inputs& in) {
+  vector<glm::mat4> expected(cfg.count);
+  double glm_ns = timeNs(cfg, [&] {
+    for (size_t i = 0; i < cfg.count; i++) {
+      glm::mat4 model = glm::translate(glm::mat4(1.f), in.positions[i]);
+      model = glm::rotate(model, in.angles[i], in.axes[i]);
+      expected[i] = glm::scale(model, glm::vec3(in.scales[i]));
+    }
+  });
+  printf("%-10s %-7s %7.2f ns/object\n", "axis-angle", "glm", glm_ns);
+
+  vector<AffineTransform> out(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    double ns = timeNs(cfg, [&] {
+      vglAxisAngleTransforms(cfg.count, in.positions.data(), in.axes.data(), in.scales.data(), in.angles.data(), out.data());
+    });
+    report("axis-angle", vglSimdLevelName(level), ns, glm_ns, maxError(expected, toMat4s(out)));
+  }
+}
+
+void benchAffine(const Config& cfg, const Inputs& in) {
+  vector<AffineTransform> models(cfg.count);
+  vglSetSimdLevel(SimdLevel::Scalar);
+  vglAxisAngleTransforms(cfg.count, in.positions.data(), in.axes.data(), in.scales.data(), in.angles.data(), models.data());
+  vector<glm::mat4> model_matrices = toMat4s(models);
+  glm::mat4 parent = toMat4(in.parent);
+
+  vector<glm::mat4> expected(cfg.count);
+  double glm_ns = timeNs(cfg, [&] {
+    for (size_t i = 0; i < cfg.count; i++)
+      expected[i] = parent * model_matrices[i];
+  });
+  printf("%-10s %-7s %7.2f ns/object\n", "affine", "glm", glm_ns);
+
+  vector<AffineTransform> out(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    double ns = timeNs(cfg, [&] { vglMultiplyAffine(in.parent, cfg.count, models.data(), out.data()); });
+    report("affine", vglSimdLevelName(level), ns, glm_ns, maxError(expected, toMat4s(out)));
+  }
+}
+
+void benchMvp(const Config& cfg, const Inputs& in) {
+  vector<AffineTransform> models(cfg.count);
+  vglSetSimdLevel(SimdLevel::Scalar);
+  vglAxisAngleTransforms(cfg.count, in.positions.data(), in.axes.data(), in.scales.data(), in.angles.data(), models.data());
+  vector<glm::mat4> model_matrices = toMat4s(models);
+
+  vector<glm::mat4> expected(cfg.count);
+  double glm_ns = timeNs(cfg, [&] {
+    for (size_t i = 0; i < cfg.count; i++)
+      expected[i] = in.view_projection * model_matrices[i];
+  });
+  printf("%-10s %-7s %7.2f ns/object\n", "mvp", "glm", glm_ns);
+
+  vector<glm::mat4> out(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    double ns = timeNs(cfg, [&] { vglModelViewProjection(in.view_projection, cfg.count, models.data(), out.data()); });
+    report("mvp", vglSimdLevelName(level), ns, glm_ns, maxError(expected, out));
+  }
+}
+
+void benchCull(const Config& cfg, const Inputs& in) {
+  glm::vec4 planes[6];
+  vglFrustumPlanes(in.view_projection, planes);
+  // Signed distance of the sphere's far side past the plane, in doubles
+  auto margin = [&](size_t i) {
+    double worst = 1e300;
+    for (auto& p : planes) {
+      glm::vec4 s = in.spheres[i];
+      worst = min(worst, (double)p.x * s.x + (double)p.y * s.y + (double)p.z * s.z + p.w + s.w);
+    }
+    return worst;
+  };
+
+  vector<uint32_t> expected;
+  double glm_ns = timeNs(cfg, [&] {
+    expected.clear();
+    for (size_t i = 0; i < cfg.count; i++) {
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; p++)
+        inside = glm::dot(glm::vec3(planes[p]), glm::vec3(in.spheres[i])) + planes[p].w >= -in.spheres[i].w;
+      if (inside)
+        expected.push_back(i);
+    }
+  });
+  printf("%-10s %-7s %7.2f ns/object, %zu of %zu visible\n", "cull", "glm", glm_ns, expected.size(), cfg.count);
+
+  vector<uint32_t> out(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    size_t visible = 0;
+    double ns = timeNs(cfg, [&] { visible = vglCullSpheres(planes, cfg.count, in.spheres.data(), out.data()); });
+    // Only spheres touching a plane may come out differently, from rounding
+    vector<uint32_t> differ;
+    set_symmetric_difference(expected.begin(), expected.end(), out.begin(), out.begin() + visible, back_inserter(differ));
+    double error = 0;
+    for (uint32_t i : differ)
+      error = max(error, fabs(margin(i)) / max(1.f, in.spheres[i].w));
+    report("cull", vglSimdLevelName(level), ns, glm_ns, error);
+  }
+}
+
+void benchCullViews(const Config& cfg, const Inputs& in) {
+  // Four cameras around the same point, as a split screen would have
+  constexpr unsigned views = 4;
+  glm::vec4 planes[views][6];
+  for (unsigned v = 0; v < views; v++) {
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.f), glm::radians(90.f * v), glm::vec3(0, 1, 0));
+    vglFrustumPlanes(in.view_projection * rotation, planes[v]);
+  }
+
+  // Per sphere, the views it is in according to vglCullSpheres
+  vector<uint32_t> expected(cfg.count), indices(cfg.count);
+  auto perView = [&] {
+    fill(expected.begin(), expected.end(), 0);
+    for (unsigned v = 0; v < views; v++) {
+      size_t visible = vglCullSpheres(planes[v], cfg.count, in.spheres.data(), indices.data());
+      for (size_t k = 0; k < visible; k++)
+        expected[indices[k]] |= 1u << v;
+    }
+  };
+  double glm_ns = timeNs(cfg, perView);
+  printf("%-10s %-7s %7.2f ns/object, %u views\n", "cull-views", "cull", glm_ns, views);
+
+  vector<uint32_t> out(cfg.count), masks(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    // The reference at the same level, so the two round alike
+    perView();
+    size_t visible = 0;
+    double ns = timeNs(cfg, [&] { visible = vglCullSpheresViews(planes, views, cfg.count, in.spheres.data(), out.data(), masks.data()); });
+    // Exact: both test every plane the same way
+    size_t wrong = 0, k = 0;
+    for (size_t i = 0; i < cfg.count; i++) {
+      uint32_t mask = k < visible && out[k] == i ? masks[k++] : 0;
+      wrong += mask != expected[i];
+    }
+    report("cull-views", vglSimdLevelName(level), ns, glm_ns, wrong + (k != visible) ? 1 : 0);
+  }
+}
+
+
+// How far the boxes of pair k overlap along `axis`, in doubles
+double overlapAlong(const Inputs& in, size_t k, glm::dvec3 axis) {
+  auto& a = in.boxes[in.first[k]];
+  auto& b = in.boxes[in.second[k]];
+  double ra = 0, rb = 0, along = 0;
+  for (int i = 0; i < 3; i++) {
+    ra += fabs(glm::dot(axis, glm::dvec3(a.axes[i][0], a.axes[i][1], a.axes[i][2])));
+    rb += fabs(glm::dot(axis, glm::dvec3(b.axes[i][0], b.axes[i][1], b.axes[i][2])));
+    along += axis[i] * ((double)b.center[i] - a.center[i]);
+  }
+  return a.half_size * ra + b.half_size * rb - fabs(along);
+}
+
+// The depth vglCollideBoxes should come up with for pair k, edges having to
+// beat faces by `margin`
+double referenceDepth(const Inputs& in, size_t k, double margin) {
+  auto& a = in.boxes[in.first[k]];
+  auto& b = in.boxes[in.second[k]];
+  glm::dvec3 axes_a[3], axes_b[3];
+  for (int i = 0; i < 3; i++) {
+    axes_a[i] = glm::dvec3(a.axes[i][0], a.axes[i][1], a.axes[i][2]);
+    axes_b[i] = glm::dvec3(b.axes[i][0], b.axes[i][1], b.axes[i][2]);
+  }
+  double best = 1e300;
+  for (int i = 0; i < 3; i++) {
+    best = min(best, overlapAlong(in, k, axes_a[i]));
+    best = min(best, overlapAlong(in, k, axes_b[i]));
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      glm::dvec3 axis = glm::cross(axes_a[i], axes_b[j]);
+      if (glm::length(axis) < 1e-2)
+        continue;
+      double depth = overlapAlong(in, k, glm::normalize(axis));
+      if (depth * margin < best)
+        best = depth;
+    }
+  }
+  return best;
+}
+
+void benchBoxes(const Config& cfg, const Inputs& in) {
+  vector<double> expected(cfg.count);
+  // Pairs where rounding may tip the choice between an edge and a face, and with it the depth
+  vector<bool> close(cfg.count);
+  double glm_ns = timeNs(cfg, [&] {
+    for (size_t k = 0; k < cfg.count; k++)
+      expected[k] = referenceDepth(in, k, 1.05);
+  });
+  size_t overlapping = 0;
+  for (size_t k = 0; k < cfg.count; k++) {
+    overlapping += expected[k] > 0;
+    close[k] = referenceDepth(in, k, 1.0499) != expected[k] || referenceDepth(in, k, 1.0501) != expected[k];
+  }
+  printf("%-10s %-7s %7.2f ns/object, %zu of %zu overlap\n", "boxes", "glm", glm_ns, overlapping, cfg.count);
+
+  vector<BoxContact> out(cfg.count);
+  for (SimdLevel level : levels()) {
+    vglSetSimdLevel(level);
+    double ns = timeNs(cfg, [&] { vglCollideBoxes(in.boxes.data(), cfg.count, in.first.data(), in.second.data(), out.data()); });
+    // The depth, and that the normal is an axis the boxes overlap that much along
+    double error = 0;
+    for (size_t k = 0; k < cfg.count; k++) {
+      if (close[k])
+        continue;
+      glm::dvec3 normal(out[k].normal[0], out[k].normal[1], out[k].normal[2]);
+      // Relative to what the depth is the difference of
+      auto& a = in.boxes[in.first[k]];
+      auto& b = in.boxes[in.second[k]];
+      double size = a.half_size + b.half_size +
+                    glm::length(glm::dvec3(b.center[0] - a.center[0], b.center[1] - a.center[1], b.center[2] - a.center[2]));
+      error = max(error, fabs(out[k].depth - expected[k]) / size);
+      error = max(error, fabs(overlapAlong(in, k, normal) - out[k].depth) / size);
+      error = max(error, fabs(glm::length(normal) - 1.));
+    }
+    report("boxes", vglSimdLevelName(level), ns, glm_ns, error);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  Config cfg;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "usage: math_bench [--count N] [--rounds R]\n");
+      return 2;
+    }
+    const char* value = argv[++i];
+    if (arg == "--count")
+      cfg.count = max(1ull, strtoull(value, nullptr, 10));
+    else if (arg == "--rounds")
+      cfg.rounds = max(1, atoi(value));
+    else {
+      fprintf(stderr, "usage: math_bench [--count N] [--rounds R]\n");
+      return 2;
+    }
+  }
+
+  printf("%zu objects, best of %d rounds, widest SIMD level %s\n", cfg.count, cfg.rounds, vglSimdLevelName(vglSimdSupported()));
+  Inputs in = makeInputs(cfg.count);
+  benchAxisAngle(cfg, in);
+  benchAffine(cfg, in);
+  benchMvp(cfg, in);
+  benchCull(cfg, in);
+  benchCullViews(cfg, in);
+  benchBoxes(cfg, in);
+  return failed ? 1 : 0;
+}
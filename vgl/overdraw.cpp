@@ -0,0 +1,103 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "overdraw.h"
+
+using namespace std;
+
+namespace {
+
+// Not a file, the name is the key of the programs built with it
+const char* const count_name = "vgl overdraw count";
+
+const char* const count_src = R"(#version 330 core
+out vec4 FragColor;
+
+void main()
+{
+    // Added up by the blending
+    FragColor = vec4(1.0);
+}
+)";
+
+// The heatmap's colors, evenly spaced from no fragments to the maximum
+const float heat_colors[][3] = {
+  {0, 0, 0},
+  {0, 0, 1},
+  {0, 1, 0},
+  {1, 1, 0},
+  {1, 0, 0},
+};
+constexpr int heat_stops = sizeof(heat_colors) / sizeof(heat_colors[0]);
+
+}
+
+OverdrawCounter::OverdrawCounter(ResourceManager& resources, const char* vertex_file_name, const string& vertex_src)
+  : resources(resources), target(resources, "overdraw counts", true, GL_R32F) {
+  shader = resources.loadShader(vertex_file_name, count_name, vertex_src, count_src);
+}
+
+OverdrawCounter::~OverdrawCounter() {
+  resources.release(shader);
+}
+
+void OverdrawCounter::begin(CommandBuffer& commands) const {
+  commands.bindFramebuffer(GL_FRAMEBUFFER, target.framebuffer());
+  commands.viewport(0, 0, target.width(), target.height());
+  commands.clearColorBuffer(0, 0, 0, 0);
+  commands.clear(GL_DEPTH_BUFFER_BIT);
+  commands.enable(GL_DEPTH_TEST);
+  commands.enable(GL_BLEND);
+  commands.blendFunc(GL_ONE, GL_ONE);
+  commands.useProgram(resources.get(shader));
+}
+
+void OverdrawCounter::end(CommandBuffer& commands) const {
+  commands.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  commands.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OverdrawCounter::read(double& mean, double& max) {
+  counts.resize((size_t)target.width() * target.height());
+  glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer());
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, target.width(), target.height(), GL_RED, GL_FLOAT, counts.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  double sum = 0;
+  float largest = 0;
+  for (float count : counts) {
+    sum += count;
+    largest = std::max(largest, count);
+  }
+  mean = counts.empty() ? 0 : sum / counts.size();
+  max = largest;
+}
+
+void OverdrawCounter::writeHeatmap(const string& path, float max) const {
+  ofstream out(path, ios::binary);
+  if (!out)
+    throw runtime_error{"Cannot write the overdraw heatmap to " + path};
+  int width = target.width(), height = target.height();
+  out << "P6\n" << width << ' ' << height << "\n255\n";
+  string row(width * 3, '\0');
+  // GL's rows go bottom up, PPM's top down
+  for (int y = height - 1; y >= 0; y--) {
+    for (int x = 0; x < width; x++) {
+      float count = counts.empty() ? 0 : counts[(size_t)y * width + x];
+      float t = clamp(count / std::max(max, 1.f), 0.f, 1.f) * (heat_stops - 1);
+      int stop = std::min((int)t, heat_stops - 2);
+      float f = t - stop;
+      for (int c = 0; c < 3; c++)
+        row[x * 3 + c] = (char)lround(255 * (heat_colors[stop][c] + f * (heat_colors[stop + 1][c] - heat_colors[stop][c])));
+    }
+    out.write(row.data(), row.size());
+  }
+  if (!out)
+    throw runtime_error{"Cannot write the overdraw heatmap to " + path};
+}
@@ -0,0 +1,60 @@
+// Overdraw instrumentation: how many fragments get written to every pixel.
+//
+// The draws to measure are drawn a second time into a one-channel float
+// target, with a fragment shader that writes 1 and additive blending, so that
+// each pixel ends up holding the number of fragments that got through the
+// depth test there. Reading the counts back stalls until the GPU is done, so
+// this is for finding out whether a frame is fill bound, not for timing it.
+
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include "command_buffer.h"
+#include "render_target.h"
+#include "resources.h"
+
+class OverdrawCounter {
+public:
+  // Builds the counting program from the vertex shader the measured draws
+  // use, so that their uniforms carry over; look them up with program().
+  // The file name is only the key, see ResourceManager::loadShader. Throws like
+  // vglBuildShader. Everything but begin() and end() is for the context thread.
+  OverdrawCounter(ResourceManager& resources, const char* vertex_file_name, const std::string& vertex_src);
+  ~OverdrawCounter();
+
+  OverdrawCounter(const OverdrawCounter&) = delete;
+  OverdrawCounter& operator=(const OverdrawCounter&) = delete;
+
+  GLuint program() const { return resources.get(shader); }
+
+  // Count over `width` by `height` pixels, the size of what is measured
+  void resize(int width, int height) { target.resize(width, height); }
+
+  // Around the draws to count: begin() clears the counts and the depth,
+  // and leaves the counting program in use with depth testing and additive
+  // blending on; end() puts the blend function back to SRC_ALPHA,
+  // ONE_MINUS_SRC_ALPHA and binds the window.
+  void begin(CommandBuffer& commands) const;
+  void end(CommandBuffer& commands) const;
+
+  // Reads the counts of the last submitted begin() and end(), waiting for
+  // the GPU, and returns the mean and the largest over all pixels
+  void read(double& mean, double& max);
+  // The counts read last as a PPM image, black for none through blue, green
+  // and yellow to red for `max` or more. Throws runtime_error if the file
+  // cannot be written.
+  void writeHeatmap(const std::string& path, float max) const;
+
+private:
+  ResourceManager& resources;
+  ShaderHandle shader;
+  RenderTarget target;
+  std::vector<float> counts;
+};
+
+#endif
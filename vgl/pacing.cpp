@@ -0,0 +1,103 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "pacing.h"
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// The OS scheduler oversleeps by up to a millisecond or two,
+// so sleep until this much before the deadline and spin the rest.
+constexpr auto spin_margin = chrono::microseconds(1500);
+
+double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+}
+
+bool parsePacingMode(const string& text, PacingConfig& cfg) {
+  if (text == "vsync") {
+    cfg.mode = PacingMode::Vsync;
+    return true;
+  }
+  if (text == "uncapped") {
+    cfg.mode = PacingMode::Uncapped;
+    return true;
+  }
+  char* end;
+  double fps = strtod(text.c_str(), &end);
+  if (*end != '\0' || fps <= 0)
+    return false;
+  cfg.mode = PacingMode::TargetFps;
+  cfg.target_fps = fps;
+  return true;
+}
+
+FramePacer::FramePacer(const PacingConfig& cfg)
+  : cfg(cfg), fences(cfg.max_frames_in_flight > 0 ? cfg.max_frames_in_flight : 1, nullptr) {
+  glfwSwapInterval(cfg.mode == PacingMode::Vsync ? 1 : 0);
+
+  period = chrono::duration_cast<clock::duration>(chrono::duration<double>(1. / cfg.target_fps));
+  deadline = clock::now() + period;
+}
+
+FramePacer::~FramePacer() {
+  for (auto fence : fences)
+    if (fence)
+      glDeleteSync(fence);
+}
+
+double FramePacer::beginFrame() {
+  auto& fence = fences[frame % fences.size()];
+  if (!fence)
+    return 0;
+
+  VGL_PROFILE_ZONE("wait for GPU");
+  auto start = clock::now();
+  // The first wait flushes, so that the fence is guaranteed to get signaled
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  for (;;) {
+    auto result = glClientWaitSync(fence, flags, 1000000000);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+      break;
+    if (result == GL_WAIT_FAILED) {
+      cerr << "FramePacer oof: glClientWaitSync failed\n";
+      break;
+    }
+    flags = 0;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+  return msSince(start);
+}
+
+double FramePacer::endFrame() {
+  fences[frame % fences.size()] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame++;
+
+  if (cfg.mode != PacingMode::TargetFps)
+    return 0;
+
+  VGL_PROFILE_ZONE("frame limiter");
+  auto start = clock::now();
+  if (deadline - start > spin_margin)
+    this_thread::sleep_until(deadline - spin_margin);
+  while (clock::now() < deadline)
+    ;
+
+  deadline += period;
+  // After a late frame start over rather than rushing the next ones to catch up
+  auto now = clock::now();
+  if (deadline < now)
+    deadline = now + period;
+  return msSince(start);
+}
@@ -0,0 +1,60 @@
+// Frame pacing: swap interval, frame rate limiting and frames in flight.
+
+#ifndef PACING_H
+#define PACING_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+enum class PacingMode {
+  // Swap interval 1, the display sets the pace
+  Vsync,
+  // Swap interval 0, as fast as possible
+  Uncapped,
+  // Swap interval 0, limited to target_fps by sleeping and then spinning
+  TargetFps,
+};
+
+struct PacingConfig {
+  PacingMode mode = PacingMode::Vsync;
+  double target_fps = 60;
+  // How many frames the CPU may run ahead of the GPU.
+  // Fewer means less latency, more means fewer bubbles.
+  int max_frames_in_flight = 2;
+};
+
+// Parses "vsync", "uncapped" or a number of frames per second.
+// Returns false if `text` is none of those.
+bool parsePacingMode(const std::string& text, PacingConfig& cfg);
+
+class FramePacer {
+public:
+  // Sets the swap interval, so the context must be current
+  explicit FramePacer(const PacingConfig& cfg);
+  ~FramePacer();
+
+  FramePacer(const FramePacer&) = delete;
+  FramePacer& operator=(const FramePacer&) = delete;
+
+  // Before issuing any GL commands for the frame: blocks until the GPU has
+  // finished the frame max_frames_in_flight ago. Returns the milliseconds waited.
+  double beginFrame();
+  // Right after the swap: fences the frame and, in TargetFps mode, waits for
+  // the frame's time slot. Returns the milliseconds waited.
+  double endFrame();
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  PacingConfig cfg;
+  std::vector<GLsync> fences;
+  unsigned long frame = 0;
+
+  clock::duration period;
+  clock::time_point deadline;
+};
+
+#endif
@@ -0,0 +1,515 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "physics.h"
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+// Per-body work is a handful of vector operations, a job needs a few thousand
+constexpr size_t min_bodies_per_job = 4096;
+// The narrowphase kernel is a few dozen nanoseconds a pair
+constexpr size_t min_pairs_per_job = 2048;
+// Islands are mostly a contact or two
+constexpr size_t min_islands_per_job = 256;
+// Cells are this many times as wide as the average body. Narrower ones mean
+// more cells per body to enter, wider ones more bodies per cell to compare.
+constexpr float cell_bodies = 2;
+// Steps between sorting the bodies by cell. They move a fraction of a cell a
+// step, so the order stays good for a while.
+constexpr int steps_per_reorder = 60;
+// Cells whose pairs go into one list
+constexpr size_t cells_per_block = 1024;
+
+// Pushing overlapping bodies apart: this fraction of the overlap per step,
+// less a little that is left so that touching bodies do not jitter
+constexpr float position_correction = 0.2f;
+constexpr float allowed_overlap = 0.005f;
+// Slower hits than this do not bounce, they would only jitter too
+constexpr float bounce_threshold = 0.05f;
+// Mass and inertia go with the cube of the size, a speck would fly off at any touch
+constexpr float min_mass_size = 0.05f;
+
+constexpr uint32_t none = UINT32_MAX;
+
+double elapsedMs(chrono::steady_clock::time_point since) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+uint32_t findRoot(vector<uint32_t>& parent, uint32_t i) {
+  // Path halving
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// The columns of q's rotation matrix, the body's axes in world space
+void axesOf(const glm::quat& q, glm::vec3 axes[3]) {
+  float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+  axes[0] = glm::vec3(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy));
+  axes[1] = glm::vec3(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx));
+  axes[2] = glm::vec3(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy));
+}
+
+// sign(x) for most x, but a ramp through 0 near it: a support point then
+// slides to the middle of an edge or a face that is square to `direction`
+// instead of jumping between its corners
+float softSign(float x) {
+  return clamp(x * 10, -1.f, 1.f);
+}
+
+}
+
+PhysicsWorld::PhysicsWorld(const vector<Thing>& things, const PhysicsConfig& cfg) : cfg(cfg) {
+  size_t n = things.size();
+  for (auto& thing : things)
+    if (thing.parent >= 0)
+      throw invalid_argument{"PhysicsWorld: things attached to others cannot be simulated"};
+  positions.resize(n);
+  velocities.resize(n);
+  angular_velocities.resize(n);
+  orientations.assign(n, glm::quat(1, 0, 0, 0));
+  half_sizes.resize(n);
+  radii.resize(n);
+  inverse_masses.resize(n);
+  inverse_inertias.resize(n);
+
+  mt19937 gen(cfg.seed);
+  uniform_real_distribution<float> direction(-1, 1), speed(0, cfg.max_speed);
+  float largest_extent = 0, diameters = 0;
+  for (size_t i = 0; i < n; i++) {
+    auto& thing = things[i];
+    positions[i] = thing.pos;
+    glm::vec3 heading(direction(gen), direction(gen), direction(gen));
+    velocities[i] = glm::length(heading) > 0 ? glm::normalize(heading) * speed(gen) : glm::vec3(0);
+    // speed is in units of 100 degrees per second, see animateThings
+    angular_velocities[i] = glm::normalize(thing.rotation_axis) * (float)glm::radians(thing.speed * 100);
+
+    // The cube goes from -1 to 1 on every axis
+    float half = thing.scale;
+    half_sizes[i] = half;
+    radii[i] = half * sqrt(3.f);
+    float mass_size = max(half, min_mass_size);
+    float mass = 8 * mass_size * mass_size * mass_size;
+    inverse_masses[i] = 1 / mass;
+    // A cube's inertia is m * (edge^2) / 6 about any axis through its center
+    inverse_inertias[i] = 6 / (mass * 4 * mass_size * mass_size);
+
+    for (int c = 0; c < 3; c++)
+      largest_extent = max(largest_extent, fabs(thing.pos[c]) + radii[i]);
+    diameters += 2 * radii[i];
+  }
+  bounds = max(largest_extent, 1.f);
+  float cell_size = n ? max(cell_bodies * diameters / n, 0.01f) : 1;
+  cells = max(1, (int)ceil(2 * bounds / cell_size));
+  inverse_cell_size = cells / (2 * bounds);
+
+  boxes.resize(n);
+  box_min.resize(n);
+  box_max.resize(n);
+  entry_start.resize(n + 1);
+  cell_start.resize((size_t)cells * cells * cells + 1);
+  block_pairs.resize((cell_start.size() - 1 + cells_per_block - 1) / cells_per_block);
+  parent.resize(n);
+  island_of.resize(n);
+  thing_of.resize(n);
+  for (size_t i = 0; i < n; i++)
+    thing_of[i] = i;
+  reorder();
+}
+
+int PhysicsWorld::cellCoord(float v) const {
+  // Truncating is flooring for everything that is not clamped to 0 anyway
+  return clamp((int)((v + bounds) * inverse_cell_size), 0, cells - 1);
+}
+
+void PhysicsWorld::reorder() {
+  VGL_PROFILE_ZONE("PhysicsWorld::reorder");
+  size_t n = size();
+  // Counting sort by the cell of the center, like the broadphase's entries
+  fill(cell_start.begin(), cell_start.end(), 0);
+  entry_cell.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    entry_cell[i] = ((uint32_t)cellCoord(positions[i].x) * cells + cellCoord(positions[i].y)) * cells + cellCoord(positions[i].z);
+    cell_start[entry_cell[i] + 1]++;
+  }
+  for (size_t c = 1; c < cell_start.size(); c++)
+    cell_start[c] += cell_start[c - 1];
+  vector<uint32_t> order(n);
+  for (size_t i = 0; i < n; i++)
+    order[cell_start[entry_cell[i]]++] = i;
+
+  auto permute = [&](auto& values) {
+    auto sorted = values;
+    for (size_t k = 0; k < n; k++)
+      sorted[k] = values[order[k]];
+    values.swap(sorted);
+  };
+  permute(thing_of);
+  permute(positions);
+  permute(velocities);
+  permute(angular_velocities);
+  permute(orientations);
+  permute(half_sizes);
+  permute(radii);
+  permute(inverse_masses);
+  permute(inverse_inertias);
+}
+
+void PhysicsWorld::step(JobSystem& jobs, float dt) {
+  VGL_PROFILE_ZONE("PhysicsWorld::step");
+  if (positions.empty() || dt <= 0)
+    return;
+
+  auto start = chrono::steady_clock::now();
+  broadphase(jobs);
+  last.broadphase_ms = elapsedMs(start);
+
+  start = chrono::steady_clock::now();
+  narrowphase(jobs);
+  last.narrowphase_ms = elapsedMs(start);
+
+  start = chrono::steady_clock::now();
+  findIslands();
+  last.islands_ms = elapsedMs(start);
+
+  start = chrono::steady_clock::now();
+  solve(jobs, dt);
+  last.solve_ms = elapsedMs(start);
+
+  start = chrono::steady_clock::now();
+  integrate(jobs, dt);
+  last.integrate_ms = elapsedMs(start);
+
+  if (++steps % steps_per_reorder == 0)
+    reorder();
+}
+
+void PhysicsWorld::broadphase(JobSystem& jobs) {
+  VGL_PROFILE_ZONE("broadphase");
+  size_t n = size();
+
+  // The boxes for the narrowphase, their bounds, and how many cells each covers
+  jobs.parallelFor(0, n, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      OrientedBox& box = boxes[i];
+      glm::vec3 axes[3];
+      axesOf(orientations[i], axes);
+      glm::vec3 extent(0);
+      for (int a = 0; a < 3; a++) {
+        for (int c = 0; c < 3; c++)
+          box.axes[a][c] = axes[a][c];
+        extent += glm::abs(axes[a]) * half_sizes[i];
+      }
+      for (int c = 0; c < 3; c++)
+        box.center[c] = positions[i][c];
+      box.half_size = half_sizes[i];
+      box_min[i] = positions[i] - extent;
+      box_max[i] = positions[i] + extent;
+      uint32_t covered = 1;
+      for (int c = 0; c < 3; c++)
+        covered *= cellCoord(box_max[i][c]) - cellCoord(box_min[i][c]) + 1;
+      entry_start[i + 1] = covered;
+    }
+  }, min_bodies_per_job);
+
+  entry_start[0] = 0;
+  for (size_t i = 0; i < n; i++)
+    entry_start[i + 1] += entry_start[i];
+  entry_cell.resize(entry_start[n]);
+  by_cell.resize(entry_start[n]);
+
+  jobs.parallelFor(0, n, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t* out = &entry_cell[entry_start[i]];
+      int lo[3], hi[3];
+      for (int c = 0; c < 3; c++) {
+        lo[c] = cellCoord(box_min[i][c]);
+        hi[c] = cellCoord(box_max[i][c]);
+      }
+      for (int x = lo[0]; x <= hi[0]; x++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+          for (int z = lo[2]; z <= hi[2]; z++)
+            *out++ = ((uint32_t)x * cells + y) * cells + z;
+    }
+  }, min_bodies_per_job);
+
+  // Counting sort of the entries by cell: the cells are few and dense, a radix sort would go over them more often.
+  // Each of `runs` runs of bodies counts its entries per cell, then they all scatter at once, every run into
+  // the part of each cell after the runs before it. The bodies stay in order within a cell, however many runs.
+  size_t cell_count = cell_start.size() - 1;
+  size_t runs = clamp<size_t>(n / min_bodies_per_job, 1, jobs.threads());
+  run_offsets.assign(runs * cell_count, 0);
+  auto runBodies = [n, runs](size_t run) { return make_pair(run * n / runs, (run + 1) * n / runs); };
+  jobs.parallelFor(0, runs, [&](size_t begin, size_t end) {
+    for (size_t run = begin; run < end; run++) {
+      uint32_t* counts = &run_offsets[run * cell_count];
+      auto [first_body, last_body] = runBodies(run);
+      for (uint32_t e = entry_start[first_body]; e < entry_start[last_body]; e++)
+        counts[entry_cell[e]]++;
+    }
+  }, 1);
+  // The counts become where each run starts within the cell, cell_start[c + 1] the cell's size for now
+  jobs.parallelFor(0, cell_count, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; c++) {
+      uint32_t size = 0;
+      for (size_t run = 0; run < runs; run++) {
+        uint32_t count = run_offsets[run * cell_count + c];
+        run_offsets[run * cell_count + c] = size;
+        size += count;
+      }
+      cell_start[c + 1] = size;
+    }
+  }, cells_per_block);
+  cell_start[0] = 0;
+  for (size_t c = 1; c <= cell_count; c++)
+    cell_start[c] += cell_start[c - 1];
+  jobs.parallelFor(0, runs, [&](size_t begin, size_t end) {
+    for (size_t run = begin; run < end; run++) {
+      uint32_t* offsets = &run_offsets[run * cell_count];
+      auto [first_body, last_body] = runBodies(run);
+      for (size_t i = first_body; i < last_body; i++) {
+        CellEntry entry{box_min[i], (uint32_t)i, box_max[i], 0};
+        for (uint32_t e = entry_start[i]; e < entry_start[i + 1]; e++) {
+          uint32_t cell = entry_cell[e];
+          by_cell[cell_start[cell] + offsets[cell]++] = entry;
+        }
+      }
+    }
+  }, 1);
+
+  jobs.parallelFor(0, block_pairs.size(), [&](size_t begin, size_t end) {
+    for (size_t block = begin; block < end; block++) {
+      auto& pairs = block_pairs[block];
+      pairs.clear();
+      for (size_t cell = block * cells_per_block; cell < min(cell_count, (block + 1) * cells_per_block); cell++) {
+        int cx = cell / ((size_t)cells * cells), cy = cell / cells % cells, cz = cell % cells;
+        const CellEntry* cell_end = by_cell.data() + cell_start[cell + 1];
+        for (const CellEntry* a = by_cell.data() + cell_start[cell]; a != cell_end; a++) {
+          for (const CellEntry* b = a + 1; b != cell_end; b++) {
+            // Without branching: most pairs fail one test or another, no telling which
+            bool overlap = (a->max.x >= b->min.x) & (b->max.x >= a->min.x) & (a->max.y >= b->min.y) &
+                           (b->max.y >= a->min.y) & (a->max.z >= b->min.z) & (b->max.z >= a->min.z);
+            if (!overlap)
+              continue;
+            // Both boxes are in every cell their overlap covers: only the first of those keeps the pair
+            if (cellCoord(max(a->min.x, b->min.x)) != cx || cellCoord(max(a->min.y, b->min.y)) != cy ||
+                cellCoord(max(a->min.z, b->min.z)) != cz)
+              continue;
+            pairs.push_back(a->body);
+            pairs.push_back(b->body);
+          }
+        }
+      }
+    }
+  }, 1);
+
+  size_t total = 0;
+  for (auto& pairs : block_pairs)
+    total += pairs.size() / 2;
+  first.resize(total);
+  second.resize(total);
+  size_t k = 0;
+  for (auto& pairs : block_pairs) {
+    for (size_t p = 0; p < pairs.size(); p += 2, k++) {
+      first[k] = pairs[p];
+      second[k] = pairs[p + 1];
+    }
+  }
+  last.pairs = total;
+}
+
+void PhysicsWorld::narrowphase(JobSystem& jobs) {
+  VGL_PROFILE_ZONE("narrowphase");
+  box_contacts.resize(first.size());
+  jobs.parallelFor(0, first.size(), [&](size_t begin, size_t end) {
+    vglCollideBoxes(boxes.data(), end - begin, &first[begin], &second[begin], &box_contacts[begin]);
+  }, min_pairs_per_job);
+}
+
+void PhysicsWorld::findIslands() {
+  VGL_PROFILE_ZONE("findIslands");
+  size_t n = size();
+  contacts.clear();
+  for (size_t p = 0; p < box_contacts.size(); p++) {
+    auto& found = box_contacts[p];
+    if (found.depth <= 0)
+      continue;
+    Contact c{};
+    c.a = first[p];
+    c.b = second[p];
+    c.normal = glm::vec3(found.normal[0], found.normal[1], found.normal[2]);
+    c.depth = found.depth;
+    contacts.push_back(c);
+  }
+  last.contacts = contacts.size();
+
+  for (size_t i = 0; i < n; i++)
+    parent[i] = i;
+  for (auto& c : contacts) {
+    uint32_t a = findRoot(parent, c.a), b = findRoot(parent, c.b);
+    // The smaller index is the root, so the islands come out the same whatever the order of the contacts
+    if (a != b)
+      parent[max(a, b)] = min(a, b);
+  }
+
+  // Number the islands in the order their first contact comes, then sort the contacts by island
+  fill(island_of.begin(), island_of.end(), none);
+  island_start.assign(1, 0);
+  for (auto& c : contacts) {
+    uint32_t& island = island_of[findRoot(parent, c.a)];
+    if (island == none) {
+      island = island_start.size() - 1;
+      island_start.push_back(0);
+    }
+    island_start[island + 1]++;
+  }
+  size_t islands = island_start.size() - 1;
+  last.islands = islands;
+  last.largest_island = 0;
+  for (size_t i = 0; i < islands; i++) {
+    last.largest_island = max<size_t>(last.largest_island, island_start[i + 1]);
+    island_start[i + 1] += island_start[i];
+  }
+  island_contacts.resize(contacts.size());
+  for (auto& c : contacts)
+    island_contacts[island_start[island_of[findRoot(parent, c.a)]]++] = c;
+  for (size_t i = islands; i > 0; i--)
+    island_start[i] = island_start[i - 1];
+  island_start[0] = 0;
+}
+
+void PhysicsWorld::prepare(Contact& c, float dt) const {
+  // The deepest point of each body towards the other, the contact halfway between them
+  auto support = [&](uint32_t body, glm::vec3 direction) {
+    glm::vec3 point = positions[body];
+    glm::vec3 axes[3];
+    axesOf(orientations[body], axes);
+    for (auto& axis : axes)
+      point += axis * (half_sizes[body] * softSign(glm::dot(axis, direction)));
+    return point;
+  };
+  glm::vec3 point = 0.5f * (support(c.a, c.normal) + support(c.b, -c.normal));
+  c.ra = point - positions[c.a];
+  c.rb = point - positions[c.b];
+
+  glm::vec3 relative = velocities[c.b] + glm::cross(angular_velocities[c.b], c.rb) -
+                       velocities[c.a] - glm::cross(angular_velocities[c.a], c.ra);
+  float approach = glm::dot(relative, c.normal);
+
+  auto inverseMass = [&](glm::vec3 direction) {
+    glm::vec3 ta = glm::cross(c.ra, direction), tb = glm::cross(c.rb, direction);
+    return inverse_masses[c.a] + inverse_masses[c.b] +
+           inverse_inertias[c.a] * glm::dot(ta, ta) + inverse_inertias[c.b] * glm::dot(tb, tb);
+  };
+  c.normal_mass = 1 / inverseMass(c.normal);
+
+  glm::vec3 sliding = relative - approach * c.normal;
+  float slide = glm::length(sliding);
+  if (slide > 1e-6f) {
+    c.tangent = sliding / slide;
+  } else {
+    // Any direction across the normal will do
+    glm::vec3 other = fabs(c.normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    c.tangent = glm::normalize(glm::cross(c.normal, other));
+  }
+  c.tangent_mass = 1 / inverseMass(c.tangent);
+
+  float bounce = approach < -bounce_threshold ? -cfg.restitution * approach : 0;
+  float push = position_correction / dt * max(c.depth - allowed_overlap, 0.f);
+  c.target = max(bounce, push);
+  c.normal_impulse = 0;
+  c.tangent_impulse = 0;
+}
+
+void PhysicsWorld::applyImpulses(Contact& c) {
+  auto relative = [&] {
+    return velocities[c.b] + glm::cross(angular_velocities[c.b], c.rb) -
+           velocities[c.a] - glm::cross(angular_velocities[c.a], c.ra);
+  };
+  auto apply = [&](glm::vec3 impulse) {
+    velocities[c.a] -= impulse * inverse_masses[c.a];
+    angular_velocities[c.a] -= glm::cross(c.ra, impulse) * inverse_inertias[c.a];
+    velocities[c.b] += impulse * inverse_masses[c.b];
+    angular_velocities[c.b] += glm::cross(c.rb, impulse) * inverse_inertias[c.b];
+  };
+
+  // Push apart, never pull together
+  float lambda = (c.target - glm::dot(relative(), c.normal)) * c.normal_mass;
+  float total = max(c.normal_impulse + lambda, 0.f);
+  apply(c.normal * (total - c.normal_impulse));
+  c.normal_impulse = total;
+
+  // Friction, up to the push
+  float limit = cfg.friction * c.normal_impulse;
+  lambda = -glm::dot(relative(), c.tangent) * c.tangent_mass;
+  total = clamp(c.tangent_impulse + lambda, -limit, limit);
+  apply(c.tangent * (total - c.tangent_impulse));
+  c.tangent_impulse = total;
+}
+
+void PhysicsWorld::solve(JobSystem& jobs, float dt) {
+  VGL_PROFILE_ZONE("solve");
+  jobs.parallelFor(0, island_start.size() - 1, [&](size_t begin, size_t end) {
+    for (size_t island = begin; island < end; island++) {
+      Contact* island_begin = island_contacts.data() + island_start[island];
+      Contact* island_end = island_contacts.data() + island_start[island + 1];
+      for (Contact* c = island_begin; c != island_end; c++)
+        prepare(*c, dt);
+      for (int round = 0; round < cfg.iterations; round++) {
+        for (Contact* c = island_begin; c != island_end; c++)
+          applyImpulses(*c);
+      }
+    }
+  }, min_islands_per_job);
+}
+
+void PhysicsWorld::integrate(JobSystem& jobs, float dt) {
+  VGL_PROFILE_ZONE("integrate");
+  jobs.parallelFor(0, size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      positions[i] += velocities[i] * dt;
+      glm::vec3 w = angular_velocities[i];
+      glm::quat spin(0, w.x, w.y, w.z);
+      orientations[i] = glm::normalize(orientations[i] + spin * orientations[i] * (0.5f * dt));
+
+      // Off the walls, by bounding sphere
+      float inside = bounds - radii[i];
+      for (int c = 0; c < 3; c++) {
+        if ((positions[i][c] > inside && velocities[i][c] > 0) || (positions[i][c] < -inside && velocities[i][c] < 0))
+          velocities[i][c] = -velocities[i][c];
+      }
+    }
+  }, min_bodies_per_job);
+}
+
+void PhysicsWorld::pose(JobSystem& jobs, vector<Thing>& things, vector<float>& angles) const {
+  VGL_PROFILE_ZONE("PhysicsWorld::pose");
+  angles.resize(size());
+  jobs.parallelFor(0, size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      Thing& thing = things[thing_of[i]];
+      thing.pos = positions[i];
+      glm::quat q = orientations[i];
+      // q and -q are the same rotation, the one with w >= 0 turns by 180 degrees or less
+      if (q.w < 0)
+        q = glm::quat(-q.w, -q.x, -q.y, -q.z);
+      glm::vec3 axis(q.x, q.y, q.z);
+      float s = glm::length(axis);
+      // Not turned at all, any axis does and the old one is as good as any
+      if (s > 1e-6f)
+        thing.rotation_axis = axis / s;
+      angles[thing_of[i]] = glm::degrees(2 * atan2(s, q.w));
+    }
+  }, min_bodies_per_job);
+}
@@ -0,0 +1,156 @@
+// Rigid-body dynamics for the cube things: they drift, spin, knock into each
+// other and bounce off the walls of the box they were scattered in.
+//
+// A step goes through these phases, all but the island search spread over the job system:
+//
+//   broadphase   each body's bounding box is entered into the cells of a
+//                uniform grid that it covers, the cells about as wide as the
+//                average body; bodies sharing a cell have their boxes
+//                compared, and a pair is kept by the one cell its boxes'
+//                overlap starts in, so it comes out once
+//   narrowphase  the pairs that are left go through vglCollideBoxes, the
+//                separating axis test of the two cubes, SIMD across pairs
+//   islands      the bodies in contact are joined with a union-find; each
+//                group that touches only itself is an island
+//   solve        sequential impulses, a few rounds over the contacts of each
+//                island, the islands in parallel: they share no bodies
+//   integrate    velocities into positions and orientations, walls
+//
+// There is no gravity and the walls give back all they get, so what the
+// collisions do not take out keeps the scene moving.
+
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "batch_math.h"
+#include "jobs.h"
+#include "things.h"
+
+struct PhysicsConfig {
+  // Fastest a body starts out moving, units per second, in a random direction
+  float max_speed = 1;
+  // How much of the speed at which two bodies hit they leave with, 0 to 1
+  float restitution = 0.8f;
+  // Coulomb friction between bodies
+  float friction = 0.2f;
+  // Rounds over every island's contacts per step
+  int iterations = 4;
+  // For the starting velocities
+  unsigned seed = 1;
+};
+
+// What the last step did, for the benchmark
+struct PhysicsStats {
+  // Pairs whose bounding boxes overlap, and of those the ones whose cubes do
+  size_t pairs = 0;
+  size_t contacts = 0;
+  size_t islands = 0;
+  // Contacts in the largest island: the solve cannot go faster than that one
+  size_t largest_island = 0;
+  double broadphase_ms = 0, narrowphase_ms = 0, islands_ms = 0, solve_ms = 0, integrate_ms = 0;
+};
+
+class PhysicsWorld {
+public:
+  // A body per thing, at its position and as big as its scale, spinning
+  // about its rotation axis as fast as animateThings turns it, with a random
+  // velocity on top. The walls go round the things as they are now.
+  // Throws invalid_argument if any thing has a parent.
+  explicit PhysicsWorld(const std::vector<Thing>& things, const PhysicsConfig& cfg = {});
+
+  // Advance the world by `dt` seconds. Fixed steps of 1/60 s or less keep it stable.
+  void step(JobSystem& jobs, float dt);
+
+  // The bodies as the renderer takes them: their position and rotation axis
+  // into the things, their angle about it (degrees) into `angles`, as
+  // animateThings would have. The things must be the ones the world was made from.
+  void pose(JobSystem& jobs, std::vector<Thing>& things, std::vector<float>& angles) const;
+
+  size_t size() const { return positions.size(); }
+  const PhysicsStats& stats() const { return last; }
+
+private:
+  // A pair of bodies in contact, with what the solver works out for it once per step
+  struct Contact {
+    uint32_t a, b;
+    glm::vec3 normal;
+    float depth;
+    // From the centers to the contact point
+    glm::vec3 ra, rb;
+    glm::vec3 tangent;
+    // 1 / the mass the contact sees along the normal and the tangent
+    float normal_mass, tangent_mass;
+    // Speed along the normal the bodies should part with
+    float target;
+    // Summed over the rounds, which is what the clamping goes by
+    float normal_impulse, tangent_impulse;
+  };
+
+  void broadphase(JobSystem& jobs);
+  void narrowphase(JobSystem& jobs);
+  void findIslands();
+  void solve(JobSystem& jobs, float dt);
+  void integrate(JobSystem& jobs, float dt);
+  void prepare(Contact& c, float dt) const;
+  void applyImpulses(Contact& c);
+  // Sorts the bodies by the cell they are in, so that neighbours are close in memory too
+  void reorder();
+  int cellCoord(float v) const;
+
+  PhysicsConfig cfg;
+
+  // Per body. Bodies are kept in the order of reorder(), thing_of maps them back.
+  std::vector<uint32_t> thing_of;
+  std::vector<glm::vec3> positions, velocities, angular_velocities;
+  std::vector<glm::quat> orientations;
+  std::vector<float> half_sizes, radii, inverse_masses, inverse_inertias;
+  // Rebuilt every step from the above for the narrowphase
+  std::vector<OrientedBox> boxes;
+
+  // The walls are at +-bounds on every axis
+  float bounds = 1;
+  // The grid over [-bounds, bounds], `cells` per axis
+  float inverse_cell_size = 1;
+  int cells = 1;
+  // World-space bounding box of every body
+  std::vector<glm::vec3> box_min, box_max;
+  // A body's bounding box in one of the cells it covers
+  struct CellEntry {
+    glm::vec3 min;
+    uint32_t body;
+    glm::vec3 max;
+    uint32_t unused;
+  };
+  // Body i's cells are entries entry_start[i] to entry_start[i + 1] of
+  // entry_cell; by_cell has the entries sorted by cell, with the boxes
+  // copied in so that comparing them goes through memory in order, cell c's
+  // from cell_start[c] to cell_start[c + 1]
+  std::vector<uint32_t> entry_start, entry_cell, cell_start;
+  std::vector<CellEntry> by_cell;
+  // Where each run of bodies of the counting sort goes in each cell, by run then cell
+  std::vector<uint32_t> run_offsets;
+  // The broadphase's pairs: made per block of cells, so that the order does
+  // not depend on the scheduling, then put together
+  std::vector<std::vector<uint32_t>> block_pairs;
+  std::vector<uint32_t> first, second;
+  std::vector<BoxContact> box_contacts;
+
+  std::vector<Contact> contacts;
+  // Union-find parent per body
+  std::vector<uint32_t> parent;
+  // Island i's contacts are island_contacts[island_start[i]] to island_contacts[island_start[i + 1]]
+  std::vector<uint32_t> island_of, island_start;
+  std::vector<Contact> island_contacts;
+
+  PhysicsStats last;
+  uint64_t steps = 0;
+};
+
+#endif
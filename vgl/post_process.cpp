@@ -0,0 +1,174 @@
+#include <glad/glad.h>
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "post_process.h"
+#include "vgl.h"
+
+using namespace std;
+
+namespace {
+
+const char* const post_header = R"(#version 330 core
+in vec2 tex_coords;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 source_size;
+
+)";
+
+// One pass's fragment shader: the first effect reads the source, unless it is
+// per-pixel and gets a plain texture read, the rest each take the last one's color
+string passSource(const vector<const PostEffect*>& effects) {
+  string src = post_header;
+  for (auto effect : effects)
+    src += effect->source + "\n";
+  src += "void main()\n{\n";
+  if (effects[0]->per_pixel)
+    src += "    vec4 color = texture(source, tex_coords);\n";
+  for (size_t i = 0; i < effects.size(); i++) {
+    if (effects[i]->per_pixel)
+      src += "    color = " + effects[i]->name + "(color, tex_coords);\n";
+    else
+      src += "    vec4 color = " + effects[i]->name + "(source, tex_coords);\n";
+  }
+  src += "    FragColor = color;\n}\n";
+  return src;
+}
+
+}
+
+PostEffect vglToneMapEffect() {
+  return PostEffect{"tone_map", R"(uniform float tone_map_exposure = 1.0;
+
+vec4 tone_map(vec4 color, vec2 uv)
+{
+    // Narkowicz's fit of the ACES filmic curve
+    vec3 x = color.rgb * tone_map_exposure;
+    vec3 mapped = (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+    return vec4(clamp(mapped, 0.0, 1.0), color.a);
+}
+)"};
+}
+
+PostEffect vglColorGradeEffect() {
+  return PostEffect{"color_grade", R"(uniform float grade_contrast = 1.0;
+uniform float grade_saturation = 1.0;
+
+vec4 color_grade(vec4 color, vec2 uv)
+{
+    float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+    vec3 graded = mix(vec3(luma), color.rgb, grade_saturation);
+    graded = (graded - 0.5) * grade_contrast + 0.5;
+    return vec4(graded, color.a);
+}
+)"};
+}
+
+PostEffect vglVignetteEffect() {
+  return PostEffect{"vignette", R"(uniform float vignette_strength = 0.5;
+uniform float vignette_radius = 0.75;
+
+vec4 vignette(vec4 color, vec2 uv)
+{
+    float d = length(uv - 0.5) * 1.41421356;
+    float shade = 1.0 - vignette_strength * smoothstep(vignette_radius, 1.0, d);
+    return vec4(color.rgb * shade, color.a);
+}
+)"};
+}
+
+PostEffect vglSharpenEffect() {
+  return PostEffect{"sharpen", R"(uniform float sharpen_amount = 0.5;
+
+vec4 sharpen(sampler2D source, vec2 uv)
+{
+    vec2 texel = 1.0 / source_size;
+    vec4 center = texture(source, uv);
+    vec4 around = texture(source, uv + vec2(texel.x, 0.0)) + texture(source, uv - vec2(texel.x, 0.0))
+                + texture(source, uv + vec2(0.0, texel.y)) + texture(source, uv - vec2(0.0, texel.y));
+    return center + sharpen_amount * (center - 0.25 * around);
+}
+)", false};
+}
+
+PostChain::PostChain(ResourceManager& resources, const vector<PostEffect>& effects, bool fuse) {
+  if (effects.empty())
+    throw invalid_argument{"PostChain: no effects"};
+  std::set<string> names;
+  for (auto& effect : effects)
+    if (!names.insert(effect.name).second)
+      throw invalid_argument{"PostChain: two effects called " + effect.name};
+
+  // Split into passes: a new one for every effect that reads its neighbours,
+  // and for every effect at all when not fusing
+  vector<vector<const PostEffect*>> groups;
+  for (auto& effect : effects) {
+    if (groups.empty() || !fuse || !effect.per_pixel)
+      groups.emplace_back();
+    groups.back().push_back(&effect);
+  }
+
+  for (auto& group : groups) {
+    // The key the program is shared by, see ResourceManager::loadShader
+    string key = "vgl post";
+    for (auto effect : group)
+      key += " " + effect->name;
+    Pass pass;
+    pass.pass = make_unique<FullscreenPass>(resources, key.c_str(), passSource(group));
+    GLuint program = pass.pass->program();
+    glUseProgram(program);
+    vglBindSampler(program, "source", 0);
+    pass.source_size_loc = glGetUniformLocation(program, "source_size");
+    chain.push_back(move(pass));
+  }
+}
+
+void PostChain::set(const string& uniform, float value) {
+  for (auto& u : uniforms) {
+    if (u.name == uniform) {
+      u.value = value;
+      return;
+    }
+  }
+  Uniform u{uniform, value, {}};
+  for (auto& pass : chain)
+    u.locations.push_back(glGetUniformLocation(pass.pass->program(), uniform.c_str()));
+  uniforms.push_back(move(u));
+}
+
+void PostChain::record(CommandBuffer& commands, RenderTargetPool& pool, GLuint source, int source_width, int source_height,
+                       GLuint output, int width, int height, GLenum format) {
+  GLuint input = source;
+  // The target `input` is in, back to the pool once the next pass has read it
+  RenderTarget* held = nullptr;
+  for (size_t i = 0; i < chain.size(); i++) {
+    auto& pass = *chain[i].pass;
+    RenderTarget* target = nullptr;
+    if (i + 1 < chain.size()) {
+      target = &pool.acquire(source_width, source_height, format);
+      pass.setOutput(target->framebuffer(), source_width, source_height);
+    } else {
+      pass.setOutput(output, width, height);
+    }
+
+    pass.begin(commands);
+    commands.bindTexture(0, GL_TEXTURE_2D, input);
+    if (chain[i].source_size_loc >= 0)
+      commands.uniform2f(chain[i].source_size_loc, source_width, source_height);
+    for (auto& u : uniforms)
+      if (u.locations[i] >= 0)
+        commands.uniform1f(u.locations[i], u.value);
+    pass.end(commands);
+
+    if (held)
+      pool.release(*held);
+    held = target;
+    if (target)
+      input = target->texture();
+  }
+}
@@ -0,0 +1,92 @@
+// Post-processing: a chain of effects applied to a rendered image on its way
+// to the output.
+//
+// An effect is a piece of GLSL. Most only need the pixel they are working on
+// (tone mapping, color grading, a vignette), and a run of those is fused into
+// one generated fragment shader that applies them one after the other, so the
+// run costs one full-screen read and write rather than one per effect. An
+// effect that reads around its pixel (a blur, sharpening) needs the image
+// before it finished, so it starts a new pass; the per-pixel effects after it
+// join that pass. Intermediate images live in targets from a RenderTargetPool.
+
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "command_buffer.h"
+#include "fullscreen_pass.h"
+#include "render_target.h"
+#include "resources.h"
+
+struct PostEffect {
+  // Also the name of its GLSL function, so unique within a chain
+  std::string name;
+  // Declarations and the function. A per-pixel effect defines
+  //   vec4 <name>(vec4 color, vec2 uv)
+  // which gets the color so far, the other kind
+  //   vec4 <name>(sampler2D source, vec2 uv)
+  // which reads the previous pass's result itself. uv goes from 0 to 1 across
+  // the image, `uniform vec2 source_size` is its size in texels. Uniforms
+  // should start with the effect's name, they share one namespace.
+  std::string source;
+  bool per_pixel = true;
+};
+
+// The stock effects. Their uniforms have defaults, set them with PostChain::set.
+// Exposure and an ACES fit: tone_map_exposure
+PostEffect vglToneMapEffect();
+// grade_contrast, grade_saturation, 1 leaves the image alone
+PostEffect vglColorGradeEffect();
+// Darker towards the corners: vignette_strength, vignette_radius
+PostEffect vglVignetteEffect();
+// Unsharp mask over the four neighbours, not per-pixel: sharpen_amount
+PostEffect vglSharpenEffect();
+
+class PostChain {
+public:
+  // Builds the chain's programs, fused as described above unless `fuse` is
+  // false, in which case every effect gets a pass of its own. Context thread.
+  // Throws invalid_argument for an empty chain or repeated names, and like
+  // vglBuildShader.
+  PostChain(ResourceManager& resources, const std::vector<PostEffect>& effects, bool fuse = true);
+
+  PostChain(const PostChain&) = delete;
+  PostChain& operator=(const PostChain&) = delete;
+
+  // Sets a float uniform of the effects from the next record() on. Context thread.
+  void set(const std::string& uniform, float value);
+
+  // Full-screen passes the chain takes
+  size_t passes() const { return chain.size(); }
+
+  // Records the chain reading `source`, a texture `source_width` by
+  // `source_height` texels, into `output` (0 for the window), `width` by
+  // `height` pixels. Only the last pass goes into the output, at its size;
+  // the ones before it into `format` targets from `pool` the size of the
+  // source, handed back once read. Leaves depth testing off and the output
+  // bound. Context thread, the pool may allocate.
+  void record(CommandBuffer& commands, RenderTargetPool& pool, GLuint source, int source_width, int source_height,
+              GLuint output, int width, int height, GLenum format = GL_RGBA16F);
+
+private:
+  struct Pass {
+    std::unique_ptr<FullscreenPass> pass;
+    GLint source_size_loc = -1;
+  };
+  struct Uniform {
+    std::string name;
+    float value;
+    // Where it is in each pass, -1 if it is not
+    std::vector<GLint> locations;
+  };
+
+  std::vector<Pass> chain;
+  std::vector<Uniform> uniforms;
+};
+
+#endif
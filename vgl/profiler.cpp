@@ -0,0 +1,256 @@
+#ifdef VGL_PROFILE
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+struct ZoneEvent {
+  const char* name;
+  uint64_t begin, end;
+};
+
+// Zones recorded by one thread. Only that thread writes, the exporter reads.
+// When the ring wraps around, the oldest zones are lost.
+constexpr size_t ring_size = 1 << 16;
+
+struct ThreadLog {
+  string name;
+  uint32_t tid;
+  unique_ptr<ZoneEvent[]> events{new ZoneEvent[ring_size]};
+  atomic<uint64_t> written{0};
+};
+
+// Thread logs are never freed so that zones of threads that have already
+// exited still make it into the trace.
+mutex registry_mutex;
+vector<unique_ptr<ThreadLog>> registry;
+thread_local ThreadLog* thread_log = nullptr;
+
+ThreadLog* threadLog() {
+  if (!thread_log) {
+    lock_guard<mutex> lock(registry_mutex);
+    registry.emplace_back(new ThreadLog);
+    thread_log = registry.back().get();
+    thread_log->tid = registry.size();
+    thread_log->name = "thread " + to_string(thread_log->tid);
+  }
+  return thread_log;
+}
+
+uint64_t steadyNs() {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reference point for converting ticks to nanoseconds. The tick rate is
+// derived at export time from the time elapsed since then, so no calibration
+// loop is needed at startup.
+const uint64_t start_ticks = vglProfileTicks();
+const uint64_t start_ns = steadyNs();
+
+// GPU zones. Queries are pooled per frame in a ring of gpu_latency slots; a
+// frame's slot is read back when the ring comes round to it again,
+// gpu_latency - 1 frames after it was recorded, by which point the GPU has
+// usually finished with it. If it has not, the ring waits for a later frame
+// rather than the CPU for the GPU.
+constexpr int gpu_latency = 4;
+// Resolved GPU zones, like a thread's ring: the oldest are lost when it wraps around
+constexpr size_t gpu_ring_size = 1 << 16;
+
+struct GpuZoneQueries {
+  const char* name;
+  GLuint begin, end;
+};
+
+struct GpuFrame {
+  vector<GpuZoneQueries> zones;
+  // Queries are never deleted, just handed out again once the slot comes around
+  vector<GLuint> pool;
+  size_t used = 0;
+};
+
+// GPU zone already converted to steady_clock nanoseconds
+struct GpuEvent {
+  const char* name;
+  uint64_t begin_ns, end_ns;
+};
+
+bool gpu_enabled = false;
+GpuFrame gpu_frames[gpu_latency];
+int gpu_frame = 0;
+unique_ptr<GpuEvent[]> gpu_events{new GpuEvent[gpu_ring_size]};
+uint64_t gpu_written = 0;
+// Frames the oldest slot was not done yet, so the ring did not move on
+uint64_t gpu_deferred = 0;
+// steady_clock minus GL_TIMESTAMP, refreshed every now and then because the clocks drift
+int64_t gpu_offset_ns = 0;
+uint64_t gpu_last_calibration_ns = 0;
+
+void calibrateGpuClock() {
+  GLint64 gpu_now;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+  uint64_t cpu_now = steadyNs();
+  gpu_offset_ns = (int64_t)cpu_now - gpu_now;
+  gpu_last_calibration_ns = cpu_now;
+}
+
+GLuint takeQuery(GpuFrame& frame) {
+  if (frame.used == frame.pool.size()) {
+    GLuint q;
+    glGenQueries(1, &q);
+    frame.pool.push_back(q);
+  }
+  return frame.pool[frame.used++];
+}
+
+// The GPU runs the queries in order, so when the last one is done they all are
+bool gpuFrameDone(const GpuFrame& frame) {
+  if (frame.zones.empty())
+    return true;
+  GLint available = 0;
+  glGetQueryObjectiv(frame.zones.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+  return available;
+}
+
+// Only once gpuFrameDone(), the reads would block otherwise
+void resolveGpuFrame(GpuFrame& frame) {
+  for (auto& zone : frame.zones) {
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+    gpu_events[gpu_written++ & (gpu_ring_size - 1)] = {zone.name, begin + gpu_offset_ns, end + gpu_offset_ns};
+  }
+  frame.zones.clear();
+}
+
+}
+
+void vglProfileRecord(const char* name, uint64_t begin, uint64_t end) {
+  auto log = threadLog();
+  auto n = log->written.load(memory_order_relaxed);
+  log->events[n & (ring_size - 1)] = {name, begin, end};
+  log->written.store(n + 1, memory_order_release);
+}
+
+void vglProfileSetThreadName(const char* name) {
+  auto log = threadLog();
+  lock_guard<mutex> lock(registry_mutex);
+  log->name = name;
+}
+
+GpuProfileZone::GpuProfileZone(const char* name) : index(-1) {
+  if (!gpu_enabled)
+    return;
+  auto& frame = gpu_frames[gpu_frame];
+  index = frame.zones.size();
+  GLuint begin = takeQuery(frame);
+  GLuint end = takeQuery(frame);
+  frame.zones.push_back({name, begin, end});
+  glQueryCounter(frame.zones.back().begin, GL_TIMESTAMP);
+}
+
+GpuProfileZone::~GpuProfileZone() {
+  if (index < 0)
+    return;
+  glQueryCounter(gpu_frames[gpu_frame].zones[index].end, GL_TIMESTAMP);
+}
+
+void vglProfileInitGpu() {
+  // Timer queries are core since 3.3
+  if (GLVersion.major < 3 || (GLVersion.major == 3 && GLVersion.minor < 3)) {
+    cerr << "vglProfileInitGpu: no timer queries, GPU zones are disabled\n";
+    return;
+  }
+  gpu_enabled = true;
+  calibrateGpuClock();
+}
+
+void vglProfileFrame() {
+  if (!gpu_enabled)
+    return;
+  VGL_PROFILE_ZONE("vglProfileFrame");
+
+  // The oldest slot, recorded gpu_latency - 1 frames ago. While the GPU is
+  // still on it the next frame's zones go on in the current slot.
+  int next = (gpu_frame + 1) % gpu_latency;
+  if (gpuFrameDone(gpu_frames[next])) {
+    gpu_frame = next;
+    resolveGpuFrame(gpu_frames[gpu_frame]);
+    gpu_frames[gpu_frame].used = 0;
+  } else {
+    gpu_deferred++;
+  }
+
+  if (steadyNs() - gpu_last_calibration_ns > 1000000000)
+    calibrateGpuClock();
+}
+
+bool vglProfileWriteChromeTrace(const char* path) {
+  ofstream out(path);
+  if (!out) {
+    cerr << "vglProfileWriteChromeTrace oof: cannot open " << path << '\n';
+    return false;
+  }
+
+  double ns_per_tick = 1;
+  uint64_t elapsed_ticks = vglProfileTicks() - start_ticks;
+  if (elapsed_ticks > 0)
+    ns_per_tick = (double)(steadyNs() - start_ns) / elapsed_ticks;
+  auto tickToUs = [&](uint64_t ticks) { return (int64_t)(ticks - start_ticks) * ns_per_tick / 1000.; };
+  auto nsToUs = [&](uint64_t ns) { return ((int64_t)ns - (int64_t)start_ns) / 1000.; };
+
+  out.precision(3);
+  out << fixed << "{\"traceEvents\":[\n";
+  bool first = true;
+  auto separator = [&]() -> ostream& {
+    if (!first)
+      out << ",\n";
+    first = false;
+    return out;
+  };
+
+  separator() << R"({"ph":"M","pid":1,"name":"process_name","args":{"name":"vgl"}})";
+
+  lock_guard<mutex> lock(registry_mutex);
+  for (auto& log : registry) {
+    separator() << R"({"ph":"M","pid":1,"tid":)" << log->tid
+                << R"(,"name":"thread_name","args":{"name":")" << log->name << "\"}}";
+    uint64_t written = log->written.load(memory_order_acquire);
+    uint64_t first_event = written > ring_size ? written - ring_size : 0;
+    for (uint64_t i = first_event; i < written; i++) {
+      auto& e = log->events[i & (ring_size - 1)];
+      separator() << R"({"ph":"X","pid":1,"tid":)" << log->tid << R"(,"name":")" << e.name
+                  << R"(","ts":)" << tickToUs(e.begin) << R"(,"dur":)" << tickToUs(e.end) - tickToUs(e.begin) << '}';
+    }
+  }
+
+  if (gpu_enabled) {
+    // The GPU gets its own track so that passes line up under the CPU work that issued them
+    constexpr int gpu_tid = 0;
+    separator() << R"({"ph":"M","pid":1,"tid":)" << gpu_tid << R"(,"name":"thread_name","args":{"name":"GPU"}})";
+    uint64_t first_event = gpu_written > gpu_ring_size ? gpu_written - gpu_ring_size : 0;
+    for (uint64_t i = first_event; i < gpu_written; i++) {
+      auto& e = gpu_events[i & (gpu_ring_size - 1)];
+      separator() << R"({"ph":"X","pid":1,"tid":)" << gpu_tid << R"(,"name":")" << e.name
+                  << R"(","ts":)" << nsToUs(e.begin_ns) << R"(,"dur":)" << (e.end_ns - e.begin_ns) / 1000. << '}';
+    }
+  }
+
+  out << "\n],\n\"otherData\":{\"gpu_deferred_frames\":" << gpu_deferred << "}}\n";
+  return (bool)out;
+}
+
+#endif
@@ -0,0 +1,95 @@
+// Scoped CPU/GPU profiler with Chrome trace export.
+//
+// Everything here is compiled out unless VGL_PROFILE is defined (make PROFILE=1),
+// otherwise the macros below expand to nothing and cost nothing.
+//
+//   VGL_PROFILE_ZONE("name")       time the enclosing scope on the CPU
+//   VGL_PROFILE_GPU_ZONE("name")   time the GL commands issued in the enclosing scope
+//   VGL_PROFILE_THREAD("name")     name the calling thread in the trace
+//   VGL_PROFILE_GPU_INIT()         once the GL context is current
+//   VGL_PROFILE_FRAME()            once per frame, after the swap: collects finished GPU zones
+//   VGL_PROFILE_EXPORT("file")     write everything recorded so far as a Chrome trace
+//
+// Zone names must be string literals (only the pointer is kept).
+// The resulting JSON loads in chrome://tracing and in Perfetto (ui.perfetto.dev).
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef VGL_PROFILE
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// CPU timestamp in whatever unit is cheapest to read. Converted to nanoseconds on export.
+inline uint64_t vglProfileTicks() {
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(VGL_PROFILE_STEADY_CLOCK)
+  // Assumes an invariant TSC, which every x86 CPU of the last decade has
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Appends a finished zone to the calling thread's ring buffer
+void vglProfileRecord(const char* name, uint64_t begin, uint64_t end);
+
+class ProfileZone {
+public:
+  explicit ProfileZone(const char* name) : name(name), begin(vglProfileTicks()) {}
+  ~ProfileZone() { vglProfileRecord(name, begin, vglProfileTicks()); }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  const char* name;
+  uint64_t begin;
+};
+
+// Brackets the scope with GL_TIMESTAMP queries. Results are read back a few
+// frames later by vglProfileFrame(), so the CPU never waits for the GPU.
+// Must be used on the thread that owns the GL context.
+class GpuProfileZone {
+public:
+  explicit GpuProfileZone(const char* name);
+  ~GpuProfileZone();
+
+  GpuProfileZone(const GpuProfileZone&) = delete;
+  GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+  int index;
+};
+
+void vglProfileSetThreadName(const char* name);
+void vglProfileInitGpu();
+void vglProfileFrame();
+bool vglProfileWriteChromeTrace(const char* path);
+
+#define VGL_PROFILE_CONCAT_(a, b) a##b
+#define VGL_PROFILE_CONCAT(a, b) VGL_PROFILE_CONCAT_(a, b)
+#define VGL_PROFILE_ZONE(name) ProfileZone VGL_PROFILE_CONCAT(vgl_profile_zone_, __LINE__){name}
+#define VGL_PROFILE_GPU_ZONE(name) GpuProfileZone VGL_PROFILE_CONCAT(vgl_profile_gpu_zone_, __LINE__){name}
+#define VGL_PROFILE_THREAD(name) vglProfileSetThreadName(name)
+#define VGL_PROFILE_GPU_INIT() vglProfileInitGpu()
+#define VGL_PROFILE_FRAME() vglProfileFrame()
+#define VGL_PROFILE_EXPORT(path) vglProfileWriteChromeTrace(path)
+
+#else
+
+#define VGL_PROFILE_ZONE(name) do {} while (0)
+#define VGL_PROFILE_GPU_ZONE(name) do {} while (0)
+#define VGL_PROFILE_THREAD(name) do {} while (0)
+#define VGL_PROFILE_GPU_INIT() do {} while (0)
+#define VGL_PROFILE_FRAME() do {} while (0)
+#define VGL_PROFILE_EXPORT(path) false
+
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstring>
+#include <utility>
+
+#include "radix_sort.h"
+
+void vglRadixSort(size_t n, uint32_t* keys, uint32_t* values, uint32_t* scratch_keys, uint32_t* scratch_values) {
+  size_t counts[4][256] = {};
+  for (size_t i = 0; i < n; i++) {
+    uint32_t key = keys[i];
+    counts[0][key & 0xff]++;
+    counts[1][key >> 8 & 0xff]++;
+    counts[2][key >> 16 & 0xff]++;
+    counts[3][key >> 24]++;
+  }
+
+  uint32_t *from_keys = keys, *from_values = values, *to_keys = scratch_keys, *to_values = scratch_values;
+  for (int pass = 0; pass < 4; pass++) {
+    size_t* count = counts[pass];
+    int shift = pass * 8;
+    // Every key has the same byte here, the order stays as it is
+    if (n == 0 || count[from_keys[0] >> shift & 0xff] == n)
+      continue;
+    // Counts to where each bucket starts
+    size_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+      size_t c = count[b];
+      count[b] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint32_t key = from_keys[i];
+      size_t to = count[key >> shift & 0xff]++;
+      to_keys[to] = key;
+      to_values[to] = from_values[i];
+    }
+    std::swap(from_keys, to_keys);
+    std::swap(from_values, to_values);
+  }
+  // An odd number of passes left the result in the scratch arrays
+  if (from_keys != keys) {
+    memcpy(keys, from_keys, n * sizeof(uint32_t));
+    memcpy(values, from_values, n * sizeof(uint32_t));
+  }
+}
@@ -0,0 +1,28 @@
+// Radix sort of 32-bit keys carrying 32-bit values, for sorting draws by depth every frame.
+//
+// Four passes of 8 bits, least significant first, each a histogram and a
+// scatter, so the cost is linear in the count whatever the keys. The
+// histograms of all four passes are taken in one read of the keys, and a pass
+// whose byte is the same in every key is skipped: depths of a scene in front
+// of the camera often share their top byte.
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Sorts the `n` keys ascending and moves the values with them. Stable.
+// `scratch_keys` and `scratch_values` are `n` long and end up holding garbage.
+void vglRadixSort(size_t n, uint32_t* keys, uint32_t* values, uint32_t* scratch_keys, uint32_t* scratch_values);
+
+// A key that sorts like the float does, negative numbers included
+inline uint32_t vglFloatKey(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  // Negative: flip everything, so larger magnitudes come first. Positive: set the sign bit.
+  return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "render_target.h"
+
+using namespace std;
+
+RenderTarget::RenderTarget(ResourceManager& resources, string label, bool depth, GLenum format)
+  : resources(resources), label(move(label)), has_depth(depth), color_format(format) {}
+
+void RenderTarget::resize(int width, int height) {
+  if (*this && width == target_width && height == target_height)
+    return;
+  release();
+
+  color = resources.createTexture(GL_TEXTURE_2D, label.c_str());
+  // No pixels to upload, any type the format takes will do
+  GLenum type = color_format == GL_RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+  glTexImage2D(GL_TEXTURE_2D, 0, color_format, width, height, 0, GL_RGBA, type, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (has_depth) {
+    string depth_label = label + " depth";
+    depth = resources.createTexture(GL_TEXTURE_2D, depth_label.c_str());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+
+  framebuffer_handle = resources.createFramebuffer(label.c_str());
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.get(color), 0);
+  if (has_depth)
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, resources.get(depth), 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  target_width = width;
+  target_height = height;
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    release();
+    throw runtime_error{label + " is incomplete, status " + to_string(status)};
+  }
+}
+
+void RenderTarget::release() {
+  resources.release(framebuffer_handle);
+  resources.release(color);
+  resources.release(depth);
+  framebuffer_handle = {};
+  color = {};
+  depth = {};
+  target_width = target_height = 0;
+}
+
+RenderTargetPool::RenderTargetPool(ResourceManager& resources, int keep_frames)
+  : resources(resources), keep_frames(keep_frames) {}
+
+RenderTarget& RenderTargetPool::acquire(int width, int height, GLenum format) {
+  for (auto& entry : entries) {
+    auto& target = entry->target;
+    if (!entry->out && target.width() == width && target.height() == height && target.format() == format) {
+      entry->out = true;
+      entry->last_frame = frame;
+      return target;
+    }
+  }
+  entries.push_back(make_unique<Entry>(resources, format));
+  auto& entry = *entries.back();
+  entry.target.resize(width, height);
+  entry.out = true;
+  entry.last_frame = frame;
+  allocated++;
+  return entry.target;
+}
+
+void RenderTargetPool::release(RenderTarget& target) {
+  for (auto& entry : entries) {
+    if (&entry->target == &target) {
+      entry->out = false;
+      return;
+    }
+  }
+  throw invalid_argument{"RenderTargetPool: the target is not from this pool"};
+}
+
+void RenderTargetPool::endFrame() {
+  frame++;
+  entries.erase(remove_if(entries.begin(), entries.end(), [this](const unique_ptr<Entry>& entry) {
+    return !entry->out && frame - entry->last_frame > (uint64_t)keep_frames;
+  }), entries.end());
+}
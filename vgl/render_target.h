@@ -0,0 +1,96 @@
+// Off-screen render targets: a framebuffer with a color texture and, if
+// asked for, a depth buffer, owned through a ResourceManager. And a pool of
+// them for results that only live for a few passes.
+
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resources.h"
+
+class RenderTarget {
+public:
+  // Nothing is allocated until resize(). `label` shows up in GL debug output,
+  // `format` is the internal format of the color texture.
+  RenderTarget(ResourceManager& resources, std::string label, bool depth, GLenum format = GL_RGBA8);
+  ~RenderTarget() { release(); }
+
+  RenderTarget(const RenderTarget&) = delete;
+  RenderTarget& operator=(const RenderTarget&) = delete;
+
+  // Allocates the target at `width` by `height`, or again at a new size.
+  // The old storage is released to the ResourceManager, so frames in flight
+  // can still read it. Leaves GL_FRAMEBUFFER bound to 0. Throws
+  // runtime_error if the driver cannot make a complete framebuffer. Context thread.
+  void resize(int width, int height);
+  // Lets go of the storage
+  void release();
+
+  explicit operator bool() const { return (bool)framebuffer_handle; }
+  // 0 when not allocated
+  GLuint framebuffer() const { return resources.get(framebuffer_handle); }
+  // Linear filtering, clamped to the edge
+  GLuint texture() const { return resources.get(color); }
+  GLenum format() const { return color_format; }
+  int width() const { return target_width; }
+  int height() const { return target_height; }
+
+private:
+  ResourceManager& resources;
+  std::string label;
+  bool has_depth;
+  GLenum color_format;
+
+  FramebufferHandle framebuffer_handle;
+  TextureHandle color, depth;
+  int target_width = 0, target_height = 0;
+};
+
+// Render targets shared out by size and format. A chain of passes takes a
+// target for every intermediate result and hands it back as soon as the next
+// pass has read it, so two targets do for any number of passes, and the same
+// ones serve the next frame. Context thread.
+class RenderTargetPool {
+public:
+  // Targets nobody acquired for `keep_frames` frames are freed
+  explicit RenderTargetPool(ResourceManager& resources, int keep_frames = 3);
+
+  RenderTargetPool(const RenderTargetPool&) = delete;
+  RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+  // A target of that size and color format that is not out already, without
+  // depth. Allocated only if there is none.
+  RenderTarget& acquire(int width, int height, GLenum format);
+  // Hands a target from acquire() back, later acquire() calls can have it
+  // straight away: the GL orders the passes that write it after those that read it.
+  void release(RenderTarget& target);
+  // Once per frame, frees what has been idle too long
+  void endFrame();
+
+  // Targets allocated now, and over the pool's life
+  size_t size() const { return entries.size(); }
+  uint64_t allocations() const { return allocated; }
+
+private:
+  struct Entry {
+    Entry(ResourceManager& resources, GLenum format) : target(resources, "pooled target", false, format) {}
+
+    RenderTarget target;
+    bool out = false;
+    uint64_t last_frame = 0;
+  };
+
+  ResourceManager& resources;
+  int keep_frames;
+  std::vector<std::unique_ptr<Entry>> entries;
+  uint64_t frame = 0;
+  uint64_t allocated = 0;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <glad/glad.h>
+
+#include <string>
+
+#include "gl_debug.h"
+#include "profiler.h"
+#include "resources.h"
+#include "vgl.h"
+
+using namespace std;
+
+ShaderHandle ResourceManager::loadShader(const char* vertex_file_name, const char* fragment_file_name) {
+  auto& shaders = std::get<ResourcePool<ShaderTag>>(pools);
+  // Neither name can contain a newline, so the key is unambiguous
+  string key = string{vertex_file_name} + '\n' + fragment_file_name;
+  if (auto handle = shaders.find(key))
+    return handle;
+  return shaders.insert(vglBuildShaderFromFile(vertex_file_name, fragment_file_name), move(key));
+}
+
+ShaderHandle ResourceManager::loadShader(const char* vertex_file_name, const char* fragment_file_name,
+                                        const string& vertex_src, const string& fragment_src) {
+  auto& shaders = std::get<ResourcePool<ShaderTag>>(pools);
+  string key = string{vertex_file_name} + '\n' + fragment_file_name;
+  if (auto handle = shaders.find(key))
+    return handle;
+  string label = string{vertex_file_name} + " + " + fragment_file_name;
+  return shaders.insert(vglBuildShader(vertex_src.c_str(), fragment_src.c_str(), label.c_str()), move(key));
+}
+
+TextureHandle ResourceManager::loadTexture(const char* path, GLenum format) {
+  auto& textures = std::get<ResourcePool<TextureTag>>(pools);
+  if (auto handle = textures.find(path))
+    return handle;
+  return textures.insert(vglTextureFromFile(path, format), path);
+}
+
+TextureHandle ResourceManager::loadTexture(const char* path, const DecodedImage& image, GLenum format) {
+  auto& textures = std::get<ResourcePool<TextureTag>>(pools);
+  if (auto handle = textures.find(path))
+    return handle;
+  return textures.insert(vglTextureFromImage(image, format, path), path);
+}
+
+BufferHandle ResourceManager::createBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage, const char* label) {
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(target, buffer);
+  glBufferData(target, size, data, usage);
+  if (label)
+    VGL_GL_LABEL(GL_BUFFER, buffer, label);
+  return std::get<ResourcePool<BufferTag>>(pools).insert(buffer);
+}
+
+VertexArrayHandle ResourceManager::createVertexArray(const char* label) {
+  GLuint vao;
+  glGenVertexArrays(1, &vao);
+  // Has to be bound once before it can be labelled
+  glBindVertexArray(vao);
+  if (label)
+    VGL_GL_LABEL(GL_VERTEX_ARRAY, vao, label);
+  return std::get<ResourcePool<VertexArrayTag>>(pools).insert(vao);
+}
+
+TextureHandle ResourceManager::createTexture(GLenum target, const char* label) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(target, texture);
+  if (label)
+    VGL_GL_LABEL(GL_TEXTURE, texture, label);
+  return std::get<ResourcePool<TextureTag>>(pools).insert(texture);
+}
+
+FramebufferHandle ResourceManager::createFramebuffer(const char* label) {
+  GLuint framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  if (label)
+    VGL_GL_LABEL(GL_FRAMEBUFFER, framebuffer, label);
+  return std::get<ResourcePool<FramebufferTag>>(pools).insert(framebuffer);
+}
+
+void ResourceManager::collect() {
+  VGL_PROFILE_ZONE("ResourceManager::collect");
+  if (!released.empty()) {
+    batches.push_back(Batch{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), move(released)});
+    released.clear();
+  }
+  // Fences signal in order, so stop at the first one still pending
+  while (!batches.empty()) {
+    auto& batch = batches.front();
+    GLenum status = glClientWaitSync(batch.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    for (auto& item : batch.items)
+      item.destroy(item.name);
+    glDeleteSync(batch.fence);
+    batches.pop_front();
+  }
+}
+
+void ResourceManager::destroyAll() {
+  for (auto& item : released)
+    item.destroy(item.name);
+  released.clear();
+  for (auto& batch : batches) {
+    for (auto& item : batch.items)
+      item.destroy(item.name);
+    glDeleteSync(batch.fence);
+  }
+  batches.clear();
+  apply([](auto&... pool) { (pool.destroyAll(), ...); }, pools);
+}
+
+size_t ResourceManager::retiring() const {
+  size_t count = released.size();
+  for (auto& batch : batches)
+    count += batch.items.size();
+  return count;
+}
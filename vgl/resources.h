@@ -0,0 +1,248 @@
+// GL objects owned by a ResourceManager and addressed by 32-bit handles.
+//
+// A handle packs the index of a slot in the manager's table with the
+// generation of that slot when the handle was issued. Destroying a resource
+// moves its slot to the next generation, so stale handles resolve to 0
+// instead of to whatever GL object reuses the name. Resolving a handle is one
+// bounds check and one compare on a small contiguous slot, cheap enough for
+// the render loop.
+//
+// Resources are reference counted. Loading the same file(s) again returns the
+// resource already loaded. When the last reference is released the GL object
+// is deleted only after the GPU has finished the frames that may still use
+// it, see ResourceManager::collect().
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+struct DecodedImage;
+
+template <class Tag>
+struct Handle {
+  static constexpr uint32_t index_bits = 20;
+  static constexpr uint32_t max_generation = (1u << (32 - index_bits)) - 1;
+
+  // Generations start at 1, so the all-zero handle never resolves
+  uint32_t bits = 0;
+
+  uint32_t index() const { return bits & ((1u << index_bits) - 1); }
+  uint32_t generation() const { return bits >> index_bits; }
+  explicit operator bool() const { return bits != 0; }
+  bool operator==(Handle other) const { return bits == other.bits; }
+  bool operator!=(Handle other) const { return bits != other.bits; }
+};
+
+struct ShaderTag {
+  static void destroy(GLuint name) { glDeleteProgram(name); }
+};
+struct TextureTag {
+  static void destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+struct BufferTag {
+  static void destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+struct VertexArrayTag {
+  static void destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+struct FramebufferTag {
+  static void destroy(GLuint name) { glDeleteFramebuffers(1, &name); }
+};
+
+using ShaderHandle = Handle<ShaderTag>;
+using TextureHandle = Handle<TextureTag>;
+using BufferHandle = Handle<BufferTag>;
+using VertexArrayHandle = Handle<VertexArrayTag>;
+using FramebufferHandle = Handle<FramebufferTag>;
+
+// The table behind one kind of handle. Freed slots are reused, most recently freed first.
+template <class Tag>
+class ResourcePool {
+public:
+  // Takes ownership of `name` with a reference count of 1. `key` is what
+  // find() looks it up by, empty for resources that are not shared.
+  Handle<Tag> insert(GLuint name, std::string key = {}) {
+    uint32_t index;
+    if (!free_slots.empty()) {
+      index = free_slots.back();
+      free_slots.pop_back();
+    } else {
+      if (slots.size() >= (1u << Handle<Tag>::index_bits))
+        throw std::length_error{"ResourcePool: out of handles"};
+      index = slots.size();
+      slots.push_back(Slot{0, 1, 0});
+      keys.emplace_back();
+    }
+    auto& slot = slots[index];
+    slot.name = name;
+    slot.refs = 1;
+    Handle<Tag> handle{slot.generation << Handle<Tag>::index_bits | index};
+    if (!key.empty())
+      by_key[key] = handle;
+    keys[index] = std::move(key);
+    return handle;
+  }
+
+  // The GL name, or 0 if the handle is stale
+  GLuint get(Handle<Tag> handle) const {
+    uint32_t index = handle.index();
+    if (index >= slots.size() || slots[index].generation != handle.generation())
+      return 0;
+    return slots[index].name;
+  }
+
+  // The resource loaded from `key` with one more reference, or a null handle
+  Handle<Tag> find(const std::string& key) {
+    auto it = by_key.find(key);
+    if (it == by_key.end())
+      return {};
+    retain(it->second);
+    return it->second;
+  }
+
+  bool retain(Handle<Tag> handle) {
+    if (!get(handle))
+      return false;
+    slots[handle.index()].refs++;
+    return true;
+  }
+
+  // Drops a reference. When it was the last one the slot is freed, its
+  // generation moves on, and the GL name to delete is returned. Otherwise 0.
+  GLuint release(Handle<Tag> handle) {
+    if (!get(handle))
+      return 0;
+    uint32_t index = handle.index();
+    auto& slot = slots[index];
+    if (--slot.refs > 0)
+      return 0;
+    GLuint name = slot.name;
+    slot.name = 0;
+    slot.generation = nextGeneration(slot.generation);
+    if (!keys[index].empty()) {
+      by_key.erase(keys[index]);
+      keys[index].clear();
+    }
+    free_slots.push_back(index);
+    return name;
+  }
+
+  // Deletes every live resource right away. The slots are kept and move on a
+  // generation like in release(), so no handle from before resolves again.
+  void destroyAll() {
+    for (uint32_t index = 0; index < slots.size(); index++) {
+      auto& slot = slots[index];
+      if (!slot.refs)
+        continue;
+      if (slot.name)
+        Tag::destroy(slot.name);
+      slot.name = 0;
+      slot.refs = 0;
+      slot.generation = nextGeneration(slot.generation);
+      keys[index].clear();
+      free_slots.push_back(index);
+    }
+    by_key.clear();
+  }
+
+  size_t size() const { return slots.size() - free_slots.size(); }
+
+private:
+  static uint32_t nextGeneration(uint32_t generation) {
+    return generation == Handle<Tag>::max_generation ? 1 : generation + 1;
+  }
+
+  // What the hot path reads, kept small and together
+  struct Slot {
+    GLuint name;
+    uint32_t generation;
+    uint32_t refs;
+  };
+
+  std::vector<Slot> slots;
+  // Cold: only needed when a shared resource goes away
+  std::vector<std::string> keys;
+  std::vector<uint32_t> free_slots;
+  std::unordered_map<std::string, Handle<Tag>> by_key;
+};
+
+class ResourceManager {
+public:
+  ResourceManager() = default;
+  // Does not touch GL, the context may be gone by now. Call destroyAll() before that.
+  ~ResourceManager() = default;
+
+  ResourceManager(const ResourceManager&) = delete;
+  ResourceManager& operator=(const ResourceManager&) = delete;
+
+  // Shared by file names: loading the same pair again returns the same program
+  ShaderHandle loadShader(const char* vertex_file_name, const char* fragment_file_name);
+  // Shared by path
+  TextureHandle loadTexture(const char* path, GLenum format);
+  // The same with the files already read or decoded, off the context thread say.
+  // The names are only the keys, the files are not opened again.
+  ShaderHandle loadShader(const char* vertex_file_name, const char* fragment_file_name,
+                          const std::string& vertex_src, const std::string& fragment_src);
+  TextureHandle loadTexture(const char* path, const DecodedImage& image, GLenum format);
+  // Never shared. `label` only shows up in GL debug output.
+  BufferHandle createBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage, const char* label = nullptr);
+  VertexArrayHandle createVertexArray(const char* label = nullptr);
+  // An empty texture, left bound to `target` on the active unit for the caller to set up
+  TextureHandle createTexture(GLenum target, const char* label = nullptr);
+  // Left bound to GL_FRAMEBUFFER, without attachments
+  FramebufferHandle createFramebuffer(const char* label = nullptr);
+
+  // The GL name behind a handle, 0 for a stale or null handle
+  template <class Tag>
+  GLuint get(Handle<Tag> handle) const { return std::get<ResourcePool<Tag>>(pools).get(handle); }
+
+  // Hands out another reference. False if the handle is stale.
+  template <class Tag>
+  bool retain(Handle<Tag> handle) { return std::get<ResourcePool<Tag>>(pools).retain(handle); }
+
+  // Drops a reference. The handle stops resolving once the last one is gone,
+  // the GL object itself goes in collect() once the GPU is done with it.
+  template <class Tag>
+  void release(Handle<Tag> handle) {
+    if (GLuint name = std::get<ResourcePool<Tag>>(pools).release(handle))
+      released.push_back(Retired{Tag::destroy, name});
+  }
+
+  // Once per frame, after the frame's commands are issued: fences what was
+  // released during the frame, and deletes the objects whose fence the GPU has passed.
+  void collect();
+
+  // Deletes everything now, live or waiting for the GPU. The context must be current.
+  void destroyAll();
+
+  // GL objects released but not deleted yet
+  size_t retiring() const;
+
+private:
+  struct Retired {
+    void (*destroy)(GLuint);
+    GLuint name;
+  };
+  struct Batch {
+    GLsync fence;
+    std::vector<Retired> items;
+  };
+
+  std::tuple<ResourcePool<ShaderTag>, ResourcePool<TextureTag>, ResourcePool<BufferTag>, ResourcePool<VertexArrayTag>,
+             ResourcePool<FramebufferTag>> pools;
+  // Released since the last collect()
+  std::vector<Retired> released;
+  // Waiting for their fence, oldest first
+  std::deque<Batch> batches;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "profiler.h"
+#include "scene_graph.h"
+
+using namespace std;
+
+namespace {
+
+// A node is one affine multiply or none, a job needs thousands
+constexpr size_t min_nodes_per_job = 4096;
+
+}
+
+SceneGraph::SceneGraph(const vector<Thing>& things)
+  : parents(things.size()), level_start{0}, local(things.size()), world(things.size()),
+    // Everything counts as changed for the first update()
+    changed(things.size(), 1) {
+  vector<uint32_t> level(things.size());
+  for (size_t i = 0; i < things.size(); i++) {
+    int32_t parent = things[i].parent;
+    if (parent >= (int32_t)i)
+      throw invalid_argument{"SceneGraph: thing " + to_string(i) + " comes before its parent"};
+    parents[i] = parent < 0 ? -1 : parent;
+    level[i] = parent < 0 ? 0 : level[parent] + 1;
+    if (i > 0 && level[i] < level[i - 1])
+      throw invalid_argument{"SceneGraph: thing " + to_string(i) + " comes after a level below its own"};
+    while (level_start.size() <= level[i])
+      level_start.push_back(i);
+  }
+  level_start.push_back(things.size());
+}
+
+void SceneGraph::setLocals(size_t first, size_t count, const AffineTransform* locals) {
+  for (size_t k = 0; k < count; k++) {
+    size_t i = first + k;
+    if (memcmp(&local[i], &locals[k], sizeof(AffineTransform)) != 0) {
+      local[i] = locals[k];
+      changed[i] = pass + 1;
+    }
+  }
+}
+
+void SceneGraph::update(JobSystem& jobs) {
+  VGL_PROFILE_ZONE("SceneGraph::update");
+  pass++;
+  atomic<size_t> updated{0};
+  for (size_t l = 0; l < levels(); l++) {
+    jobs.parallelFor(level_start[l], level_start[l + 1], [&](size_t begin, size_t end) {
+      size_t n = 0;
+      // Siblings next to each other go through the multiply together
+      for (size_t i = begin; i < end;) {
+        int32_t parent = parents[i];
+        size_t run = i + 1;
+        while (run < end && parents[run] == parent)
+          run++;
+        if (parent >= 0 && changed[parent] == pass) {
+          vglMultiplyAffine(world[parent], run - i, &local[i], &world[i]);
+          for (size_t k = i; k < run; k++)
+            changed[k] = pass;
+          n += run - i;
+        } else {
+          for (size_t k = i; k < run; k++) {
+            if (changed[k] != pass)
+              continue;
+            if (parent < 0)
+              world[k] = local[k];
+            else
+              vglMultiplyAffine(world[parent], 1, &local[k], &world[k]);
+            n++;
+          }
+        }
+        i = run;
+      }
+      updated += n;
+    }, min_nodes_per_job);
+  }
+  last_updated = updated;
+}
@@ -0,0 +1,60 @@
+// Transform hierarchy: things attached to other things (see Thing::parent)
+// move, turn and scale with them.
+//
+// There are no node objects and no pointers. The nodes are the things, in
+// their order, which has to be breadth first: a node comes after its parent
+// and every level after the whole level above. The local and world
+// transforms are arrays in that order, so working them out is one pass
+// forward, level by level, that always finds the parent's world transform
+// done. The nodes of a level never depend on each other, so each level is
+// spread over the job system.
+//
+// Only what changed is worked out again: setLocals() marks the nodes whose
+// local transform is not what it was, and update() takes a node's world
+// transform as it was unless the node or its parent was marked, marking it
+// in turn. A subtree that did not move costs a look at its marks.
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "batch_math.h"
+#include "jobs.h"
+#include "things.h"
+
+class SceneGraph {
+public:
+  // A node per thing, attached as their `parent` says. Throws
+  // invalid_argument if the things are not in breadth-first order.
+  explicit SceneGraph(const std::vector<Thing>& things);
+
+  size_t size() const { return parents.size(); }
+  // 1 for things without parents, 2 if some have, and so on
+  size_t levels() const { return level_start.size() - 1; }
+
+  // Set the local transforms of nodes `first` to `first + count`, relative
+  // to their parents. Jobs may set ranges that do not overlap at the same time.
+  void setLocals(size_t first, size_t count, const AffineTransform* locals);
+  // Bring the world transforms up to date with the locals set since last time
+  void update(JobSystem& jobs);
+
+  // A node's transform relative to the world, as of the last update()
+  const AffineTransform* worlds() const { return world.data(); }
+  // How many world transforms the last update() worked out again
+  size_t updated() const { return last_updated; }
+
+private:
+  std::vector<int32_t> parents;
+  // Level l's nodes are level_start[l] to level_start[l + 1]
+  std::vector<uint32_t> level_start;
+  std::vector<AffineTransform> local, world;
+  // The update() a node changed for: marks that never need clearing
+  std::vector<uint32_t> changed;
+  uint32_t pass = 0;
+  size_t last_updated = 0;
+};
+
+#endif
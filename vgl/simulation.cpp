@@ -0,0 +1,136 @@
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "controls.h"
+#include "profiler.h"
+#include "simulation.h"
+
+using namespace std;
+
+namespace {
+
+// If the simulation falls further behind than this it drops time instead of
+// trying to catch up, otherwise one slow step would snowball into a stall.
+constexpr int max_catch_up_steps = 5;
+
+float lerpAngle(float a, float b, float alpha) {
+  // Angles only grow, so going backwards means b wrapped around 360
+  if (b < a)
+    b += 360;
+  return fmod(a + (b - a) * alpha, 360.f);
+}
+
+}
+
+Simulation::Simulation(CameraState& cam, const vector<Thing>& things, double rate_hz, InputReplay* replay)
+  : cam(cam), things(things), step_seconds(1. / rate_hz), replay(replay) {
+  // Publish an initial state so that sample() has something to work with before the first step
+  step(glfwGetTime());
+  previous = working;
+  current = working;
+}
+
+Simulation::~Simulation() {
+  stop();
+}
+
+void Simulation::start() {
+  if (running.exchange(true))
+    return;
+  thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+  if (!running.exchange(false))
+    return;
+  thread.join();
+}
+
+void Simulation::run() {
+  VGL_PROFILE_THREAD("simulation");
+
+  using clock = chrono::steady_clock;
+  auto step_duration = chrono::duration_cast<clock::duration>(chrono::duration<double>(step_seconds));
+  auto next = clock::now();
+  double t = current.time;
+
+  while (running.load(memory_order_relaxed)) {
+    auto now = clock::now();
+    int steps = 0;
+    while (next <= now && steps < max_catch_up_steps) {
+      t += step_seconds;
+      step(t);
+      {
+        lock_guard<mutex> lock(snapshot_mutex);
+        swap(previous, current);
+        swap(current, working);
+      }
+      next += step_duration;
+      steps++;
+    }
+    if (steps == max_catch_up_steps) {
+      // Give up on the lost time
+      next = now + step_duration;
+      t = glfwGetTime();
+    }
+    this_thread::sleep_until(next);
+  }
+}
+
+void Simulation::step(double t) {
+  VGL_PROFILE_ZONE("simulate");
+
+  double input_time = t;
+  if (replay) {
+    input_time = replay_time;
+    replay->feed(replay_time, cam);
+    replay_time += step_seconds;
+  }
+  handleKeys(cam, input_time, step_seconds);
+  animateThings(things, t, working.angles);
+
+  working.time = t;
+  lock_guard<mutex> lock(cam.input_mutex);
+  working.cam_pos = cam.position();
+  working.cam_orientation = cam.orientation();
+  working.fov = cam.fov();
+  working.zNear = cam.zNear();
+  working.aspect_ratio = cam.aspectRatio();
+}
+
+void Simulation::sample(double now, SimSnapshot& out) {
+  VGL_PROFILE_ZONE("Simulation::sample");
+  lock_guard<mutex> lock(snapshot_mutex);
+
+  float alpha = 1;
+  if (current.time > previous.time)
+    alpha = clamp((now - current.time) / (current.time - previous.time), 0., 1.);
+
+  out.time = previous.time + (current.time - previous.time) * alpha;
+  out.angles.resize(current.angles.size());
+  for (size_t i = 0; i < out.angles.size(); i++)
+    out.angles[i] = lerpAngle(previous.angles[i], current.angles[i], alpha);
+
+  // A camera that stood still comes out bit for bit the same, so that the render camera's version does not move
+  out.cam_pos = previous.cam_pos == current.cam_pos ? current.cam_pos : glm::mix(previous.cam_pos, current.cam_pos, alpha);
+  out.cam_orientation = previous.cam_orientation == current.cam_orientation
+                          ? current.cam_orientation
+                          : glm::slerp(previous.cam_orientation, current.cam_orientation, alpha);
+  out.fov = previous.fov + (current.fov - previous.fov) * alpha;
+  out.zNear = previous.zNear + (current.zNear - previous.zNear) * alpha;
+  out.aspect_ratio = current.aspect_ratio;
+}
+
+void Simulation::applyCamera(const SimSnapshot& snapshot, CameraState& cam) {
+  cam.setPosition(snapshot.cam_pos);
+  cam.setOrientation(snapshot.cam_orientation);
+  cam.setFov(snapshot.fov);
+  cam.setZNear(snapshot.zNear);
+  cam.setAspectRatio(snapshot.aspect_ratio);
+}
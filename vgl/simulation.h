@@ -0,0 +1,78 @@
+// Fixed-timestep simulation running on its own thread.
+//
+// The simulation moves the camera and spins the things at a fixed rate,
+// independently of how fast frames are rendered. Every step publishes a
+// snapshot; the render thread blends the last two snapshots so that motion
+// stays smooth even when the render rate and the step rate differ.
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "camera.h"
+#include "input_record.h"
+#include "things.h"
+
+// Everything the renderer needs from one simulation step
+struct SimSnapshot {
+  // Simulation time of the step, in glfwGetTime() seconds
+  double time = 0;
+  // Rotation of every thing, degrees
+  std::vector<float> angles;
+
+  glm::vec3 cam_pos{0};
+  glm::quat cam_orientation{1, 0, 0, 0};
+  double fov = 90, zNear = 0.01, aspect_ratio = 1;
+};
+
+class Simulation {
+public:
+  // `cam` is the camera the input callbacks write to, `things` must outlive the simulation.
+  // With a `replay` the camera's input comes from it instead, on a clock that
+  // moves one step per step however late they run, so the path is the same every time.
+  Simulation(CameraState& cam, const std::vector<Thing>& things, double rate_hz = 120, InputReplay* replay = nullptr);
+  ~Simulation();
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  void start();
+  void stop();
+
+  // State at render time `now`, blended from the two latest steps.
+  // The render is one step behind the simulation, in exchange it never has to extrapolate.
+  void sample(double now, SimSnapshot& out);
+
+  // Copy the camera part of a snapshot into a camera the renderer can use.
+  // Its version only moves if the snapshot differs from what it had.
+  static void applyCamera(const SimSnapshot& snapshot, CameraState& cam);
+
+private:
+  void run();
+  void step(double t);
+
+  CameraState& cam;
+  const std::vector<Thing>& things;
+  const double step_seconds;
+  InputReplay* const replay;
+  // The virtual clock for `replay`, seconds since it started
+  double replay_time = 0;
+
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  // Only the simulation thread touches this one
+  SimSnapshot working;
+  // previous and current published steps, swapped under the mutex
+  std::mutex snapshot_mutex;
+  SimSnapshot previous, current;
+};
+
+#endif
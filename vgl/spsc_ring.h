@@ -0,0 +1,53 @@
+// Lock-free single-producer single-consumer ring buffer.
+// One thread pushes, one other thread pops; neither ever blocks.
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// N must be a power of two. Holds up to N items.
+template <class T, size_t N>
+class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  // Producer side. Returns false (and drops the item) if the ring is full.
+  bool push(const T& item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head_cache == N) {
+      head_cache = head.load(std::memory_order_acquire);
+      if (t - head_cache == N)
+        return false;
+    }
+    items[t & (N - 1)] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the ring is empty.
+  bool pop(T& item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail_cache) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (h == tail_cache)
+        return false;
+    }
+    item = items[h & (N - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Producer and consumer data live on separate cache lines so that they
+  // do not bounce between the two cores. Each side caches the other's index
+  // and only re-reads it when the cached value says full/empty.
+  alignas(64) std::atomic<size_t> tail{0};
+  size_t head_cache = 0;
+  alignas(64) std::atomic<size_t> head{0};
+  size_t tail_cache = 0;
+  alignas(64) T items[N];
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "profiler.h"
+#include "startup.h"
+
+using namespace std;
+
+StartupGraph::StartupGraph(JobSystem& jobs, chrono::steady_clock::time_point origin)
+  : jobs(jobs), origin(origin) {}
+
+StartupGraph::Step StartupGraph::add(const char* name, Thread thread, function<void()> fn, initializer_list<Step> after) {
+  Step step = nodes.size();
+  auto node = make_unique<Node>();
+  node->name = name;
+  node->thread = thread;
+  node->fn = move(fn);
+  for (Step input : after) {
+    if (input < 0 || input >= step)
+      throw invalid_argument{string{"StartupGraph: "} + name + " needs a step that was not added before it"};
+    nodes[input]->dependents.push_back(step);
+  }
+  node->waiting.store(after.size(), memory_order_relaxed);
+  nodes.push_back(move(node));
+  return step;
+}
+
+void StartupGraph::run() {
+  VGL_PROFILE_ZONE("startup");
+  remaining.store(nodes.size(), memory_order_relaxed);
+  for (size_t step = 0; step < nodes.size(); step++) {
+    if (nodes[step]->waiting.load(memory_order_relaxed) == 0)
+      ready(step);
+  }
+
+  while (remaining.load(memory_order_acquire) > 0) {
+    Step step = -1;
+    {
+      lock_guard<mutex> lock(ready_mutex);
+      if (!ready_context.empty()) {
+        // Earliest added first, that is the order they were meant to go in
+        auto first = min_element(ready_context.begin(), ready_context.end());
+        step = *first;
+        ready_context.erase(first);
+      }
+    }
+    if (step >= 0)
+      execute(step);
+    else if (!jobs.runPending())
+      this_thread::yield();
+  }
+  // The last jobs may still be on their way out
+  jobs.wait(running);
+
+  if (error)
+    rethrow_exception(error);
+}
+
+void StartupGraph::ready(Step step) {
+  if (nodes[step]->thread == Any) {
+    jobs.run(running, [this, step] { execute(step); });
+  } else {
+    lock_guard<mutex> lock(ready_mutex);
+    ready_context.push_back(step);
+  }
+}
+
+void StartupGraph::execute(Step step) {
+  Node& node = *nodes[step];
+  if (node.failed.load(memory_order_relaxed)) {
+    node.skipped = true;
+  } else {
+    node.thread_index = jobs.threadIndex();
+    node.begin_ms = elapsedMs();
+    try {
+      VGL_PROFILE_ZONE(node.name);
+      node.fn();
+    } catch (...) {
+      node.failed.store(true, memory_order_relaxed);
+      lock_guard<mutex> lock(ready_mutex);
+      if (!error)
+        error = current_exception();
+    }
+    node.end_ms = elapsedMs();
+  }
+  // Whatever it captured can go now
+  node.fn = nullptr;
+
+  bool failed = node.failed.load(memory_order_relaxed);
+  for (Step dependent : node.dependents) {
+    Node& next = *nodes[dependent];
+    if (failed)
+      next.failed.store(true, memory_order_relaxed);
+    // acq_rel: whoever takes the count to zero sees what every input did
+    if (next.waiting.fetch_sub(1, memory_order_acq_rel) == 1)
+      ready(dependent);
+  }
+  remaining.fetch_sub(1, memory_order_release);
+}
+
+double StartupGraph::elapsedMs() const {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - origin).count();
+}
+
+vector<StartupGraph::Phase> StartupGraph::phases() const {
+  vector<Phase> result;
+  result.reserve(nodes.size());
+  for (auto& node : nodes)
+    result.push_back(Phase{node->name, node->begin_ms, node->end_ms, node->thread_index, node->skipped});
+  return result;
+}
+
+void StartupGraph::print(ostream& out) const {
+  char line[128];
+  snprintf(line, sizeof(line), "  %-24s %9s %9s %9s  %s\n", "step", "start ms", "end ms", "took ms", "thread");
+  out << line;
+  for (auto& phase : phases()) {
+    if (phase.skipped) {
+      snprintf(line, sizeof(line), "  %-24s %9s %9s %9s  skipped\n", phase.name, "-", "-", "-");
+    } else {
+      string thread = phase.thread == 0 ? "main" : phase.thread > 0 ? "worker " + to_string(phase.thread) : "other";
+      snprintf(line, sizeof(line), "  %-24s %9.2f %9.2f %9.2f  %s\n", phase.name, phase.begin_ms, phase.end_ms,
+               phase.end_ms - phase.begin_ms, thread.c_str());
+    }
+    out << line;
+  }
+}
@@ -0,0 +1,100 @@
+// Program startup as a dependency graph.
+//
+// Each step names the steps whose results it needs. Steps that can run on any
+// thread (reading files, decoding images, generating the scene) go to the job
+// system as soon as their inputs are done, so they overlap with bringing up
+// the window and the GL context. Steps that need the context run on the
+// thread that calls run(), also as soon as their inputs are done; in between
+// that thread helps with the jobs.
+//
+//   StartupGraph startup(jobs);
+//   auto context = startup.add("context", StartupGraph::Context, [&] { ... });
+//   auto image = startup.add("decode", StartupGraph::Any, [&] { ... });
+//   startup.add("upload", StartupGraph::Context, [&] { ... }, {context, image});
+//   startup.run();
+//
+// Every step is timed from `origin`, normally the start of main(), which
+// makes elapsedMs() after the first swap the time to first frame.
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "jobs.h"
+
+class StartupGraph {
+public:
+  enum Thread { Any, Context };
+  using Step = int;
+
+  struct Phase {
+    const char* name;
+    double begin_ms, end_ms;
+    // JobSystem::threadIndex() of the thread that ran it
+    int thread;
+    // Never ran, because a step it needs threw
+    bool skipped;
+  };
+
+  explicit StartupGraph(JobSystem& jobs, std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now());
+
+  StartupGraph(const StartupGraph&) = delete;
+  StartupGraph& operator=(const StartupGraph&) = delete;
+
+  // `name` must outlive the graph, a string literal say. The steps in `after`
+  // must have been added already, which also rules out cycles.
+  Step add(const char* name, Thread thread, std::function<void()> fn, std::initializer_list<Step> after = {});
+
+  // Runs every step and returns once all of them are done. If a step throws,
+  // the steps that need it are skipped and the first exception is rethrown
+  // here once the rest have finished.
+  void run();
+
+  // Milliseconds since `origin`
+  double elapsedMs() const;
+  // In the order the steps were added. Only meaningful once run() returned.
+  std::vector<Phase> phases() const;
+  // phases() as a table, one step per line
+  void print(std::ostream& out) const;
+
+private:
+  struct Node {
+    const char* name;
+    Thread thread;
+    std::function<void()> fn;
+    std::vector<Step> dependents;
+    // Inputs not done yet
+    std::atomic<int> waiting{0};
+    // Threw, or something it needs did
+    std::atomic<bool> failed{false};
+    double begin_ms = 0, end_ms = 0;
+    int thread_index = -1;
+    bool skipped = false;
+  };
+
+  // All inputs of `step` are done
+  void ready(Step step);
+  void execute(Step step);
+
+  JobSystem& jobs;
+  std::chrono::steady_clock::time_point origin;
+  std::vector<std::unique_ptr<Node>> nodes;
+  JobCounter running;
+  std::atomic<int> remaining{0};
+
+  std::mutex ready_mutex;
+  // Context steps ready to go, for run() to pick up
+  std::vector<Step> ready_context;
+  std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "things.h"
+
+using namespace std;
+
+namespace {
+
+// Things are never bigger than this, see distr_speed below
+constexpr double max_scale = 0.5;
+// Two things collide when they are closer than sqrt(2) * (scale1 + scale2),
+// so with cells this big only the 27 cells around a thing need to be looked at.
+const double cell_size = sqrt(2.) * 2 * max_scale;
+// From a satellite's center to its parent's, in units of the parent's scale.
+// Far enough for neither to reach the other however they turn.
+constexpr double satellite_distance = 2.5;
+constexpr double satellite_scale = 1. / 3;
+// A chunk is a hundred or so things, a job wants thousands
+constexpr size_t min_chunks_per_job = 32;
+
+// Calls add(thing) for every cube of makeCubeScene, in order
+template <class F>
+void placeCubes(int num, unsigned seed, F&& add) {
+  // Build pones
+  mt19937 gen(seed);
+  // Keep the density of the original 30 cubes in a [-1, 1] box
+  double extent = cbrt(num / 30.);
+  if (extent < 1)
+    extent = 1;
+  uniform_real_distribution<> distr_vec(-extent, extent);
+  uniform_real_distribution<> distr_axis(-1, 1);
+  uniform_real_distribution<> distr_speed(0, 1);
+
+  // The collision check used to compare every pair, which is hopeless for
+  // benchmark-sized scenes. Bin the placed things into a grid instead and only
+  // compare against the neighbouring cells. Each cell keeps position and scale
+  // packed together so that a lookup touches a handful of cache lines.
+  int cells = (int)ceil(2 * extent / cell_size) + 1;
+  vector<vector<glm::vec4>> grid((size_t)cells * cells * cells);
+  auto cellCoord = [&](float v) {
+    int c = (int)floor((v + extent) / cell_size);
+    return c < 0 ? 0 : (c >= cells ? cells - 1 : c);
+  };
+
+  for (int i = 0; i < num; i++) {
+    Thing thing;
+    thing.pos.x = distr_vec(gen);
+    thing.pos.y = distr_vec(gen);
+    thing.pos.z = distr_vec(gen);
+    glm::vec3 axis;
+    axis.x = distr_axis(gen);
+    axis.y = distr_axis(gen);
+    axis.z = distr_axis(gen);
+    thing.rotation_axis = glm::normalize(axis);
+    thing.speed = distr_speed(gen);
+    thing.scale = distr_speed(gen) * max_scale;
+    // From the index rather than the generator, so the same seed still places the cubes where it always did
+    thing.material = i % 4 == 3 ? Material::Transparent : Material::Opaque;
+
+    // Collision check. Re-roll all the parameters if the collision check fails.
+    int cx = cellCoord(thing.pos.x), cy = cellCoord(thing.pos.y), cz = cellCoord(thing.pos.z);
+    bool collides = false;
+    for (int x = max(cx - 1, 0); x <= min(cx + 1, cells - 1) && !collides; x++)
+      for (int y = max(cy - 1, 0); y <= min(cy + 1, cells - 1) && !collides; y++)
+        for (int z = max(cz - 1, 0); z <= min(cz + 1, cells - 1) && !collides; z++)
+          for (auto &&thing2 : grid[((size_t)x * cells + y) * cells + z]) {
+            auto dx = (thing.pos.x - thing2.x);
+            auto dy = (thing.pos.y - thing2.y);
+            auto dz = (thing.pos.z - thing2.z);
+            auto mindist = thing.scale + thing2.w;
+            if (2 * mindist * mindist > dx * dx + dy * dy + dz * dz) {
+              collides = true;
+              break;
+            }
+          }
+    if (collides) {
+      i--;
+      continue;
+    }
+    grid[((size_t)cx * cells + cy) * cells + cz].push_back(glm::vec4(thing.pos, thing.scale));
+    add(thing);
+
+    // cout << "Generated the followig pony:\n";
+    // cout << "Position: " << pony.pos.x << ", " << pony.pos.y << ", " <<
+    // pony.pos.z << '\n'; cout << "Rotation axis: " << pony.rotation_axis.x <<
+    // ", " << pony.rotation_axis.y << ", " << pony.rotation_axis.z << '\n';
+    // cout << "Speed: " << pony.speed << '\n';
+    // cout << "Scale: " << pony.speed << '\n';
+  }
+}
+
+}
+
+void animateThings(const vector<Thing>& things, double t, vector<float>& angles) {
+  angles.resize(things.size());
+  for (size_t i = 0; i < things.size(); i++)
+    // speed is in units of 100 degrees per second
+    angles[i] = fmod(things[i].speed * 100 * t, 360.);
+}
+
+void animateThings(JobSystem& jobs, EntityWorld& world, double t) {
+  world.parallelEach<const Spin, Rotation>(jobs, [t](size_t, size_t count, const Spin* spins, Rotation* rotations) {
+    for (size_t i = 0; i < count; i++)
+      rotations[i].angle = fmod(spins[i].speed * 100 * t, 360.);
+  }, min_chunks_per_job);
+}
+
+void transformThings(JobSystem& jobs, EntityWorld& world) {
+  world.parallelEach<const Position, const Rotation, const Scale, AffineTransform>(jobs,
+    [](size_t, size_t count, const Position* positions, const Rotation* rotations, const Scale* scales, AffineTransform* models) {
+      // The kernel wants arrays of each, a chunk's worth fits in L1
+      constexpr size_t batch = 256;
+      glm::vec3 pos[batch], axes[batch];
+      float sizes[batch], radians[batch];
+      for (size_t first = 0; first < count; first += batch) {
+        size_t n = min(batch, count - first);
+        for (size_t k = 0; k < n; k++) {
+          pos[k] = positions[first + k].value;
+          axes[k] = rotations[first + k].axis;
+          sizes[k] = scales[first + k].value;
+          radians[k] = glm::radians(rotations[first + k].angle);
+        }
+        vglAxisAngleTransforms(n, pos, axes, sizes, radians, models + first);
+      }
+    }, min_chunks_per_job);
+}
+
+void addThingSystems(SystemScheduler& systems, const double& time) {
+  const double* t = &time;
+  systems.add("animateThings", componentMask<Spin>(), componentMask<Rotation>(),
+              [t](JobSystem& jobs, EntityWorld& world) { animateThings(jobs, world, *t); });
+  systems.add("transformThings", componentMask<Position, Rotation, Scale>(), componentMask<AffineTransform>(),
+              [](JobSystem& jobs, EntityWorld& world) { transformThings(jobs, world); });
+}
+
+vector<Thing> makeCubeScene(int num, unsigned seed) {
+  vector<Thing> things;
+  things.reserve(num);
+  placeCubes(num, seed, [&](const Thing& thing) { things.push_back(thing); });
+  return things;
+}
+
+void makeCubeScene(EntityWorld& world, int num, unsigned seed) {
+  placeCubes(num, seed, [&](const Thing& thing) {
+    world.create(Position{thing.pos}, Rotation{thing.rotation_axis, 0}, Spin{(float)thing.speed},
+                 Scale{(float)thing.scale}, thing.material, AffineTransform{});
+  });
+}
+
+void addSatellites(vector<Thing>& things, int count, unsigned seed) {
+  mt19937 gen(seed);
+  uniform_real_distribution<> distr_axis(-1, 1);
+  uniform_real_distribution<> distr_speed(0, 1);
+  uniform_real_distribution<> distr_phase(0, 2 * M_PI);
+  size_t parents = things.size();
+  things.reserve(parents * (count + 1));
+  for (size_t p = 0; p < parents; p++) {
+    // Two directions square to the axis and to each other, the circle the satellites go round on
+    glm::vec3 axis = things[p].rotation_axis;
+    glm::vec3 other = fabs(axis.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::vec3 u = glm::normalize(glm::cross(axis, other));
+    glm::vec3 v = glm::cross(axis, u);
+    double phase = distr_phase(gen);
+    for (int k = 0; k < count; k++) {
+      Thing satellite;
+      double angle = phase + 2 * M_PI * k / count;
+      satellite.pos = (float)satellite_distance * ((float)cos(angle) * u + (float)sin(angle) * v);
+      satellite.rotation_axis = glm::normalize(glm::vec3(distr_axis(gen), distr_axis(gen), distr_axis(gen)));
+      satellite.speed = distr_speed(gen);
+      satellite.scale = satellite_scale;
+      satellite.material = things.size() % 4 == 3 ? Material::Transparent : Material::Opaque;
+      satellite.parent = (int32_t)p;
+      things.push_back(satellite);
+    }
+  }
+}
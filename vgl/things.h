@@ -0,0 +1,80 @@
+// 3D things
+// Cube things, pony things, shiny things, you name it
+
+#ifndef THINGS_H
+#define THINGS_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "batch_math.h"
+#include "ecs.h"
+#include "jobs.h"
+
+// How a thing's surface is drawn. Opaque things hide what is behind them;
+// transparent ones blend over it, so they have to be drawn after it.
+enum class Material : uint8_t {
+  Opaque,
+  Transparent,
+};
+
+struct Thing {
+  glm::vec3 pos;
+  glm::vec3 rotation_axis;
+  double speed;
+  double scale;
+  Material material = Material::Opaque;
+  // Index of the thing this one is attached to, -1 for none. Then pos,
+  // rotation and scale are relative to the parent's, see SceneGraph.
+  int32_t parent = -1;
+};
+
+// The things as entities (see ecs.h). makeCubeScene's have all of these, a
+// Material, and an AffineTransform: their model matrix, see transformThings.
+struct Position {
+  glm::vec3 value;
+};
+struct Rotation {
+  glm::vec3 axis;
+  // Degrees about the axis, within [0, 360)
+  float angle;
+};
+// How fast the rotation's angle goes, in units of 100 degrees per second
+struct Spin {
+  float speed;
+};
+struct Scale {
+  float value;
+};
+
+// Scatter `num` non-overlapping cubes around the origin.
+// The same seed always produces the same scene, which is what the benchmark relies on.
+// The volume grows with `num` so that the density stays the same as with the original 30 cubes.
+// Every fourth cube is transparent.
+std::vector<Thing> makeCubeScene(int num, unsigned seed = std::random_device{}());
+// The same cubes as entities, made in the same order, their angles 0 and
+// their transforms unset
+void makeCubeScene(EntityWorld& world, int num, unsigned seed = std::random_device{}());
+
+// What --satellites takes: a few tens per cube already multiply a large scene past what fits
+constexpr int max_satellites = 64;
+
+// Give each of the things `count` cubes a third of its size, spread round it
+// square to its rotation axis, so that its spin carries them round.
+// Appended after all the things, which keeps the order breadth first.
+void addSatellites(std::vector<Thing>& things, int count, unsigned seed = std::random_device{}());
+
+// Rotation of every thing at time `t` (seconds), in degrees within [0, 360)
+void animateThings(const std::vector<Thing>& things, double t, std::vector<float>& angles);
+// The same for the entities with a Spin, into their Rotation
+void animateThings(JobSystem& jobs, EntityWorld& world, double t);
+// The AffineTransform of the entities with a Position, Rotation and Scale:
+// translate(position) * rotate(angle, axis) * scale(scale)
+void transformThings(JobSystem& jobs, EntityWorld& world);
+// Both as systems, animateThings at whatever `time` is when they run
+void addThingSystems(SystemScheduler& systems, const double& time);
+
+#endif
@@ -8,14 +8,18 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include <cerrno>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <random>
 #include <string>
 
+#include "gl_debug.h"
+#include "profiler.h"
 #include "vgl.h"
 
 // Optimal representation of a cube for
@@ -43,17 +47,44 @@ GLfloat vglCubeVertices[] = {
 };
 size_t vglCubeVerticesSize = sizeof(vglCubeVertices);
 
-GLuint vglLoadTexture(const char* path, const char* sampler_name, GLuint shader_program, GLuint texture_unit, GLenum format) {
-  // prepare our texture
-  GLuint texture;  
-  int width, height, nrChannels;
+void DecodedImage::Free::operator()(unsigned char* pixels) const {
+  stbi_image_free(pixels);
+}
+
+bool vglParseInt(const char* text, int min, int max, int& value) {
+  char* end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+  if (end == text || *end || errno == ERANGE || parsed < min || parsed > max)
+    return false;
+  value = parsed;
+  return true;
+}
+
+std::string vglReadFile(const char* path) {
+  // TODO idiomatic reading of files into a string is a whole can of worms...
+  // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
+  std::ifstream file(path);
+  if (!file)
+    throw std::invalid_argument{std::string{"vglReadFile: cannot open "} + path};
+  return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+DecodedImage vglDecodeImage(const char* path) {
+  VGL_PROFILE_ZONE("vglDecodeImage");
+  DecodedImage image;
+  // Process-wide in stb_image, but every caller wants the same
   stbi_set_flip_vertically_on_load(true);
-  unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-  if (!data) {
-    std::cerr << "vglLoadTexture oof: cannot load texture " << path << '\n';
-    throw std::invalid_argument{path};
-  }
-  //std::cout << "Image loaded with width = " << width << " and height = " << height << '\n';
+  image.pixels.reset(stbi_load(path, &image.width, &image.height, &image.channels, 0));
+  if (!image.pixels)
+    throw std::invalid_argument{std::string{"vglDecodeImage: cannot load "} + path + ": " + stbi_failure_reason()};
+  return image;
+}
+
+GLuint vglTextureFromImage(const DecodedImage& image, GLenum format, const char* label) {
+  VGL_PROFILE_ZONE("vglTextureFromImage");
+  // prepare our texture
+  GLuint texture;
   glGenTextures(1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
   // set the texture wrapping parameters
@@ -62,42 +93,50 @@ GLuint vglLoadTexture(const char* path, const char* sampler_name, GLuint shader_
   // set texture filtering parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
   glGenerateMipmap(GL_TEXTURE_2D);
+  VGL_GL_LABEL(GL_TEXTURE, texture, label);
+  return texture;
+}
 
-  stbi_image_free(data);
+GLuint vglTextureFromFile(const char* path, GLenum format) {
+  VGL_PROFILE_ZONE("vglTextureFromFile");
+  return vglTextureFromImage(vglDecodeImage(path), format, path);
+}
 
-  GLint texture_unit_location;
-  texture_unit_location = glGetUniformLocation(shader_program, sampler_name);
+void vglBindSampler(GLuint shader_program, const char* sampler_name, GLuint texture_unit) {
+  GLint texture_unit_location = glGetUniformLocation(shader_program, sampler_name);
   if (texture_unit_location < 0) {
-    if (texture_unit_location == -1) {
-      std::cerr << "vglLoadTexture oof: couldn't find find " << sampler_name << ".\n";
-    }
-    std::cerr << "glGetUniformLocation oof\n";
-    return 1;
+    // Not an error as far as GL is concerned: the sampler may just be unused and optimized out
+    std::cerr << "vglBindSampler oof: couldn't find " << sampler_name << ".\n";
+    return;
   }
   glUniform1i(texture_unit_location, texture_unit);
+}
 
+GLuint vglLoadTexture(const char* path, const char* sampler_name, GLuint shader_program, GLuint texture_unit, GLenum format) {
+  VGL_PROFILE_ZONE("vglLoadTexture");
+  GLuint texture = vglTextureFromFile(path, format);
+  vglBindSampler(shader_program, sampler_name, texture_unit);
   return texture;
 }
 
 GLuint vglBuildShaderFromFile(const char* vertex_file_name, const char* fragment_file_name) {
-  // TODO idiomatic reading of files into a string is a whole can of worms...
-  // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-  std::ifstream vertex_shader_file(vertex_file_name);
-  std::string vertex_shader_src {std::istreambuf_iterator<char>{vertex_shader_file},
-                                 std::istreambuf_iterator<char>{}};
-  std::ifstream fragment_shader_file(fragment_file_name);
-  std::string fragment_shader_src {std::istreambuf_iterator<char>{fragment_shader_file},
-                                   std::istreambuf_iterator<char>{}};
+  VGL_PROFILE_ZONE("vglBuildShaderFromFile");
+  std::string vertex_shader_src = vglReadFile(vertex_file_name);
+  std::string fragment_shader_src = vglReadFile(fragment_file_name);
+  std::string label = std::string{vertex_file_name} + " + " + fragment_file_name;
+  return vglBuildShader(vertex_shader_src.c_str(), fragment_shader_src.c_str(), label.c_str());
+}
 
+GLuint vglBuildShader(const char* vertex_src, const char* fragment_src, const char* label) {
+  VGL_PROFILE_ZONE("vglBuildShader");
   GLint success;
   char infoLog[512];
 
   // vertex shader
   int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  const char * vertex_shader_arr = vertex_shader_src.c_str();
-  glShaderSource(vertex_shader, 1, &vertex_shader_arr, NULL);
+  glShaderSource(vertex_shader, 1, &vertex_src, NULL);
   glCompileShader(vertex_shader);
   // check for shader compile errors
 
@@ -111,9 +150,8 @@ GLuint vglBuildShaderFromFile(const char* vertex_file_name, const char* fragment
 
   // fragment shader
   int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  const char * fragment_shader_arr = fragment_shader_src.c_str();
-  glShaderSource(fragment_shader, 1, &fragment_shader_arr, NULL);
-  glShaderSource(fragment_shader, 1, &fragment_shader_arr, NULL);
+  glShaderSource(fragment_shader, 1, &fragment_src, NULL);
+  glShaderSource(fragment_shader, 1, &fragment_src, NULL);
   glCompileShader(fragment_shader);
   // check for shader compile errors
   glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
@@ -138,39 +176,62 @@ GLuint vglBuildShaderFromFile(const char* vertex_file_name, const char* fragment
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
 
+  VGL_GL_LABEL(GL_PROGRAM, shader_program, label);
+
   return shader_program;
 }
 
+#if defined(VGL_GL_DEBUG) || !defined(NDEBUG)
+// GL 4.5 and KHR_robustness, not in the GL 3.3 glad
+#ifndef GL_CONTEXT_LOST
+#define GL_CONTEXT_LOST 0x0507
+#endif
+
+// More than the kinds of error there are
+constexpr int max_error_flags = 16;
+
 GLenum vglCheckError() {
   // Error messages taken from:
   // https://www.khronos.org/opengl/wiki/OpenGL_Error
-  auto error = glGetError();
-  std::string msg;
-  switch (error) {
-  case GL_NO_ERROR:
-    return error;
-  case GL_INVALID_ENUM:
-    msg = "GL_INVALID_ENUM: \
+  // GL keeps one flag per kind of error, so keep asking until all of them are reported.
+  // A lost context reports GL_CONTEXT_LOST on every call, so that ends it, and so does a
+  // driver that never clears its flags.
+  GLenum first = GL_NO_ERROR;
+  GLenum error;
+  for (int asked = 0; asked < max_error_flags && (error = glGetError()) != GL_NO_ERROR; asked++) {
+    if (first == GL_NO_ERROR)
+      first = error;
+    std::string msg;
+    switch (error) {
+    case GL_INVALID_ENUM:
+      msg = "GL_INVALID_ENUM: \
 Given when an enumeration parameter is not a legal enumeration for that function. \
 * glEnable: are you using the correct value? You can't just OR multiple values!\n";
-    break;
-  case GL_INVALID_VALUE:
-    msg = "GL_INVALID_VALUE";
-    break;  
-  case GL_INVALID_OPERATION:
-    msg = "GL_INVALID_OPERATION: \
+      break;
+    case GL_INVALID_VALUE:
+      msg = "GL_INVALID_VALUE";
+      break;  
+    case GL_INVALID_OPERATION:
+      msg = "GL_INVALID_OPERATION: \
 The specified operation is not allowed in the current state. The offending command is ignored and has no other side effect than to set the error flag.\n\
 Things to check are:\n\
 * Are you sure the type of the uniform you're setting matches?\n";
-    break;  
-  case GL_INVALID_FRAMEBUFFER_OPERATION:
-    msg = "GL_INVALID_FRAMEBUFFER_OPERATION";
-    break;  
-  default:
-    msg = "Unknown";
-  }
+      break;  
+    case GL_INVALID_FRAMEBUFFER_OPERATION:
+      msg = "GL_INVALID_FRAMEBUFFER_OPERATION";
+      break;  
+    case GL_CONTEXT_LOST:
+      msg = "GL_CONTEXT_LOST";
+      break;
+    default:
+      msg = "Unknown";
+    }
 
-  std::cout << "Error: " << msg << '\n';
+    std::cout << "Error: " << msg << '\n';
+    if (error == GL_CONTEXT_LOST)
+      break;
+  }
 
-  return error;
-}
\ No newline at end of file
+  return first;
+}
+#endif
@@ -0,0 +1,51 @@
+/* vova gl, functions generalizing repetitive actions */
+
+#ifndef VGL_H
+#define VGL_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+extern GLfloat vglCubeVertices[];
+extern size_t vglCubeVerticesSize;
+
+// Pixels straight from the image decoder, bottom row first like GL wants them
+struct DecodedImage {
+  struct Free {
+    void operator()(unsigned char* pixels) const;
+  };
+  std::unique_ptr<unsigned char, Free> pixels;
+  int width = 0, height = 0, channels = 0;
+};
+
+// Parses the whole of `text` as a decimal integer in [min, max]. False, with
+// `value` untouched, for anything else: no digits, trailing characters, out of range.
+bool vglParseInt(const char* text, int min, int max, int& value);
+// The whole file, throws if it cannot be read. No GL, any thread.
+std::string vglReadFile(const char* path);
+// Decodes an image file, throws if it cannot. No GL, any thread.
+DecodedImage vglDecodeImage(const char* path);
+// Uploads a decoded image into a new mipmapped texture, labelled `label`
+GLuint vglTextureFromImage(const DecodedImage& image, GLenum format, const char* label);
+// Loads an image into a new texture, the two above in one go
+GLuint vglTextureFromFile(const char* path, GLenum format);
+// Points the sampler uniform `sampler_name` at `texture_unit`. The program must be in use.
+void vglBindSampler(GLuint shader_program, const char* sampler_name, GLuint texture_unit);
+// Both of the above
+GLuint vglLoadTexture(const char* path, const char* sampler_name, GLuint shader_program, GLuint texture_unit, GLenum format);
+// Compiles and links a program from source, throws with the info log if that fails
+GLuint vglBuildShader(const char* vertex_src, const char* fragment_src, const char* label);
+GLuint vglBuildShaderFromFile(const char* vertex_file_name, const char* fragment_file_name);
+#if defined(VGL_GL_DEBUG) || !defined(NDEBUG)
+// Reports every pending GL error. With KHR_debug the callback of gl_debug.h says more.
+GLenum vglCheckError();
+#else
+// glGetError is a round trip on many drivers, so release builds (NDEBUG, see vgl.mk)
+// without GL_DEBUG never call it
+inline GLenum vglCheckError() { return GL_NO_ERROR; }
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+# Build settings shared by libvgl and the chapters, include it at the top of a chapter Makefile.
+#
+#   make                    debug build, -g -O0
+#   make VARIANT=release    -O3 with link time optimization, NATIVE=1 adds -march=native
+#   make VARIANT=pgo-gen    release build instrumented for profile guided optimization
+#   make VARIANT=pgo-use    release build optimized with the profile recorded by a pgo-gen run
+#
+# Objects and libvgl.a go to build/<variant>, so switching variants does not need a clean.
+# Both pgo variants share build/pgo because gcc looks for the .gcda profile next to the object,
+# see the pgo target in "7 Camera/Makefile" for the whole instrument, train, rebuild cycle.
+
+VGL_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+VARIANT ?= debug
+
+RELEASE_FLAGS = -g -O3 -DNDEBUG -flto=auto
+ifdef NATIVE
+RELEASE_FLAGS += -march=native
+endif
+
+ifeq ($(VARIANT),debug)
+VGL_CXXFLAGS = -g -O0
+else ifeq ($(VARIANT),release)
+VGL_CXXFLAGS = $(RELEASE_FLAGS)
+else ifeq ($(VARIANT),pgo-gen)
+# atomic counters, the recorder and the simulation run on their own threads
+VGL_CXXFLAGS = $(RELEASE_FLAGS) -fprofile-generate -fprofile-update=atomic
+else ifeq ($(VARIANT),pgo-use)
+# code the training run never reached (main, input handling) is optimized as in release
+VGL_CXXFLAGS = $(RELEASE_FLAGS) -fprofile-use -fprofile-partial-training -Wno-missing-profile
+else
+$(error VARIANT must be one of debug, release, pgo-gen, pgo-use)
+endif
+
+VGL_BUILD = build/$(patsubst pgo-%,pgo,$(VARIANT))
+
+# make PROFILE=1 compiles the profiler in, see profiler.h
+ifdef PROFILE
+PROFILE_FLAGS = -DVGL_PROFILE
+endif
+
+# make LOG_LEVEL=TRACE|DEBUG|INFO|WARN|ERROR|OFF, see log.h
+ifdef LOG_LEVEL
+LOG_FLAGS = -DVGL_LOG_LEVEL=VGL_LOG_LEVEL_$(LOG_LEVEL)
+endif
+
+# make GL_DEBUG=1 for the KHR_debug layer, GL_DEBUG=validate to also check every call, see gl_debug.h.
+# vglCheckError works in debug builds either way, release builds only keep it with GL_DEBUG.
+ifeq ($(GL_DEBUG),validate)
+GL_DEBUG_FLAGS = -DVGL_GL_DEBUG -DVGL_GL_VALIDATE
+else ifdef GL_DEBUG
+GL_DEBUG_FLAGS = -DVGL_GL_DEBUG
+endif
+
+VGL_FLAGS = $(strip $(VGL_CXXFLAGS) $(PROFILE_FLAGS) $(LOG_FLAGS) $(GL_DEBUG_FLAGS))
+VGL_INCLUDES = -I../include -I$(VGL_DIR)
+VGL_LIB = $(VGL_DIR)/$(VGL_BUILD)/libvgl.a
+VGL_LDLIBS = -lglfw -lGL -lX11 -lpthread -lXrandr -lXi -ldl
+
+# The flags end up in a stamp file, so that e.g. make PROFILE=1 after a plain make rebuilds everything
+$(VGL_BUILD)/flags : FORCE
+	@mkdir -p $(VGL_BUILD)
+	@echo '$(VGL_FLAGS)' | cmp -s - $@ || echo '$(VGL_FLAGS)' > $@
+
+$(VGL_BUILD)/%.o : %.cpp $(VGL_BUILD)/flags
+	g++ $(VGL_FLAGS) -MMD -MP $(VGL_INCLUDES) -c $< -o $@
+
+# Chapters only ask for the library, whether it is up to date is up to its own Makefile
+ifneq ($(VGL_DIR),.)
+$(VGL_LIB) : FORCE
+	$(MAKE) -C $(VGL_DIR) lib
+endif
+
+FORCE :
+
+.PHONY : FORCE
+
+# Let the first rule of the including Makefile be the default goal
+.DEFAULT_GOAL :=
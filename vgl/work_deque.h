@@ -0,0 +1,76 @@
+// Lock-free work-stealing deque (Chase-Lev).
+// The owning thread pushes and pops at the bottom, like a stack, while any
+// other thread may steal from the top. Only the last item is contended.
+// After "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al. 2013,
+// with the fences folded into seq_cst accesses: the same instructions on x86,
+// and something ThreadSanitizer can follow.
+
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// T must be a pointer (or something as small and trivially copyable).
+// N must be a power of two. Holds up to N items.
+template <class T, size_t N>
+class WorkDeque {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "WorkDeque size must be a power of two");
+
+public:
+  // Owner only. Returns false if the deque is full.
+  bool push(T item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= (int64_t)N)
+      return false;
+    items[b & (N - 1)].store(item, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Owner only. Takes the most recently pushed item, returns false if there is none.
+  bool pop(T& item) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    // Claim the item before looking at what the thieves are doing
+    bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_seq_cst);
+    if (t > b) {
+      // Empty
+      bottom.store(b + 1, std::memory_order_release);
+      return false;
+    }
+    item = items[b & (N - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last item: race the thieves for it
+      bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_release);
+      return won;
+    }
+    return true;
+  }
+
+  // Any thread. Takes the oldest item, returns false if there is none or another thread got it first.
+  bool steal(T& item) {
+    int64_t t = top.load(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_seq_cst);
+    if (t >= b)
+      return false;
+    item = items[t & (N - 1)].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  // Racy, only good as a hint
+  bool empty() const {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Thieves hammer top, the owner mostly touches bottom
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+  alignas(64) std::atomic<T> items[N];
+};
+
+#endif